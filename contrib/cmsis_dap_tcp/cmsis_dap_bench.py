@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Measure the memory throughput of OpenOCD through the CMSIS-DAP 'tcp'
+backend, against cmsis_dap_tcp_emu for a set of emulated link latencies.
+
+For each latency the emulator and OpenOCD are started, then through the
+Tcl RPC server the script times a dump_image (mem_ap_read_buf) and a
+load_image (mem_ap_write_buf) of the emulated memory, and reports the
+packets and transfers counted by 'cmsis-dap stats'. These only cover the
+DAP_Transfer packets of SWD, use -v for the counts of the emulator.
+
+Usage: cmsis_dap_bench.py [options], see --help.
+
+Example, SWD then JTAG with 0, 100 us and 1 ms of latency:
+./cmsis_dap_bench.py -l 0 100 1000
+./cmsis_dap_bench.py -l 0 100 1000 -t jtag
+"""
+
+import argparse
+import os
+import re
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+MEM_BASE = 0x20000000
+COMMAND_TOKEN = b'\x1a'
+
+
+class OpenOcd:
+    def __init__(self, port):
+        deadline = time.time() + 10
+        while True:
+            try:
+                self.sock = socket.create_connection(('127.0.0.1', port))
+                return
+            except OSError:
+                if time.time() > deadline:
+                    raise
+                time.sleep(0.1)
+
+    def send(self, cmd):
+        self.sock.sendall(cmd.encode() + COMMAND_TOKEN)
+        data = b''
+        while not data.endswith(COMMAND_TOKEN):
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError('OpenOCD closed the connection')
+            data += chunk
+        return data[:-1].decode(errors='replace')
+
+    def close(self):
+        self.sock.close()
+
+
+def stats(ocd):
+    out = ocd.send('capture {cmsis-dap stats}')
+    packets = re.search(r'(\d+) packets,', out)
+    transfers = re.search(r'(\d+) transfers', out)
+    in_flight = re.search(r'([\d.]+) requests in flight on average', out)
+    return (int(packets.group(1)) if packets else 0,
+            int(transfers.group(1)) if transfers else 0,
+            in_flight.group(1) if in_flight else '-')
+
+
+def run(args, latency, image):
+    emu = subprocess.Popen([args.emulator, '-o', '-p', str(args.port),
+                            '-l', str(latency), '-s', str(args.service),
+                            '-n', str(args.packet_count),
+                            '-w', str(args.wait_every), '-m', str(args.size)],
+                           stdout=subprocess.PIPE, text=True)
+    # listening once it has printed its first line
+    emu.stdout.readline()
+    ocd_cmd = [args.openocd, '-c', 'gdb port disabled', '-c', 'telnet port disabled',
+               '-c', 'tcl port %d' % args.tcl_port,
+               '-c', 'set EMU_PORT %d' % args.port,
+               '-c', 'transport select %s' % args.transport,
+               '-f', 'board/cmsis_dap_tcp_emu.cfg']
+    for cmd in args.command:
+        ocd_cmd += ['-c', cmd]
+    ocd = subprocess.Popen(ocd_cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    results = []
+    try:
+        rpc = OpenOcd(args.tcl_port)
+        with tempfile.TemporaryDirectory() as tmp:
+            dump = os.path.join(tmp, 'dump.bin')
+            for name, cmd in (('load_image', 'load_image %s 0x%x bin' % (image, MEM_BASE)),
+                              ('dump_image', 'dump_image %s 0x%x %d' % (dump, MEM_BASE, args.size))):
+                rpc.send('cmsis-dap stats reset')
+                start = time.perf_counter()
+                rpc.send(cmd)
+                elapsed = time.perf_counter() - start
+                packets, transfers, in_flight = stats(rpc)
+                results.append((name, args.size / 1024 / elapsed, packets, transfers, in_flight))
+            with open(image, 'rb') as f, open(dump, 'rb') as g:
+                if f.read() != g.read():
+                    sys.stderr.write('latency %d us: the memory read back differs\n' % latency)
+        rpc.send('shutdown')
+        rpc.close()
+    finally:
+        try:
+            ocd.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            ocd.kill()
+        emu.terminate()
+        emu_stats = emu.communicate()[0]
+
+    if args.verbose:
+        sys.stdout.write(emu_stats)
+    return results
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[1],
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-l', '--latency', type=int, nargs='+', default=[0, 100, 500, 2000],
+                        help='latencies to emulate, in us')
+    parser.add_argument('-s', '--service', type=int, default=0,
+                        help='processing time of a packet by the probe, in us')
+    parser.add_argument('-n', '--packet-count', type=int, default=8,
+                        help='packet count reported by the probe')
+    parser.add_argument('-w', '--wait-every', type=int, default=0,
+                        help='inject a WAIT every n AP accesses')
+    parser.add_argument('-t', '--transport', choices=['swd', 'jtag'], default='swd')
+    parser.add_argument('-z', '--size', type=int, default=256 * 1024,
+                        help='bytes to load and dump')
+    parser.add_argument('-c', '--command', action='append', default=[],
+                        help='OpenOCD command run after the configuration')
+    parser.add_argument('--openocd', default='openocd')
+    parser.add_argument('--emulator', default=os.path.join(here, 'cmsis_dap_tcp_emu'))
+    parser.add_argument('--port', type=int, default=4441)
+    parser.add_argument('--tcl-port', type=int, default=6666)
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='print the statistics of the emulator')
+    args = parser.parse_args()
+
+    with tempfile.NamedTemporaryFile(suffix='.bin') as image:
+        image.write(os.urandom(args.size))
+        image.flush()
+
+        print('%10s %-10s %10s %10s %10s %9s %9s' % ('latency', 'command', 'KiB/s',
+              'packets', 'transfers', 'per pkt', 'in flight'))
+        for latency in args.latency:
+            for name, rate, packets, transfers, in_flight in run(args, latency, image.name):
+                per_packet = '%.1f' % (transfers / packets) if packets else '-'
+                print('%8d us %-10s %10.1f %10d %10d %9s %9s' % (latency, name, rate,
+                      packets, transfers, per_packet, in_flight))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,1342 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Emulator of a CMSIS-DAP probe reachable over TCP, for the 'tcp' backend
+ * of the OpenOCD cmsis-dap driver, and of the target behind it: an ADIv5
+ * DP with a single MEM-AP whose memory is a buffer in the host.
+ *
+ * The DP is reachable through DAP_Transfer and DAP_TransferBlock, and in
+ * JTAG mode through DAP_JTAG_Sequence as the JTAG-DP of a single TAP.
+ * Several commands can be packed in DAP_ExecuteCommands.
+ *
+ * Requests are executed as they arrive, but each response is held back
+ * for a configurable probe processing time and link latency, without
+ * delaying the next requests, so that the pipeline of OpenOCD behaves as
+ * with a remote probe. WAIT responses of the AP accesses can be injected.
+ * The memory is kept from one connection to the next, and statistics of
+ * the traffic are printed when OpenOCD disconnects.
+ *
+ * To compile run:
+ * gcc -Wall -O2 -std=gnu99 -o cmsis_dap_tcp_emu cmsis_dap_tcp_emu.c
+ *
+ * Usage example, 500 us of latency and 20 us to process each packet:
+ * ./cmsis_dap_tcp_emu -l 500 -s 20
+ * openocd -f board/cmsis_dap_tcp_emu.cfg
+ *
+ * See cmsis_dap_bench.py to measure the throughput of OpenOCD.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BIT(n)					(1u << (n))
+#define ARRAY_SIZE(x)			(sizeof(x) / sizeof((x)[0]))
+
+/* framing of the 'tcp' backend, see src/jtag/drivers/cmsis_dap_tcp.c */
+#define DAP_PKT_HDR_SIGNATURE	0x00504144
+#define DAP_PKT_TYPE_REQUEST	0x01
+#define DAP_PKT_TYPE_RESPONSE	0x02
+#define HEADER_SIZE				8
+
+#define DEFAULT_PORT			4441
+#define DEFAULT_PACKET_SIZE		1024
+#define DEFAULT_PACKET_COUNT	8
+#define DEFAULT_MEM_BASE		0x20000000
+#define DEFAULT_MEM_SIZE		(1024 * 1024)
+
+/* responses held back, requests are not read from the socket beyond */
+#define MAX_QUEUED_RESPONSES	256
+
+#define CMD_DAP_INFO				0x00
+#define CMD_DAP_LED					0x01
+#define CMD_DAP_CONNECT				0x02
+#define CMD_DAP_DISCONNECT			0x03
+#define CMD_DAP_TFER_CONFIGURE		0x04
+#define CMD_DAP_TFER				0x05
+#define CMD_DAP_TFER_BLOCK			0x06
+#define CMD_DAP_TFER_ABORT			0x07
+#define CMD_DAP_WRITE_ABORT			0x08
+#define CMD_DAP_DELAY				0x09
+#define CMD_DAP_RESET_TARGET		0x0A
+#define CMD_DAP_SWJ_PINS			0x10
+#define CMD_DAP_SWJ_CLOCK			0x11
+#define CMD_DAP_SWJ_SEQ				0x12
+#define CMD_DAP_SWD_CONFIGURE		0x13
+#define CMD_DAP_JTAG_SEQ			0x14
+#define CMD_DAP_JTAG_CONFIGURE		0x15
+#define CMD_DAP_JTAG_IDCODE			0x16
+#define CMD_DAP_SWD_SEQUENCE		0x1D
+#define CMD_DAP_EXECUTE_COMMANDS	0x7F
+
+#define INFO_ID_VENDOR			0x01
+#define INFO_ID_PRODUCT			0x02
+#define INFO_ID_SERNUM			0x03
+#define INFO_ID_FW_VER			0x04
+#define INFO_ID_CAPS			0xF0
+#define INFO_ID_PKT_CNT			0xFE
+#define INFO_ID_PKT_SZ			0xFF
+
+#define INFO_CAPS_SWD			BIT(0)
+#define INFO_CAPS_JTAG			BIT(1)
+#define INFO_CAPS_ATOMIC_CMDS	BIT(4)
+
+#define DAP_OK					0x00
+#define DAP_ERROR				0xFF
+
+#define DAP_PORT_SWD			1
+#define DAP_PORT_JTAG			2
+
+#define DAP_JTAG_SEQ_TCK		0x3F
+#define DAP_JTAG_SEQ_TMS		BIT(6)
+#define DAP_JTAG_SEQ_TDO		BIT(7)
+
+#define DAP_TFER_APNDP			BIT(0)
+#define DAP_TFER_RNW			BIT(1)
+#define DAP_TFER_A32			0x0C
+#define DAP_TFER_MATCH_VALUE	BIT(4)
+#define DAP_TFER_MATCH_MASK		BIT(5)
+#define DAP_TFER_TIMESTAMP		BIT(7)
+
+#define DAP_TFER_OK				0x01
+#define DAP_TFER_WAIT			0x02
+#define DAP_TFER_FAULT			0x04
+#define DAP_TFER_MISMATCH		BIT(4)
+
+/* DP registers and bits */
+#define DP_DPIDR				0x2BA01477
+#define DP_JTAG_IDCODE			0x4BA00477
+#define DP_SELECT_APSEL			0xFF000000
+#define DP_SELECT_APBANK		0x000000F0
+#define DP_SELECT_DPBANK		0x0000000F
+#define STKCMPCLR				BIT(1)
+#define STKERRCLR				BIT(2)
+#define ORUNERRCLR				BIT(4)
+#define SSTICKYORUN				BIT(1)
+#define SSTICKYCMP				BIT(4)
+#define SSTICKYERR				BIT(5)
+#define STICKY_BITS				(SSTICKYORUN | SSTICKYCMP | SSTICKYERR)
+#define CDBGPWRUPREQ			BIT(28)
+#define CDBGPWRUPACK			BIT(29)
+#define CSYSPWRUPREQ			BIT(30)
+#define CSYSPWRUPACK			BIT(31)
+
+/* MEM-AP registers and bits */
+#define MEM_AP_REG_CSW			0x00
+#define MEM_AP_REG_TAR			0x04
+#define MEM_AP_REG_DRW			0x0C
+#define MEM_AP_REG_BD0			0x10
+#define MEM_AP_REG_BD3			0x1C
+#define MEM_AP_REG_CFG			0xF4
+#define MEM_AP_REG_BASE			0xF8
+#define AP_REG_IDR				0xFC
+#define AHB_AP_IDR				0x24770011
+#define CSW_SIZE_MASK			0x7
+#define CSW_32BIT				0x2
+#define CSW_ADDRINC_MASK		(3u << 4)
+#define CSW_ADDRINC_PACKED		(2u << 4)
+#define CSW_DEVICE_EN			BIT(6)
+#define CSW_TRIN_PROG			BIT(7)
+
+/* JTAG-DP */
+#define JTAG_DP_IR_LEN			4
+#define JTAG_DP_IR_ABORT		0x8
+#define JTAG_DP_IR_DPACC		0xA
+#define JTAG_DP_IR_APACC		0xB
+#define JTAG_DP_IR_IDCODE		0xE
+#define JTAG_DP_ACC_LEN			35
+#define JTAG_DP_ACK_WAIT		0x1
+#define JTAG_DP_ACK_OK_FAULT	0x2
+
+enum tap_state {
+	TAP_RESET, TAP_IDLE,
+	TAP_DRSELECT, TAP_DRCAPTURE, TAP_DRSHIFT, TAP_DREXIT1,
+	TAP_DRPAUSE, TAP_DREXIT2, TAP_DRUPDATE,
+	TAP_IRSELECT, TAP_IRCAPTURE, TAP_IRSHIFT, TAP_IREXIT1,
+	TAP_IRPAUSE, TAP_IREXIT2, TAP_IRUPDATE,
+};
+
+/* next state for TMS low and high */
+static const uint8_t tap_next[16][2] = {
+	[TAP_RESET] = { TAP_IDLE, TAP_RESET },
+	[TAP_IDLE] = { TAP_IDLE, TAP_DRSELECT },
+	[TAP_DRSELECT] = { TAP_DRCAPTURE, TAP_IRSELECT },
+	[TAP_DRCAPTURE] = { TAP_DRSHIFT, TAP_DREXIT1 },
+	[TAP_DRSHIFT] = { TAP_DRSHIFT, TAP_DREXIT1 },
+	[TAP_DREXIT1] = { TAP_DRPAUSE, TAP_DRUPDATE },
+	[TAP_DRPAUSE] = { TAP_DRPAUSE, TAP_DREXIT2 },
+	[TAP_DREXIT2] = { TAP_DRSHIFT, TAP_DRUPDATE },
+	[TAP_DRUPDATE] = { TAP_IDLE, TAP_DRSELECT },
+	[TAP_IRSELECT] = { TAP_IRCAPTURE, TAP_RESET },
+	[TAP_IRCAPTURE] = { TAP_IRSHIFT, TAP_IREXIT1 },
+	[TAP_IRSHIFT] = { TAP_IRSHIFT, TAP_IREXIT1 },
+	[TAP_IREXIT1] = { TAP_IRPAUSE, TAP_IRUPDATE },
+	[TAP_IRPAUSE] = { TAP_IRPAUSE, TAP_IREXIT2 },
+	[TAP_IREXIT2] = { TAP_IRSHIFT, TAP_IRUPDATE },
+	[TAP_IRUPDATE] = { TAP_IDLE, TAP_DRSELECT },
+};
+
+struct emu_dap {
+	unsigned int port;
+	uint32_t ctrl_stat;
+	uint32_t select;
+	uint32_t rdbuff;
+	uint32_t csw;
+	uint32_t tar;
+	uint32_t match_mask;
+	unsigned int wait_retry;
+	unsigned int match_retry;
+	/* AP accesses so far, to inject the WAIT responses */
+	uint64_t ap_accesses;
+
+	/* JTAG-DP TAP */
+	enum tap_state state;
+	uint32_t ir;
+	uint64_t shift;
+	unsigned int shift_len;
+	/* result of the last transaction, captured by the next scan */
+	uint32_t jtag_result;
+	/* WAIT responses left for the last transaction */
+	unsigned int jtag_busy;
+	/* the scan was answered WAIT, its update is ignored */
+	bool jtag_ignore_update;
+};
+
+struct emu_stats {
+	uint64_t start_us;
+	uint64_t packets;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t commands[256];
+	uint64_t transfers;
+	uint64_t dp_reads;
+	uint64_t dp_writes;
+	uint64_t ap_reads;
+	uint64_t ap_writes;
+	uint64_t mem_read_bytes;
+	uint64_t mem_write_bytes;
+	uint64_t jtag_clocks;
+	uint64_t waits;
+	uint64_t faults;
+	uint64_t in_flight_sum;
+	unsigned int max_in_flight;
+};
+
+/* cursor over a request and its response */
+struct dap_buf {
+	const uint8_t *req;
+	unsigned int req_len;
+	unsigned int req_pos;
+	uint8_t *resp;
+	unsigned int resp_size;
+	unsigned int resp_len;
+	bool error;
+};
+
+struct queued_response {
+	uint64_t due_us;
+	unsigned int len;
+	uint8_t *data;
+};
+
+static unsigned int packet_size = DEFAULT_PACKET_SIZE;
+static unsigned int packet_count = DEFAULT_PACKET_COUNT;
+static unsigned int latency_us;
+static unsigned int service_us;
+static unsigned int wait_every;
+static unsigned int wait_count = 1;
+static bool verbose;
+
+static uint8_t *mem;
+static uint32_t mem_base = DEFAULT_MEM_BASE;
+static uint32_t mem_size = DEFAULT_MEM_SIZE;
+
+static struct emu_dap dap;
+static struct emu_stats stats;
+
+static struct queued_response responses[MAX_QUEUED_RESPONSES];
+static unsigned int responses_head;
+static unsigned int responses_count;
+static uint64_t busy_until_us;
+
+static volatile sig_atomic_t quit;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint8_t get_u8(struct dap_buf *b)
+{
+	if (b->req_pos + 1 > b->req_len) {
+		b->error = true;
+		return 0;
+	}
+	return b->req[b->req_pos++];
+}
+
+static uint16_t get_u16(struct dap_buf *b)
+{
+	uint16_t value = get_u8(b);
+
+	return value | get_u8(b) << 8;
+}
+
+static uint32_t get_u32(struct dap_buf *b)
+{
+	uint32_t value = get_u16(b);
+
+	return value | (uint32_t)get_u16(b) << 16;
+}
+
+static void put_u8(struct dap_buf *b, uint8_t value)
+{
+	if (b->resp_len + 1 > b->resp_size) {
+		b->error = true;
+		return;
+	}
+	b->resp[b->resp_len++] = value;
+}
+
+static void put_u16(struct dap_buf *b, uint16_t value)
+{
+	put_u8(b, value);
+	put_u8(b, value >> 8);
+}
+
+static void put_u32(struct dap_buf *b, uint32_t value)
+{
+	put_u16(b, value);
+	put_u16(b, value >> 16);
+}
+
+static void put_string(struct dap_buf *b, const char *s)
+{
+	put_u8(b, strlen(s) + 1);
+	for (; *s; s++)
+		put_u8(b, *s);
+	put_u8(b, 0);
+}
+
+static void dap_reset(void)
+{
+	uint64_t ap_accesses = dap.ap_accesses;
+
+	memset(&dap, 0, sizeof(dap));
+	dap.port = DAP_PORT_SWD;
+	dap.csw = CSW_32BIT | CSW_DEVICE_EN;
+	dap.ir = JTAG_DP_IR_IDCODE;
+	dap.ap_accesses = ap_accesses;
+}
+
+/* Number of WAIT responses to inject for the next AP access */
+static unsigned int ap_waits(void)
+{
+	if (!wait_every || ++dap.ap_accesses % wait_every)
+		return 0;
+	return wait_count;
+}
+
+static uint32_t mem_ap_transfer_size(void)
+{
+	if ((dap.csw & CSW_ADDRINC_MASK) == CSW_ADDRINC_PACKED)
+		return 4;
+	return 1u << (dap.csw & CSW_SIZE_MASK);
+}
+
+/* Access the memory through DRW or BDx, data is placed on its byte lanes */
+static uint32_t mem_ap_access(uint32_t address, unsigned int len, bool rnw, uint32_t value)
+{
+	if (address < mem_base || address - mem_base + len > mem_size) {
+		dap.ctrl_stat |= SSTICKYERR;
+		return 0;
+	}
+
+	uint8_t *p = mem + (address - mem_base);
+	if (rnw) {
+		value = 0;
+		for (unsigned int i = 0; i < len; i++)
+			value |= (uint32_t)p[i] << (8 * ((address + i) & 3));
+		stats.mem_read_bytes += len;
+	} else {
+		for (unsigned int i = 0; i < len; i++)
+			p[i] = value >> (8 * ((address + i) & 3));
+		stats.mem_write_bytes += len;
+	}
+
+	return value;
+}
+
+static uint32_t ap_access(unsigned int reg, bool rnw, uint32_t value)
+{
+	unsigned int addr = (dap.select & DP_SELECT_APBANK) | reg;
+
+	if (rnw)
+		stats.ap_reads++;
+	else
+		stats.ap_writes++;
+
+	/* transactions are discarded until the sticky error is cleared */
+	if (dap.ctrl_stat & SSTICKYERR)
+		return 0;
+
+	/* only AP #0 is implemented */
+	if (dap.select & DP_SELECT_APSEL)
+		return 0;
+
+	switch (addr) {
+	case MEM_AP_REG_CSW:
+		if (rnw)
+			return dap.csw;
+		/* sizes up to 32 bits, no TrInProg, DeviceEn always set */
+		if ((value & CSW_SIZE_MASK) > CSW_32BIT)
+			value = (value & ~CSW_SIZE_MASK) | (dap.csw & CSW_SIZE_MASK);
+		dap.csw = (value & ~CSW_TRIN_PROG) | CSW_DEVICE_EN;
+		return 0;
+	case MEM_AP_REG_TAR:
+		if (!rnw)
+			dap.tar = value;
+		return rnw ? dap.tar : 0;
+	case MEM_AP_REG_DRW: {
+		uint32_t len = mem_ap_transfer_size();
+		value = mem_ap_access(dap.tar, len, rnw, value);
+		if (dap.csw & CSW_ADDRINC_MASK)
+			dap.tar += len;
+		return rnw ? value : 0;
+	}
+	case MEM_AP_REG_BD0 ... MEM_AP_REG_BD3:
+		value = mem_ap_access((dap.tar & ~0xf) | (addr & 0xc), 4, rnw, value);
+		return rnw ? value : 0;
+	case MEM_AP_REG_CFG:
+		return 0;
+	case MEM_AP_REG_BASE:
+		/* debug register format, no ROM table */
+		return 0x2;
+	case AP_REG_IDR:
+		return AHB_AP_IDR;
+	default:
+		return 0;
+	}
+}
+
+static void dp_abort(uint32_t value)
+{
+	if (value & STKCMPCLR)
+		dap.ctrl_stat &= ~SSTICKYCMP;
+	if (value & STKERRCLR)
+		dap.ctrl_stat &= ~SSTICKYERR;
+	if (value & ORUNERRCLR)
+		dap.ctrl_stat &= ~SSTICKYORUN;
+}
+
+static uint32_t dp_access(unsigned int reg, bool rnw, uint32_t value)
+{
+	bool swd = dap.port == DAP_PORT_SWD;
+	unsigned int bank = dap.select & DP_SELECT_DPBANK;
+
+	if (rnw)
+		stats.dp_reads++;
+	else
+		stats.dp_writes++;
+
+	switch (reg) {
+	case 0x0:
+		if (rnw)
+			return bank == 0 ? (swd ? DP_DPIDR : 0) : 0;
+		if (swd)
+			dp_abort(value);
+		return 0;
+	case 0x4:
+		if (rnw)
+			return bank == 0 ? dap.ctrl_stat : 0;
+		if (bank != 0)
+			return 0;
+		/* sticky bits are write-one-to-clear on JTAG-DP, read-only on SW-DP */
+		if (!swd)
+			dap.ctrl_stat &= ~(value & STICKY_BITS);
+		dap.ctrl_stat = (dap.ctrl_stat & STICKY_BITS)
+			| (value & ~(STICKY_BITS | CDBGPWRUPACK | CSYSPWRUPACK));
+		/* power up is immediate */
+		if (dap.ctrl_stat & CDBGPWRUPREQ)
+			dap.ctrl_stat |= CDBGPWRUPACK;
+		if (dap.ctrl_stat & CSYSPWRUPREQ)
+			dap.ctrl_stat |= CSYSPWRUPACK;
+		return 0;
+	case 0x8:
+		if (!rnw)
+			dap.select = value;
+		/* RESEND on SW-DP */
+		return swd ? dap.rdbuff : dap.select;
+	case 0xC:
+		return rnw ? dap.rdbuff : 0;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * One transfer of DAP_Transfer or DAP_TransferBlock, with the retries of
+ * the WAIT responses done by the probe. Reads of the AP are not posted,
+ * the probe reads RDBUFF for us.
+ * @returns the DAP_TFER_xxx acknowledge
+ */
+static unsigned int dap_transfer(uint8_t request, uint32_t *value)
+{
+	bool rnw = request & DAP_TFER_RNW;
+	unsigned int reg = request & DAP_TFER_A32;
+
+	stats.transfers++;
+
+	if (!(request & DAP_TFER_APNDP)) {
+		*value = dp_access(reg, rnw, *value);
+		return DAP_TFER_OK;
+	}
+
+	unsigned int waits = ap_waits();
+	if (waits > dap.wait_retry) {
+		stats.waits += dap.wait_retry + 1;
+		return DAP_TFER_WAIT;
+	}
+	stats.waits += waits;
+
+	if (dap.ctrl_stat & SSTICKYERR) {
+		stats.faults++;
+		return DAP_TFER_FAULT;
+	}
+
+	*value = ap_access(reg, rnw, *value);
+	if (rnw)
+		dap.rdbuff = *value;
+
+	if (dap.ctrl_stat & SSTICKYERR) {
+		stats.faults++;
+		return DAP_TFER_FAULT;
+	}
+
+	return DAP_TFER_OK;
+}
+
+static void cmd_transfer(struct dap_buf *b)
+{
+	get_u8(b);	/* DAP index */
+	unsigned int count = get_u8(b);
+	unsigned int count_pos = b->resp_len;
+	unsigned int done = 0;
+	unsigned int ack = DAP_TFER_OK;
+
+	put_u8(b, 0);
+	put_u8(b, 0);
+
+	for (unsigned int i = 0; i < count && !b->error; i++) {
+		uint8_t request = get_u8(b);
+		bool rnw = request & DAP_TFER_RNW;
+		uint32_t value = 0;
+
+		if (!rnw || (request & DAP_TFER_MATCH_VALUE))
+			value = get_u32(b);
+		/* the remaining transfers are skipped after an error */
+		if (ack != DAP_TFER_OK || b->error)
+			continue;
+
+		if (!rnw && (request & DAP_TFER_MATCH_MASK)) {
+			dap.match_mask = value;
+			done++;
+			continue;
+		}
+
+		if (rnw && (request & DAP_TFER_MATCH_VALUE)) {
+			uint32_t match_value = value;
+			unsigned int retry = dap.match_retry;
+			do {
+				ack = dap_transfer(request & ~DAP_TFER_MATCH_VALUE, &value);
+			} while (ack == DAP_TFER_OK && (value & dap.match_mask) != match_value && retry--);
+			if (ack == DAP_TFER_OK && (value & dap.match_mask) != match_value)
+				ack |= DAP_TFER_MISMATCH;
+			if (ack == DAP_TFER_OK)
+				done++;
+			continue;
+		}
+
+		ack = dap_transfer(request, &value);
+		if (ack != DAP_TFER_OK)
+			continue;
+		done++;
+		if (request & DAP_TFER_TIMESTAMP)
+			put_u32(b, now_us());
+		if (rnw)
+			put_u32(b, value);
+	}
+
+	if (!b->error) {
+		b->resp[count_pos] = done;
+		b->resp[count_pos + 1] = ack;
+	}
+}
+
+static void cmd_transfer_block(struct dap_buf *b)
+{
+	get_u8(b);	/* DAP index */
+	unsigned int count = get_u16(b);
+	uint8_t request = get_u8(b);
+	bool rnw = request & DAP_TFER_RNW;
+	unsigned int count_pos = b->resp_len;
+	unsigned int done = 0;
+	unsigned int ack = DAP_TFER_OK;
+
+	put_u16(b, 0);
+	put_u8(b, 0);
+
+	for (unsigned int i = 0; i < count && !b->error; i++) {
+		uint32_t value = 0;
+
+		if (!rnw)
+			value = get_u32(b);
+		if (ack != DAP_TFER_OK || b->error)
+			continue;
+
+		ack = dap_transfer(request & (DAP_TFER_APNDP | DAP_TFER_RNW | DAP_TFER_A32), &value);
+		if (ack != DAP_TFER_OK)
+			continue;
+		done++;
+		if (rnw)
+			put_u32(b, value);
+	}
+
+	if (!b->error) {
+		b->resp[count_pos] = done;
+		b->resp[count_pos + 1] = done >> 8;
+		b->resp[count_pos + 2] = ack;
+	}
+}
+
+static unsigned int jtag_dr_len(void)
+{
+	switch (dap.ir) {
+	case JTAG_DP_IR_ABORT:
+	case JTAG_DP_IR_DPACC:
+	case JTAG_DP_IR_APACC:
+		return JTAG_DP_ACC_LEN;
+	case JTAG_DP_IR_IDCODE:
+		return 32;
+	default:
+		return 1;
+	}
+}
+
+static uint64_t jtag_capture_dr(void)
+{
+	switch (dap.ir) {
+	case JTAG_DP_IR_DPACC:
+	case JTAG_DP_IR_APACC:
+		/* an AP transaction still in progress answers WAIT */
+		dap.jtag_ignore_update = dap.jtag_busy;
+		if (dap.jtag_busy) {
+			dap.jtag_busy--;
+			stats.waits++;
+			return JTAG_DP_ACK_WAIT;
+		}
+		return JTAG_DP_ACK_OK_FAULT | (uint64_t)dap.jtag_result << 3;
+	case JTAG_DP_IR_ABORT:
+		return JTAG_DP_ACK_OK_FAULT | (uint64_t)dap.jtag_result << 3;
+	case JTAG_DP_IR_IDCODE:
+		return DP_JTAG_IDCODE;
+	default:
+		return 0;
+	}
+}
+
+/* Transaction through DPACC or APACC, on update of the data register */
+static void jtag_update_dr(void)
+{
+	bool rnw = dap.shift & 1;
+	unsigned int reg = (dap.shift >> 1 & 0x3) << 2;
+	uint32_t value = dap.shift >> 3;
+
+	switch (dap.ir) {
+	case JTAG_DP_IR_ABORT:
+		dp_abort(value);
+		break;
+	case JTAG_DP_IR_DPACC:
+		if (!dap.jtag_ignore_update)
+			dap.jtag_result = dp_access(reg, rnw, value);
+		break;
+	case JTAG_DP_IR_APACC:
+		if (dap.jtag_ignore_update)
+			break;
+		value = ap_access(reg, rnw, value);
+		if (rnw)
+			dap.rdbuff = value;
+		dap.jtag_result = value;
+		dap.jtag_busy = ap_waits();
+		break;
+	default:
+		break;
+	}
+}
+
+/* One TCK of the JTAG-DP TAP. @returns TDO */
+static bool jtag_clock(bool tms, bool tdi)
+{
+	bool tdo = false;
+
+	stats.jtag_clocks++;
+
+	switch (dap.state) {
+	case TAP_DRCAPTURE:
+		dap.shift = jtag_capture_dr();
+		dap.shift_len = jtag_dr_len();
+		break;
+	case TAP_IRCAPTURE:
+		dap.shift = 0x1;
+		dap.shift_len = JTAG_DP_IR_LEN;
+		break;
+	case TAP_DRSHIFT:
+	case TAP_IRSHIFT:
+		tdo = dap.shift & 1;
+		dap.shift = (dap.shift >> 1) | ((uint64_t)tdi << (dap.shift_len - 1));
+		break;
+	default:
+		break;
+	}
+
+	dap.state = tap_next[dap.state][tms];
+
+	switch (dap.state) {
+	case TAP_RESET:
+		dap.ir = JTAG_DP_IR_IDCODE;
+		break;
+	case TAP_IRUPDATE:
+		dap.ir = dap.shift & ((1u << JTAG_DP_IR_LEN) - 1);
+		break;
+	case TAP_DRUPDATE:
+		jtag_update_dr();
+		break;
+	default:
+		break;
+	}
+
+	return tdo;
+}
+
+static void cmd_jtag_sequence(struct dap_buf *b)
+{
+	unsigned int count = get_u8(b);
+
+	put_u8(b, DAP_OK);
+
+	for (unsigned int i = 0; i < count && !b->error; i++) {
+		uint8_t info = get_u8(b);
+		unsigned int tck = info & DAP_JTAG_SEQ_TCK;
+		bool tms = info & DAP_JTAG_SEQ_TMS;
+		bool capture = info & DAP_JTAG_SEQ_TDO;
+		uint8_t tdi = 0;
+		uint8_t tdo = 0;
+
+		if (!tck)
+			tck = 64;
+
+		for (unsigned int n = 0; n < tck && !b->error; n++) {
+			if (n % 8 == 0)
+				tdi = get_u8(b);
+			if (jtag_clock(tms, tdi & BIT(n % 8)))
+				tdo |= BIT(n % 8);
+			if (capture && (n % 8 == 7 || n == tck - 1)) {
+				put_u8(b, tdo);
+				tdo = 0;
+			}
+		}
+	}
+}
+
+static void cmd_swj_sequence(struct dap_buf *b)
+{
+	unsigned int count = get_u8(b);
+	uint8_t bits = 0;
+
+	if (!count)
+		count = 256;
+
+	for (unsigned int n = 0; n < count && !b->error; n++) {
+		if (n % 8 == 0)
+			bits = get_u8(b);
+		/* SWDIO/TMS: moves the TAP in JTAG mode, TDI is left high */
+		if (dap.port == DAP_PORT_JTAG)
+			jtag_clock(bits & BIT(n % 8), true);
+	}
+
+	put_u8(b, DAP_OK);
+}
+
+static void cmd_swd_sequence(struct dap_buf *b)
+{
+	unsigned int count = get_u8(b);
+
+	put_u8(b, DAP_OK);
+
+	for (unsigned int i = 0; i < count && !b->error; i++) {
+		uint8_t info = get_u8(b);
+		unsigned int clocks = info & 0x3F;
+		bool input = info & BIT(7);
+
+		if (!clocks)
+			clocks = 64;
+		/* the line is not emulated, SWDIO reads low */
+		for (unsigned int n = 0; n < clocks; n += 8) {
+			if (input)
+				put_u8(b, 0);
+			else
+				get_u8(b);
+		}
+	}
+}
+
+static void cmd_info(struct dap_buf *b)
+{
+	switch (get_u8(b)) {
+	case INFO_ID_VENDOR:
+		put_string(b, "OpenOCD");
+		break;
+	case INFO_ID_PRODUCT:
+		put_string(b, "CMSIS-DAP TCP emulator");
+		break;
+	case INFO_ID_SERNUM:
+		put_string(b, "0");
+		break;
+	case INFO_ID_FW_VER:
+		put_string(b, "2.1.0");
+		break;
+	case INFO_ID_CAPS:
+		put_u8(b, 1);
+		put_u8(b, INFO_CAPS_SWD | INFO_CAPS_JTAG | INFO_CAPS_ATOMIC_CMDS);
+		break;
+	case INFO_ID_PKT_CNT:
+		put_u8(b, 1);
+		put_u8(b, packet_count);
+		break;
+	case INFO_ID_PKT_SZ:
+		put_u8(b, 2);
+		put_u16(b, packet_size);
+		break;
+	default:
+		put_u8(b, 0);
+		break;
+	}
+}
+
+static void dap_command(struct dap_buf *b);
+
+static void cmd_execute_commands(struct dap_buf *b)
+{
+	unsigned int count = get_u8(b);
+
+	put_u8(b, count);
+	for (unsigned int i = 0; i < count && !b->error; i++)
+		dap_command(b);
+}
+
+/* Execute the command at the request cursor and append its response */
+static void dap_command(struct dap_buf *b)
+{
+	uint8_t cmd = get_u8(b);
+
+	if (b->error)
+		return;
+
+	stats.commands[cmd]++;
+	put_u8(b, cmd);
+
+	switch (cmd) {
+	case CMD_DAP_INFO:
+		cmd_info(b);
+		break;
+	case CMD_DAP_LED:
+		get_u16(b);
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_CONNECT: {
+		uint8_t port = get_u8(b);
+		dap.port = port == DAP_PORT_JTAG ? DAP_PORT_JTAG : DAP_PORT_SWD;
+		put_u8(b, dap.port);
+		break;
+	}
+	case CMD_DAP_DISCONNECT:
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_TFER_CONFIGURE:
+		get_u8(b);	/* idle cycles */
+		dap.wait_retry = get_u16(b);
+		dap.match_retry = get_u16(b);
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_TFER:
+		cmd_transfer(b);
+		break;
+	case CMD_DAP_TFER_BLOCK:
+		cmd_transfer_block(b);
+		break;
+	case CMD_DAP_WRITE_ABORT:
+		get_u8(b);	/* DAP index */
+		dp_abort(get_u32(b));
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_DELAY:
+		get_u16(b);
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_RESET_TARGET:
+		put_u8(b, DAP_OK);
+		put_u8(b, 0);
+		break;
+	case CMD_DAP_SWJ_PINS: {
+		uint8_t out = get_u8(b);
+		uint8_t select = get_u8(b);
+		get_u32(b);	/* wait */
+		put_u8(b, out & select);
+		break;
+	}
+	case CMD_DAP_SWJ_CLOCK:
+		get_u32(b);
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_SWJ_SEQ:
+		cmd_swj_sequence(b);
+		break;
+	case CMD_DAP_SWD_CONFIGURE:
+		get_u8(b);
+		put_u8(b, DAP_OK);
+		break;
+	case CMD_DAP_SWD_SEQUENCE:
+		cmd_swd_sequence(b);
+		break;
+	case CMD_DAP_JTAG_SEQ:
+		cmd_jtag_sequence(b);
+		break;
+	case CMD_DAP_JTAG_CONFIGURE: {
+		unsigned int count = get_u8(b);
+		for (unsigned int i = 0; i < count; i++)
+			get_u8(b);
+		put_u8(b, DAP_OK);
+		break;
+	}
+	case CMD_DAP_JTAG_IDCODE:
+		get_u8(b);	/* index */
+		put_u8(b, DAP_OK);
+		put_u32(b, DP_JTAG_IDCODE);
+		break;
+	case CMD_DAP_EXECUTE_COMMANDS:
+		cmd_execute_commands(b);
+		break;
+	default:
+		/* SWO, UART and vendor commands are not implemented */
+		b->resp[b->resp_len - 1] = DAP_ERROR;
+		break;
+	}
+}
+
+static const char *command_name(unsigned int cmd)
+{
+	static const char * const names[] = {
+		[CMD_DAP_INFO] = "DAP_Info",
+		[CMD_DAP_LED] = "DAP_HostStatus",
+		[CMD_DAP_CONNECT] = "DAP_Connect",
+		[CMD_DAP_DISCONNECT] = "DAP_Disconnect",
+		[CMD_DAP_TFER_CONFIGURE] = "DAP_TransferConfigure",
+		[CMD_DAP_TFER] = "DAP_Transfer",
+		[CMD_DAP_TFER_BLOCK] = "DAP_TransferBlock",
+		[CMD_DAP_TFER_ABORT] = "DAP_TransferAbort",
+		[CMD_DAP_WRITE_ABORT] = "DAP_WriteABORT",
+		[CMD_DAP_DELAY] = "DAP_Delay",
+		[CMD_DAP_RESET_TARGET] = "DAP_ResetTarget",
+		[CMD_DAP_SWJ_PINS] = "DAP_SWJ_Pins",
+		[CMD_DAP_SWJ_CLOCK] = "DAP_SWJ_Clock",
+		[CMD_DAP_SWJ_SEQ] = "DAP_SWJ_Sequence",
+		[CMD_DAP_SWD_CONFIGURE] = "DAP_SWD_Configure",
+		[CMD_DAP_JTAG_SEQ] = "DAP_JTAG_Sequence",
+		[CMD_DAP_JTAG_CONFIGURE] = "DAP_JTAG_Configure",
+		[CMD_DAP_JTAG_IDCODE] = "DAP_JTAG_IDCODE",
+		[CMD_DAP_SWD_SEQUENCE] = "DAP_SWD_Sequence",
+		[CMD_DAP_EXECUTE_COMMANDS] = "DAP_ExecuteCommands",
+	};
+
+	if (cmd < ARRAY_SIZE(names) && names[cmd])
+		return names[cmd];
+	return "unknown";
+}
+
+static void print_stats(void)
+{
+	uint64_t elapsed_us = now_us() - stats.start_us;
+
+	printf("session of %" PRIu64 ".%03" PRIu64 " s, %" PRIu64 " packets, %" PRIu64
+		" bytes in, %" PRIu64 " bytes out\n",
+		elapsed_us / 1000000, elapsed_us / 1000 % 1000,
+		stats.packets, stats.bytes_in, stats.bytes_out);
+	if (!stats.packets)
+		return;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(stats.commands); i++)
+		if (stats.commands[i])
+			printf("  %-24s %" PRIu64 "\n", command_name(i), stats.commands[i]);
+
+	printf("%" PRIu64 " transfers, %" PRIu64 ".%02" PRIu64 " per packet\n",
+		stats.transfers, stats.transfers / stats.packets,
+		stats.transfers * 100 / stats.packets % 100);
+	printf("DP %" PRIu64 " reads %" PRIu64 " writes, AP %" PRIu64 " reads %" PRIu64
+		" writes, %" PRIu64 " JTAG clocks\n",
+		stats.dp_reads, stats.dp_writes, stats.ap_reads, stats.ap_writes, stats.jtag_clocks);
+	printf("memory %" PRIu64 " bytes read, %" PRIu64 " bytes written\n",
+		stats.mem_read_bytes, stats.mem_write_bytes);
+	printf("%" PRIu64 " WAIT, %" PRIu64 " FAULT responses\n", stats.waits, stats.faults);
+	printf("%" PRIu64 ".%02" PRIu64 " requests in flight on average, %u at most\n",
+		stats.in_flight_sum / stats.packets, stats.in_flight_sum * 100 / stats.packets % 100,
+		stats.max_in_flight);
+	fflush(stdout);
+}
+
+static int send_all(int fd, const uint8_t *data, unsigned int len)
+{
+	while (len) {
+		ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Send the responses that are due. @returns the time of the next one, 0 if none */
+static int send_responses(int fd, uint64_t *next_us)
+{
+	uint64_t now = now_us();
+
+	*next_us = 0;
+	while (responses_count) {
+		struct queued_response *r = &responses[responses_head];
+		if (r->due_us > now) {
+			*next_us = r->due_us;
+			break;
+		}
+		if (send_all(fd, r->data, r->len) < 0)
+			return -1;
+		stats.bytes_out += r->len;
+		responses_head = (responses_head + 1) % MAX_QUEUED_RESPONSES;
+		responses_count--;
+	}
+	return 0;
+}
+
+/* Execute a request and queue its response */
+static void process_request(const uint8_t *data, unsigned int len)
+{
+	struct queued_response *r =
+		&responses[(responses_head + responses_count) % MAX_QUEUED_RESPONSES];
+	struct dap_buf b = {
+		.req = data,
+		.req_len = len,
+		.resp = r->data + HEADER_SIZE,
+		.resp_size = packet_size,
+	};
+
+	if (len && data[0] == CMD_DAP_TFER_ABORT) {
+		/* no response */
+		stats.commands[CMD_DAP_TFER_ABORT]++;
+		return;
+	}
+
+	dap_command(&b);
+	if (b.error) {
+		b.resp[0] = DAP_ERROR;
+		b.resp_len = 1;
+	}
+
+	if (verbose)
+		printf("request %s, %u bytes, response %u bytes\n",
+			command_name(data[0]), len, b.resp_len);
+
+	uint8_t *hdr = r->data;
+	hdr[0] = DAP_PKT_HDR_SIGNATURE & 0xff;
+	hdr[1] = DAP_PKT_HDR_SIGNATURE >> 8 & 0xff;
+	hdr[2] = DAP_PKT_HDR_SIGNATURE >> 16 & 0xff;
+	hdr[3] = DAP_PKT_HDR_SIGNATURE >> 24 & 0xff;
+	hdr[4] = b.resp_len & 0xff;
+	hdr[5] = b.resp_len >> 8;
+	hdr[6] = DAP_PKT_TYPE_RESPONSE;
+	hdr[7] = 0;
+	r->len = HEADER_SIZE + b.resp_len;
+
+	/* the probe processes one packet at a time, the link adds its latency */
+	uint64_t now = now_us();
+	if (busy_until_us < now)
+		busy_until_us = now;
+	busy_until_us += service_us;
+	r->due_us = busy_until_us + latency_us;
+
+	responses_count++;
+	stats.packets++;
+	stats.in_flight_sum += responses_count;
+	if (responses_count > stats.max_in_flight)
+		stats.max_in_flight = responses_count;
+}
+
+static void serve(int fd)
+{
+	unsigned int in_size = HEADER_SIZE + 65536;
+	uint8_t *in = malloc(in_size);
+	unsigned int in_len = 0;
+
+	if (!in) {
+		fprintf(stderr, "out of memory\n");
+		return;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	stats.start_us = now_us();
+	dap_reset();
+	responses_head = 0;
+	responses_count = 0;
+	busy_until_us = 0;
+
+	while (!quit) {
+		uint64_t next_us;
+		if (send_responses(fd, &next_us) < 0)
+			break;
+
+		int timeout = -1;
+		if (next_us) {
+			uint64_t now = now_us();
+			timeout = next_us > now ? (int)((next_us - now + 999) / 1000) : 0;
+		}
+
+		/* stop reading requests while the responses queue is full */
+		struct pollfd pfd = {
+			.fd = fd,
+			.events = responses_count < MAX_QUEUED_RESPONSES ? POLLIN : 0,
+		};
+		int ret = poll(&pfd, 1, timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+		if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+			continue;
+
+		ssize_t n = recv(fd, in + in_len, in_size - in_len, 0);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+		stats.bytes_in += n;
+		in_len += n;
+
+		/* execute the complete requests */
+		unsigned int pos = 0;
+		while (in_len - pos >= HEADER_SIZE && responses_count < MAX_QUEUED_RESPONSES) {
+			const uint8_t *hdr = in + pos;
+			uint32_t signature = hdr[0] | hdr[1] << 8 | hdr[2] << 16 | (uint32_t)hdr[3] << 24;
+			unsigned int len = hdr[4] | hdr[5] << 8;
+
+			if (signature != DAP_PKT_HDR_SIGNATURE || hdr[6] != DAP_PKT_TYPE_REQUEST) {
+				fprintf(stderr, "invalid packet header, closing the connection\n");
+				goto out;
+			}
+			if (in_len - pos < HEADER_SIZE + len)
+				break;
+
+			process_request(hdr + HEADER_SIZE, len);
+			pos += HEADER_SIZE + len;
+		}
+		memmove(in, in + pos, in_len - pos);
+		in_len -= pos;
+	}
+
+out:
+	free(in);
+	print_stats();
+}
+
+static void handle_signal(int sig)
+{
+	(void)sig;
+	quit = 1;
+}
+
+static int listen_on(unsigned int port)
+{
+	int one = 1;
+	int fd = socket(AF_INET6, SOCK_STREAM, 0);
+
+	/* IPv4 and IPv6 through the same socket, or IPv4 only */
+	if (fd >= 0) {
+		int zero = 0;
+		struct sockaddr_in6 addr = {
+			.sin6_family = AF_INET6,
+			.sin6_port = htons(port),
+			.sin6_addr = IN6ADDR_ANY_INIT,
+		};
+		setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, 1) == 0)
+			return fd;
+		close(fd);
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+		perror("bind");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -p port      TCP port, default %u\n"
+		"  -n count     packet count reported to OpenOCD, default %u\n"
+		"  -b size      packet size reported to OpenOCD, default %u\n"
+		"  -l us        latency added to each response\n"
+		"  -s us        processing time of each packet, packets are processed in turn\n"
+		"  -w n         answer WAIT to every n-th AP access\n"
+		"  -W count     number of WAIT responses for such an access, default 1\n"
+		"  -a address   base address of the memory, default 0x%x\n"
+		"  -m size      size of the memory, default 0x%x\n"
+		"  -o           exit after the first connection\n"
+		"  -v           print every request\n",
+		name, DEFAULT_PORT, DEFAULT_PACKET_COUNT, DEFAULT_PACKET_SIZE,
+		DEFAULT_MEM_BASE, DEFAULT_MEM_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int port = DEFAULT_PORT;
+	bool once = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:n:b:l:s:w:W:a:m:ov")) != -1) {
+		unsigned long value = opt == 'o' || opt == 'v' ? 0 : strtoul(optarg, NULL, 0);
+
+		switch (opt) {
+		case 'p':
+			port = value;
+			break;
+		case 'n':
+			packet_count = value;
+			break;
+		case 'b':
+			packet_size = value;
+			break;
+		case 'l':
+			latency_us = value;
+			break;
+		case 's':
+			service_us = value;
+			break;
+		case 'w':
+			wait_every = value;
+			break;
+		case 'W':
+			wait_count = value;
+			break;
+		case 'a':
+			mem_base = value;
+			break;
+		case 'm':
+			mem_size = value;
+			break;
+		case 'o':
+			once = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (packet_count < 1 || packet_count > 255 || packet_size < 64 || packet_size > 65535) {
+		fprintf(stderr, "packet count must be 1..255 and packet size 64..65535\n");
+		return EXIT_FAILURE;
+	}
+
+	mem = calloc(1, mem_size);
+	for (unsigned int i = 0; i < MAX_QUEUED_RESPONSES && mem; i++) {
+		responses[i].data = malloc(HEADER_SIZE + packet_size);
+		if (!responses[i].data) {
+			free(mem);
+			mem = NULL;
+		}
+	}
+	if (!mem) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	struct sigaction sa = { .sa_handler = handle_signal };
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	int server = listen_on(port);
+	if (server < 0)
+		return EXIT_FAILURE;
+
+	printf("listening on port %u, memory at 0x%08" PRIx32 " (0x%" PRIx32 " bytes)\n",
+		port, mem_base, mem_size);
+	fflush(stdout);
+
+	while (!quit) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			break;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		serve(fd);
+		close(fd);
+
+		if (once)
+			break;
+	}
+
+	close(server);
+	return EXIT_SUCCESS;
+}
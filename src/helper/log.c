@@ -19,6 +19,7 @@
 #include "command.h"
 #include "replacements.h"
 #include "time_support.h"
+#include "types.h"
 #include <server/gdb_server.h>
 #include <server/server.h>
 
@@ -64,6 +65,227 @@ static const char * const log_strings[6] = {
 
 static int count;
 
+/* Deferred output: messages below LOG_LVL_INFO are formatted in log_buffer
+ * and written out when it is full, when a more severe message is logged or
+ * from the main loop through log_flush() and keep_alive(). */
+#define LOG_BUFFER_SIZE				(64 * 1024)
+#define LOG_FLUSH_INTERVAL_MS		100
+
+static char *log_buffer;
+static size_t log_buffer_len;
+static unsigned int log_flush_interval_ms = LOG_FLUSH_INTERVAL_MS;
+static int64_t log_last_flush;
+
+/* Binary log format, decoded offline by tools/log_decode.py */
+#define LOG_BINARY_MAGIC			"OOCDLOG1"
+#define LOG_BINARY_RECORD_SIZE		24
+
+static bool log_binary;
+
+/* Rate limiting of the messages emitted by each call site */
+#define LOG_RATE_SITES				1024
+#define LOG_RATE_WINDOW_MS			1000
+
+struct log_rate_site {
+	const char *file;
+	unsigned int line;
+	const char *function;
+	enum log_levels level;
+	int64_t window_start;
+	unsigned int count;
+	unsigned int suppressed;
+};
+
+static struct log_rate_site log_rate_sites[LOG_RATE_SITES];
+static unsigned int log_rate_limits[LOG_LVL_DEBUG_IO + 1];
+static bool log_rate_limit_active;
+static int64_t log_rate_last_report;
+
+static void log_flush_buffer(void)
+{
+	if (log_buffer_len) {
+		fwrite(log_buffer, 1, log_buffer_len, log_output);
+		log_buffer_len = 0;
+	}
+	fflush(log_output);
+}
+
+static void log_output_write(const void *data, size_t len)
+{
+	if (!log_buffer) {
+		fwrite(data, 1, len, log_output);
+		return;
+	}
+
+	if (log_buffer_len + len > LOG_BUFFER_SIZE)
+		log_flush_buffer();
+
+	if (len > LOG_BUFFER_SIZE) {
+		fwrite(data, 1, len, log_output);
+		return;
+	}
+
+	memcpy(log_buffer + log_buffer_len, data, len);
+	log_buffer_len += len;
+}
+
+static void log_output_printf(const char *format, ...)
+	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 1, 2)));
+
+static void log_output_printf(const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	if (!log_buffer) {
+		vfprintf(log_output, format, ap);
+		va_end(ap);
+		return;
+	}
+
+	va_list ap_copy;
+	size_t space = LOG_BUFFER_SIZE - log_buffer_len;
+	va_copy(ap_copy, ap);
+	int len = vsnprintf(log_buffer + log_buffer_len, space, format, ap_copy);
+	va_end(ap_copy);
+
+	if (len >= 0 && (size_t)len < space) {
+		log_buffer_len += len;
+	} else if (len >= 0) {
+		/* did not fit, make room and retry */
+		log_flush_buffer();
+		if ((size_t)len < LOG_BUFFER_SIZE) {
+			vsnprintf(log_buffer, LOG_BUFFER_SIZE, format, ap);
+			log_buffer_len = len;
+		} else {
+			vfprintf(log_output, format, ap);
+		}
+	}
+	va_end(ap);
+}
+
+/* Record layout: level, reserved, file length, function length, line,
+ * message length, count, timestamp, all little endian, then the strings */
+static void log_output_record(enum log_levels level, const char *file, unsigned int line,
+		const char *function, const char *string, int64_t t)
+{
+	uint8_t record[LOG_BINARY_RECORD_SIZE];
+	size_t file_len = strlen(file);
+	size_t function_len = strlen(function);
+	size_t string_len = strlen(string);
+
+	record[0] = (uint8_t)(int8_t)level;
+	record[1] = 0;
+	h_u16_to_le(&record[2], MIN(file_len, UINT16_MAX));
+	h_u16_to_le(&record[4], MIN(function_len, UINT16_MAX));
+	h_u16_to_le(&record[6], 0);
+	h_u32_to_le(&record[8], line);
+	h_u32_to_le(&record[12], string_len);
+	h_u32_to_le(&record[16], count);
+	h_u32_to_le(&record[20], t);
+
+	log_output_write(record, sizeof(record));
+	log_output_write(file, MIN(file_len, UINT16_MAX));
+	log_output_write(function, MIN(function_len, UINT16_MAX));
+	log_output_write(string, string_len);
+}
+
+/* called after each message has been output */
+static void log_output_done(enum log_levels level)
+{
+	if (!log_buffer || level <= LOG_LVL_INFO)
+		log_flush_buffer();
+}
+
+static void log_rate_report_all(bool expired_only);
+
+void log_flush(void)
+{
+	if (!log_output)
+		return;
+
+	log_rate_report_all(true);
+	log_flush_buffer();
+	log_last_flush = timeval_ms();
+}
+
+static void log_flush_if_due(int64_t current_time)
+{
+	if (log_buffer && current_time - log_last_flush >= log_flush_interval_ms)
+		log_flush();
+}
+
+/* Log the number of messages of a call site dropped by the rate limit */
+static void log_rate_report(struct log_rate_site *site)
+{
+	unsigned int suppressed = site->suppressed;
+
+	if (!suppressed)
+		return;
+
+	site->suppressed = 0;
+	log_printf_lf(site->level, site->file, site->line, site->function,
+		"%u messages suppressed by log_rate_limit", suppressed);
+}
+
+/* Report the suppressed messages of the call sites whose window has expired,
+ * or of all of them. Called from log_flush(), thus from the main loop before
+ * going idle, so that a burst that stops is accounted too. */
+static void log_rate_report_all(bool expired_only)
+{
+	if (!log_rate_limit_active)
+		return;
+
+	int64_t now = timeval_ms();
+	if (expired_only && now - log_rate_last_report < LOG_RATE_WINDOW_MS)
+		return;
+	log_rate_last_report = now;
+
+	for (unsigned int i = 0; i < LOG_RATE_SITES; i++) {
+		struct log_rate_site *site = &log_rate_sites[i];
+		if (site->suppressed && (!expired_only || now - site->window_start >= LOG_RATE_WINDOW_MS))
+			log_rate_report(site);
+	}
+}
+
+/* Return true if the message should be dropped by the per call site rate limit */
+static bool log_rate_limited(enum log_levels level, const char *file,
+		unsigned int line, const char *function)
+{
+	if (level < LOG_LVL_ERROR || level > LOG_LVL_DEBUG_IO || !log_rate_limits[level])
+		return false;
+
+	uintptr_t hash = ((uintptr_t)file >> 3) ^ (line * 2654435761u);
+	struct log_rate_site *site = &log_rate_sites[hash % LOG_RATE_SITES];
+	int64_t now = timeval_ms();
+
+	if (site->file != file || site->line != line) {
+		/* the slot is taken over by another call site */
+		log_rate_report(site);
+		site->file = file;
+		site->line = line;
+		site->function = function;
+		site->level = level;
+		site->window_start = now;
+		site->count = 0;
+		site->suppressed = 0;
+	}
+
+	if (now - site->window_start >= LOG_RATE_WINDOW_MS) {
+		site->window_start = now;
+		site->count = 0;
+		log_rate_report(site);
+	}
+
+	if (site->count >= log_rate_limits[level]) {
+		site->suppressed++;
+		return true;
+	}
+
+	site->count++;
+	return false;
+}
+
 /* forward the log to the listeners */
 static void log_forward(const char *file, unsigned int line, const char *function, const char *string)
 {
@@ -104,8 +326,11 @@ static void log_puts(enum log_levels level,
 
 	if (level == LOG_LVL_OUTPUT) {
 		/* do not prepend any headers, just print out what we were given and return */
-		fputs(string, log_output);
-		fflush(log_output);
+		if (log_binary)
+			log_output_record(level, "", 0, "", string, timeval_ms() - start);
+		else
+			log_output_write(string, strlen(string));
+		log_output_done(level);
 		return;
 	}
 
@@ -113,13 +338,15 @@ static void log_puts(enum log_levels level,
 	if (f)
 		file = f + 1;
 
-	if (debug_level >= LOG_LVL_DEBUG) {
+	if (log_binary) {
+		log_output_record(level, file, line, function, string, timeval_ms() - start);
+	} else if (debug_level >= LOG_LVL_DEBUG) {
 		/* print with count and time information */
 		int64_t t = timeval_ms() - start;
 #ifdef _DEBUG_FREE_SPACE_
 		struct mallinfo2 info = mallinfo2();
 #endif
-		fprintf(log_output, "%s%d %" PRId64 " %s:%d %s()"
+		log_output_printf("%s%d %" PRId64 " %s:%d %s()"
 #ifdef _DEBUG_FREE_SPACE_
 			FORDBLKS_FORMAT
 #endif
@@ -131,11 +358,11 @@ static void log_puts(enum log_levels level,
 	} else {
 		/* if we are using gdb through pipes then we do not want any output
 		 * to the pipe otherwise we get repeated strings */
-		fprintf(log_output, "%s%s",
+		log_output_printf("%s%s",
 			(level > LOG_LVL_USER) ? log_strings[level + 1] : "", string);
 	}
 
-	fflush(log_output);
+	log_output_done(level);
 
 	/* Never forward LOG_LVL_DEBUG, too verbose and they can be found in the log if need be */
 	if (level <= LOG_LVL_INFO)
@@ -156,6 +383,9 @@ void log_printf(enum log_levels level,
 	if (level > debug_level)
 		return;
 
+	if (log_rate_limit_active && log_rate_limited(level, file, line, function))
+		return;
+
 	va_start(ap, format);
 
 	string = alloc_vprintf(format, ap);
@@ -177,6 +407,9 @@ void log_vprintf_lf(enum log_levels level, const char *file, unsigned int line,
 	if (level > debug_level)
 		return;
 
+	if (log_rate_limit_active && log_rate_limited(level, file, line, function))
+		return;
+
 	tmp = alloc_vprintf(format, args);
 
 	if (!tmp)
@@ -242,11 +475,126 @@ COMMAND_HANDLER(handle_log_output_command)
 		command_print(CMD, "set log_output to default");
 	}
 
-	if (log_output != stderr && log_output) {
+	if (log_output) {
+		log_flush_buffer();
 		/* Close previous log file, if it was open and wasn't stderr. */
-		fclose(log_output);
+		if (log_output != stderr)
+			fclose(log_output);
 	}
 	log_output = file;
+	if (log_binary)
+		log_output_write(LOG_BINARY_MAGIC, strlen(LOG_BINARY_MAGIC));
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_flush_policy_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!CMD_ARGC) {
+		if (log_buffer)
+			command_print(CMD, "deferred %u", log_flush_interval_ms);
+		else
+			command_print(CMD, "immediate");
+		return ERROR_OK;
+	}
+
+	if (!strcmp(CMD_ARGV[0], "immediate")) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (log_buffer) {
+			log_flush();
+			free(log_buffer);
+			log_buffer = NULL;
+		}
+		return ERROR_OK;
+	}
+
+	if (strcmp(CMD_ARGV[0], "deferred"))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], log_flush_interval_ms);
+
+	if (!log_buffer) {
+		log_buffer = malloc(LOG_BUFFER_SIZE);
+		if (!log_buffer) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		log_buffer_len = 0;
+		log_last_flush = timeval_ms();
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_rate_limit_command)
+{
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!CMD_ARGC) {
+		for (int level = LOG_LVL_ERROR; level <= LOG_LVL_DEBUG_IO; level++)
+			command_print(CMD, "%d: %u", level, log_rate_limits[level]);
+		return ERROR_OK;
+	}
+
+	int level;
+	COMMAND_PARSE_NUMBER(int, CMD_ARGV[0], level);
+	if (level < LOG_LVL_ERROR || level > LOG_LVL_DEBUG_IO) {
+		command_print(CMD, "level must be between %d and %d", LOG_LVL_ERROR, LOG_LVL_DEBUG_IO);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (CMD_ARGC == 1) {
+		command_print(CMD, "%u", log_rate_limits[level]);
+		return ERROR_OK;
+	}
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], log_rate_limits[level]);
+
+	log_rate_report_all(false);
+	log_rate_limit_active = false;
+	for (level = LOG_LVL_ERROR; level <= LOG_LVL_DEBUG_IO; level++)
+		if (log_rate_limits[level])
+			log_rate_limit_active = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_format_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!CMD_ARGC) {
+		command_print(CMD, "%s", log_binary ? "binary" : "text");
+		return ERROR_OK;
+	}
+
+	bool binary;
+	if (!strcmp(CMD_ARGV[0], "binary"))
+		binary = true;
+	else if (!strcmp(CMD_ARGV[0], "text"))
+		binary = false;
+	else
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (binary == log_binary)
+		return ERROR_OK;
+
+	if (binary && (!log_output || log_output == stderr)) {
+		command_print(CMD, "binary log format requires log_output to a file");
+		return ERROR_FAIL;
+	}
+
+	log_flush_buffer();
+	log_binary = binary;
+	if (log_binary)
+		log_output_write(LOG_BINARY_MAGIC, strlen(LOG_BINARY_MAGIC));
+
 	return ERROR_OK;
 }
 
@@ -258,6 +606,29 @@ static const struct command_registration log_command_handlers[] = {
 		.help = "redirect logging to a file (default: stderr)",
 		.usage = "[file_name | 'default']",
 	},
+	{
+		.name = "log_flush_policy",
+		.handler = handle_log_flush_policy_command,
+		.mode = COMMAND_ANY,
+		.help = "write every message immediately or buffer the debug "
+			"messages and write them at least every interval_ms",
+		.usage = "['immediate' | 'deferred' [interval_ms]]",
+	},
+	{
+		.name = "log_rate_limit",
+		.handler = handle_log_rate_limit_command,
+		.mode = COMMAND_ANY,
+		.help = "limit the messages per second logged by each call site "
+			"for the given level, 0 to disable",
+		.usage = "[level [messages_per_second]]",
+	},
+	{
+		.name = "log_format",
+		.handler = handle_log_format_command,
+		.mode = COMMAND_ANY,
+		.help = "select text or binary format for the log file",
+		.usage = "['text' | 'binary']",
+	},
 	{
 		.name = "debug_level",
 		.handler = handle_debug_level_command,
@@ -298,6 +669,13 @@ void log_init(void)
 
 void log_exit(void)
 {
+	if (log_output) {
+		log_rate_report_all(false);
+		log_flush_buffer();
+	}
+	free(log_buffer);
+	log_buffer = NULL;
+
 	if (log_output && log_output != stderr) {
 		/* Close log file, if it was open and wasn't stderr. */
 		fclose(log_output);
@@ -429,6 +807,8 @@ void keep_alive(void)
 	int64_t current_time = timeval_ms();
 	int64_t delta_time = current_time - last_time;
 
+	log_flush_if_due(current_time);
+
 	if (delta_time > KEEP_ALIVE_TIMEOUT_MS) {
 		last_time = current_time;
 
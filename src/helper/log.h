@@ -62,6 +62,11 @@ __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6)));
  */
 void log_init(void);
 void log_exit(void);
+/**
+ * Write out the messages kept by the deferred flush policy.
+ * Called from the main loop before it waits for events.
+ */
+void log_flush(void);
 
 int log_register_commands(struct command_context *cmd_ctx);
 
@@ -102,7 +107,7 @@ extern int debug_level;
 #define LOG_DEBUG_IO(expr ...) \
 	do { \
 		if (debug_level >= LOG_LVL_DEBUG_IO) \
-			log_printf_lf(LOG_LVL_DEBUG, \
+			log_printf_lf(LOG_LVL_DEBUG_IO, \
 				__FILE__, __LINE__, __func__, \
 				expr); \
 	} while (0)
@@ -16,6 +16,7 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "recorder.h"
 #include <helper/bits.h>
 #include <transport/transport.h>
 
@@ -188,6 +189,8 @@ int adapter_init(struct command_context *cmd_ctx)
 
 int adapter_quit(void)
 {
+	jtag_recorder_stop();
+
 	if (is_adapter_initialized() && adapter_driver->quit) {
 		int result = adapter_driver->quit();
 		if (result != ERROR_OK)
@@ -1167,6 +1170,13 @@ static const struct command_registration adapter_command_handlers[] = {
 		.help = "List all built-in debug adapter drivers",
 		.usage = "",
 	},
+	{
+		.name = "record",
+		.mode = COMMAND_ANY,
+		.help = "Binary recorder of the JTAG and SWD traffic",
+		.usage = "",
+		.chain = jtag_recorder_command_handlers,
+	},
 	{
 		.name = "name",
 		.mode = COMMAND_ANY,
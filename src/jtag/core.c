@@ -23,6 +23,7 @@
 #include "jtag.h"
 #include "swd.h"
 #include "interface.h"
+#include "recorder.h"
 #include <transport/transport.h>
 #include <helper/jep106.h>
 #include "helper/system.h"
@@ -468,6 +469,20 @@ void jtag_add_dr_scan(struct jtag_tap *active,
 	jtag_set_error(retval);
 }
 
+void jtag_add_dr_scans(struct jtag_tap *active, unsigned int num_scans,
+	unsigned int num_fields, const struct scan_field *fields,
+	unsigned int idle_cycles, enum tap_state state)
+{
+	assert(state != TAP_RESET);
+
+	jtag_prelude(state);
+
+	int retval;
+	retval = interface_jtag_add_dr_scans(active, num_scans, num_fields, fields,
+			idle_cycles, state);
+	jtag_set_error(retval);
+}
+
 void jtag_add_plain_dr_scan(int num_bits, const uint8_t *out_bits, uint8_t *in_bits,
 	enum tap_state state)
 {
@@ -965,8 +980,12 @@ int default_interface_jtag_execute_queue(void)
 	}
 
 	struct jtag_command *cmd = jtag_command_queue_get();
+	int64_t start_us = jtag_recorder_active ? jtag_recorder_time_us() : 0;
 	int result = adapter_driver->jtag_ops->execute_queue(cmd);
 
+	if (jtag_recorder_active)
+		jtag_recorder_jtag_queue(cmd, result, start_us, jtag_recorder_time_us());
+
 	while (debug_level >= LOG_LVL_DEBUG_IO && cmd) {
 		switch (cmd->type) {
 		case JTAG_SCAN:
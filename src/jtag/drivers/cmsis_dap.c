@@ -156,6 +156,9 @@ static bool cmsis_dap_quirk_mode;  /* enable expensive workarounds */
 #define CMD_DAP_SWD_CONFIGURE     0x13
 #define CMD_DAP_SWD_SEQUENCE      0x1D
 
+/* CMSIS-DAP Atomic Commands */
+#define CMD_DAP_EXECUTE_COMMANDS  0x7F
+
 /* CMSIS-DAP JTAG Commands */
 #define CMD_DAP_JTAG_SEQ          0x14
 #define CMD_DAP_JTAG_CONFIGURE    0x15
@@ -246,16 +249,32 @@ static unsigned int pending_queue_len;
 static unsigned int tfer_max_command_size;
 static unsigned int tfer_max_response_size;
 
-/* pointers to buffers that will receive jtag scan results on the next flush */
-#define MAX_PENDING_SCAN_RESULTS 256
-static int pending_scan_result_count;
-static struct pending_scan_result pending_scan_results[MAX_PENDING_SCAN_RESULTS];
+/* Up to MAX_QUEUED_SEQ_CMDS DAP_JTAG_Sequence commands, of up to 255 sequences
+ * each, are sent in a DAP_ExecuteCommands packet if the adapter supports it */
+#define MAX_QUEUED_SEQ_CMDS 8
+
+/* A packet of JTAG sequences, written to the adapter and waiting for its
+ * response. Blocks of the pending FIFO, indexed as dap->pending_fifo */
+struct pending_jtag_packet {
+	uint8_t command;
+	/* buffers that will receive jtag scan results */
+	struct pending_scan_result *scans;
+	unsigned int scan_count;
+	/* offset in the responses of the status of each DAP_JTAG_Sequence */
+	unsigned int status_offset[MAX_QUEUED_SEQ_CMDS];
+	unsigned int cmd_count;
+};
+
+static struct pending_jtag_packet *pending_jtag;
+static unsigned int pending_jtag_max_scans;
 
-/* queued JTAG sequences that will be executed on the next flush */
-#define QUEUED_SEQ_BUF_LEN (cmsis_dap_handle->packet_usable_size - 3)
+/* queued JTAG sequences that will be executed on the next flush, as
+ * DAP_JTAG_Sequence commands including their header */
+#define QUEUED_SEQ_BUF_LEN MIN(cmsis_dap_handle->packet_usable_size, sizeof(queued_seq_buf))
 static int queued_seq_count;
 static int queued_seq_buf_end;
 static int queued_seq_tdo_ptr;
+static unsigned int queued_seq_cmd_start;
 static uint8_t queued_seq_buf[1024]; /* TODO: make dynamic / move into cmsis object */
 
 static int queued_retval;
@@ -267,6 +286,23 @@ static struct cmsis_dap *cmsis_dap_handle;
 
 static int cmsis_dap_quit(void);
 
+static int64_t cmsis_dap_time_us(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/* Fold a sample in an average of the last few samples */
+static void cmsis_dap_average(int64_t *avg, int64_t sample)
+{
+	if (*avg == 0)
+		*avg = sample;
+	else
+		*avg += (sample - *avg) / 8;
+}
+
 static int cmsis_dap_open(void)
 {
 	const struct cmsis_dap_backend *backend = NULL;
@@ -322,9 +358,18 @@ static void cmsis_dap_close(struct cmsis_dap *dap)
 
 	free(dap->packet_buffer);
 
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
-		free(dap->pending_fifo[i].transfers);
-		dap->pending_fifo[i].transfers = NULL;
+	if (dap->pending_fifo) {
+		for (unsigned int i = 0; i < dap->pending_fifo_size; i++)
+			free(dap->pending_fifo[i].transfers);
+		free(dap->pending_fifo);
+		dap->pending_fifo = NULL;
+	}
+
+	if (pending_jtag) {
+		for (unsigned int i = 0; i < dap->pending_fifo_size; i++)
+			free(pending_jtag[i].scans);
+		free(pending_jtag);
+		pending_jtag = NULL;
 	}
 
 	free(cmsis_dap_handle);
@@ -363,6 +408,7 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 	}
 
 	uint8_t current_cmd = dap->command[0];
+	int64_t start = cmsis_dap_time_us();
 	int retval = dap->backend->write(dap, txlen, LIBUSB_TIMEOUT_MS);
 	if (retval < 0)
 		return retval;
@@ -372,6 +418,8 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 	if (retval < 0)
 		return retval;
 
+	cmsis_dap_average(&dap->stats.rtt_us, cmsis_dap_time_us() - start);
+
 	uint8_t *resp = dap->response;
 	if (resp[0] == DAP_ERROR) {
 		LOG_ERROR("CMSIS-DAP command 0x%" PRIx8 " not implemented", current_cmd);
@@ -778,7 +826,7 @@ static int cmsis_dap_cmd_dap_swo_data(
 
 static void cmsis_dap_swd_discard_all_pending(struct cmsis_dap *dap)
 {
-	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++)
+	for (unsigned int i = 0; i < dap->pending_fifo_size; i++)
 		dap->pending_fifo[i].transfer_count = 0;
 
 	dap->pending_fifo_put_idx = 0;
@@ -872,6 +920,7 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		}
 	}
 
+	block->sent_us = cmsis_dap_time_us();
 	int retval = dap->backend->write(dap, idx, LIBUSB_TIMEOUT_MS);
 	if (retval < 0) {
 		queued_retval = retval;
@@ -884,6 +933,10 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	if (dap->pending_fifo_block_count > packet_count)
 		LOG_ERROR("internal: too much pending writes %u", dap->pending_fifo_block_count);
 
+	dap->stats.packets++;
+	dap->stats.transfers += block->transfer_count;
+	dap->stats.in_flight_sum += dap->pending_fifo_block_count;
+
 	return;
 
 skip:
@@ -974,6 +1027,15 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 				 transfer_count, dap->pending_fifo_get_idx,
 				 blocking ? "blocking" : "nonblocking");
 
+	/* A request sent before the previous response arrived was queued in
+	 * the probe: the gap between the two responses is its service time,
+	 * scaled to a full packet */
+	int64_t now = cmsis_dap_time_us();
+	if (block->sent_us < dap->stats.last_response_us)
+		cmsis_dap_average(&dap->stats.service_us,
+			(now - dap->stats.last_response_us) * pending_queue_len / transfer_count);
+	dap->stats.last_response_us = now;
+
 	for (unsigned int i = 0; i < transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		if (transfer->cmd & SWD_CMD_RNW) {
@@ -1003,6 +1065,38 @@ skip:
 	dap->pending_fifo_block_count--;
 }
 
+/*
+ * Size the number of requests in flight, while none is pending. It covers
+ * the packet count of the probe and, when the backend queues the requests,
+ * the bandwidth-delay product: enough full packets to keep the probe busy
+ * during a round trip.
+ */
+static void cmsis_dap_update_depth(struct cmsis_dap *dap)
+{
+	assert(dap->pending_fifo_block_count == 0);
+
+	unsigned int depth = MIN(dap->probe_packet_count, dap->pending_fifo_size);
+
+	if (dap->backend->queues_requests) {
+		int64_t service_us = dap->stats.service_us;
+		if (!service_us) {
+			/* until measured, about 50 clocks per transfer */
+			unsigned int khz = MAX(adapter_get_speed_khz(), 1u);
+			service_us = (int64_t)pending_queue_len * 50 * 1000 / khz;
+		}
+		if (service_us > 0) {
+			int64_t bdp = 1 + DIV_ROUND_UP(dap->stats.rtt_us, service_us);
+			depth = MAX(depth, (unsigned int)MIN(bdp, (int64_t)dap->pending_fifo_size));
+		}
+	}
+
+	depth = MAX(depth, 1u);
+	if (depth != dap->packet_count)
+		LOG_DEBUG("CMSIS-DAP: %u requests in flight (round trip %" PRId64 " us, service %" PRId64 " us)",
+			depth, dap->stats.rtt_us, dap->stats.service_us);
+	dap->packet_count = depth;
+}
+
 static int cmsis_dap_swd_run_queue(void)
 {
 	if (cmsis_dap_handle->write_count + cmsis_dap_handle->read_count) {
@@ -1017,6 +1111,7 @@ static int cmsis_dap_swd_run_queue(void)
 
 	cmsis_dap_handle->pending_fifo_put_idx = 0;
 	cmsis_dap_handle->pending_fifo_get_idx = 0;
+	cmsis_dap_update_depth(cmsis_dap_handle);
 
 	int retval = queued_retval;
 	queued_retval = ERROR_OK;
@@ -1095,8 +1190,10 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 		cmsis_dap_swd_write_from_queue(cmsis_dap_handle);
 
 		unsigned int packet_count = cmsis_dap_quirk_mode ? 1 : cmsis_dap_handle->packet_count;
-		if (cmsis_dap_handle->pending_fifo_block_count >= packet_count)
+		if (cmsis_dap_handle->pending_fifo_block_count >= packet_count) {
+			cmsis_dap_handle->stats.full_waits++;
 			cmsis_dap_swd_read_process(cmsis_dap_handle, CMSIS_DAP_BLOCKING);
+		}
 	}
 
 	assert(cmsis_dap_handle->pending_fifo[cmsis_dap_handle->pending_fifo_put_idx].transfer_count < pending_queue_len);
@@ -1365,6 +1462,7 @@ static int cmsis_dap_init(void)
 	/* Be conservative and suppress submitting multiple HID requests
 	 * until we get packet count info from the adaptor */
 	cmsis_dap_handle->packet_count = 1;
+	cmsis_dap_handle->probe_packet_count = 1;
 
 	/* INFO_ID_PKT_SZ - short */
 	retval = cmsis_dap_cmd_dap_info(INFO_ID_PKT_SZ, &data);
@@ -1401,13 +1499,27 @@ static int cmsis_dap_init(void)
 	if (data[0] == 1) { /* byte */
 		unsigned int pkt_cnt = data[1];
 		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			cmsis_dap_handle->probe_packet_count = pkt_cnt;
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %u", pkt_cnt);
 	}
 
-	LOG_DEBUG("Allocating FIFO for %u pending packets", cmsis_dap_handle->packet_count);
-	for (unsigned int i = 0; i < cmsis_dap_handle->packet_count; i++) {
+	/* a backend queuing the requests can go past the packets of the probe */
+	if (cmsis_dap_handle->backend->queues_requests)
+		cmsis_dap_handle->pending_fifo_size = MAX_PENDING_REQUESTS;
+	else
+		cmsis_dap_handle->pending_fifo_size = MIN(MAX_PENDING_REQUESTS,
+			cmsis_dap_handle->probe_packet_count);
+
+	LOG_DEBUG("Allocating FIFO for %u pending packets", cmsis_dap_handle->pending_fifo_size);
+	cmsis_dap_handle->pending_fifo = calloc(cmsis_dap_handle->pending_fifo_size,
+		sizeof(struct pending_request_block));
+	if (!cmsis_dap_handle->pending_fifo) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
+	for (unsigned int i = 0; i < cmsis_dap_handle->pending_fifo_size; i++) {
 		cmsis_dap_handle->pending_fifo[i].transfers = malloc(pending_queue_len
 									 * sizeof(struct pending_transfer_result));
 		if (!cmsis_dap_handle->pending_fifo[i].transfers) {
@@ -1416,6 +1528,26 @@ static int cmsis_dap_init(void)
 			goto init_err;
 		}
 	}
+	cmsis_dap_update_depth(cmsis_dap_handle);
+
+	if (!swd_mode) {
+		/* a scan result needs at least the control byte and one byte */
+		pending_jtag_max_scans = cmsis_dap_handle->packet_usable_size / 2;
+		pending_jtag = calloc(cmsis_dap_handle->pending_fifo_size, sizeof(*pending_jtag));
+		if (!pending_jtag) {
+			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+			retval = ERROR_FAIL;
+			goto init_err;
+		}
+		for (unsigned int i = 0; i < cmsis_dap_handle->pending_fifo_size; i++) {
+			pending_jtag[i].scans = calloc(pending_jtag_max_scans, sizeof(struct pending_scan_result));
+			if (!pending_jtag[i].scans) {
+				LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+				retval = ERROR_FAIL;
+				goto init_err;
+			}
+		}
+	}
 
 	/* Intentionally not checked for error, just logs an info message
 	 * not vital for further debugging */
@@ -1602,58 +1734,119 @@ static void debug_parse_cmsis_buf(const uint8_t *cmd, int cmdlen)
 }
 #endif
 
-static void cmsis_dap_flush(void)
+/* Write the queued JTAG sequences to the adapter, without waiting for the response */
+static void cmsis_dap_jtag_write_queue(struct cmsis_dap *dap)
 {
-	if (!queued_seq_count)
+	struct pending_jtag_packet *packet = &pending_jtag[dap->pending_fifo_put_idx];
+
+	if (!packet->cmd_count)
 		return;
 
-	LOG_DEBUG_IO("Flushing %d queued sequences (%d bytes) with %d pending scan results to capture",
-		queued_seq_count, queued_seq_buf_end, pending_scan_result_count);
+	/* close the last DAP_JTAG_Sequence */
+	queued_seq_buf[queued_seq_cmd_start + 1] = queued_seq_count;
+
+	LOG_DEBUG_IO("Writing %u commands of queued sequences (%d bytes) with %u pending scan results "
+		"to capture, FIFO index %u", packet->cmd_count, queued_seq_buf_end, packet->scan_count,
+		dap->pending_fifo_put_idx);
 
 	/* prepare CMSIS-DAP packet */
-	uint8_t *command = cmsis_dap_handle->command;
-	command[0] = CMD_DAP_JTAG_SEQ;
-	command[1] = queued_seq_count;
-	memcpy(&command[2], queued_seq_buf, queued_seq_buf_end);
+	uint8_t *command = dap->command;
+	unsigned int len = 0;
+	if (packet->cmd_count > 1) {
+		command[len++] = CMD_DAP_EXECUTE_COMMANDS;
+		command[len++] = packet->cmd_count;
+	}
+	memcpy(&command[len], queued_seq_buf, queued_seq_buf_end);
+	len += queued_seq_buf_end;
+	packet->command = command[0];
 
 #ifdef CMSIS_DAP_JTAG_DEBUG
-	debug_parse_cmsis_buf(command, queued_seq_buf_end + 2);
+	debug_parse_cmsis_buf(command, len);
 #endif
 
 	/* send command to USB device */
-	int retval = cmsis_dap_xfer(cmsis_dap_handle, queued_seq_buf_end + 2);
-
-	uint8_t *resp = cmsis_dap_handle->response;
-	if (retval != ERROR_OK || resp[1] != DAP_OK) {
+	int retval = dap->backend->write(dap, len, LIBUSB_TIMEOUT_MS);
+	if (retval < 0) {
 		LOG_ERROR("CMSIS-DAP command CMD_DAP_JTAG_SEQ failed.");
 		exit(-1);
 	}
 
-#ifdef CMSIS_DAP_JTAG_DEBUG
-	LOG_DEBUG_IO("USB response buf:");
-	for (int c = 0; c < queued_seq_buf_end + 3; ++c)
-		printf("%02X ", resp[c]);
-	printf("\n");
-#endif
+	unsigned int packet_count = cmsis_dap_quirk_mode ? 1 : dap->packet_count;
+	dap->pending_fifo_put_idx = (dap->pending_fifo_put_idx + 1) % packet_count;
+	dap->pending_fifo_block_count++;
+
+	/* reset */
+	queued_seq_count = 0;
+	queued_seq_buf_end = 0;
+	queued_seq_tdo_ptr = 0;
+	queued_seq_cmd_start = 0;
+}
+
+/* Wait for the response to the oldest packet of JTAG sequences and copy the scan results */
+static void cmsis_dap_jtag_read_process(struct cmsis_dap *dap)
+{
+	struct pending_jtag_packet *packet = &pending_jtag[dap->pending_fifo_get_idx];
+
+	int retval = dap->backend->read(dap, LIBUSB_TIMEOUT_MS, CMSIS_DAP_BLOCKING);
+
+	uint8_t *resp = dap->response;
+	unsigned int hdr = packet->command == CMD_DAP_EXECUTE_COMMANDS ? 2 : 0;
+	bool ok = retval > 0 && resp[0] == packet->command
+		&& (!hdr || resp[1] == packet->cmd_count);
+	for (unsigned int i = 0; ok && i < packet->cmd_count; i++)
+		ok = resp[hdr + packet->status_offset[i]] == DAP_OK;
+	if (!ok) {
+		LOG_ERROR("CMSIS-DAP command CMD_DAP_JTAG_SEQ failed.");
+		exit(-1);
+	}
 
 	/* copy scan results into client buffers */
-	for (int i = 0; i < pending_scan_result_count; ++i) {
-		struct pending_scan_result *scan = &pending_scan_results[i];
-		LOG_DEBUG_IO("Copying pending_scan_result %d/%d: %d bits from byte %d -> buffer + %d bits",
-			i, pending_scan_result_count, scan->length, scan->first + 2, scan->buffer_offset);
+	for (unsigned int i = 0; i < packet->scan_count; ++i) {
+		struct pending_scan_result *scan = &packet->scans[i];
+		LOG_DEBUG_IO("Copying pending_scan_result %u/%u: %u bits from byte %u -> buffer + %u bits",
+			i, packet->scan_count, scan->length, hdr + scan->first, scan->buffer_offset);
 #ifdef CMSIS_DAP_JTAG_DEBUG
 		for (uint32_t b = 0; b < DIV_ROUND_UP(scan->length, 8); ++b)
-			printf("%02X ", resp[2+scan->first+b]);
+			printf("%02X ", resp[hdr + scan->first + b]);
 		printf("\n");
 #endif
-		bit_copy(scan->buffer, scan->buffer_offset, &resp[2 + scan->first], 0, scan->length);
+		bit_copy(scan->buffer, scan->buffer_offset, &resp[hdr + scan->first], 0, scan->length);
 	}
 
-	/* reset */
-	queued_seq_count = 0;
-	queued_seq_buf_end = 0;
-	queued_seq_tdo_ptr = 0;
-	pending_scan_result_count = 0;
+	packet->scan_count = 0;
+	packet->cmd_count = 0;
+
+	unsigned int packet_count = cmsis_dap_quirk_mode ? 1 : dap->packet_count;
+	dap->pending_fifo_get_idx = (dap->pending_fifo_get_idx + 1) % packet_count;
+	dap->pending_fifo_block_count--;
+}
+
+/* Write the full packet of sequences, keeping up to packet_count in flight */
+static void cmsis_dap_jtag_send(struct cmsis_dap *dap)
+{
+	cmsis_dap_jtag_write_queue(dap);
+
+	unsigned int packet_count = cmsis_dap_quirk_mode ? 1 : dap->packet_count;
+	if (dap->pending_fifo_block_count >= packet_count)
+		cmsis_dap_jtag_read_process(dap);
+}
+
+static void cmsis_dap_flush(void)
+{
+	struct cmsis_dap *dap = cmsis_dap_handle;
+
+	/* no JTAG FIFO in SWD mode, whose packets are not ours to drain */
+	if (!pending_jtag)
+		return;
+
+	cmsis_dap_jtag_write_queue(dap);
+
+	while (dap->pending_fifo_block_count)
+		cmsis_dap_jtag_read_process(dap);
+
+	dap->pending_fifo_put_idx = 0;
+	dap->pending_fifo_get_idx = 0;
+	cmsis_dap_update_depth(dap);
 }
 
 /* queue a sequence of bits to clock out TDI / in TDO, executing if the buffer is full.
@@ -1692,10 +1885,37 @@ static void cmsis_dap_add_jtag_sequence(unsigned int s_len, const uint8_t *seque
 		return;
 	}
 
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	struct pending_jtag_packet *packet = &pending_jtag[dap->pending_fifo_put_idx];
+	bool atomic_cmds = (dap->caps & INFO_CAPS_ATOMIC_CMDS) && !cmsis_dap_quirk_mode;
+
+	/* Start a DAP_JTAG_Sequence if none is open or if it is full. With
+	 * several of them the packet is a DAP_ExecuteCommands */
+	bool new_cmd = !packet->cmd_count || queued_seq_count >= 255;
+	unsigned int cmd_count = packet->cmd_count + (new_cmd ? 1 : 0);
 	unsigned int cmd_len = 1 + DIV_ROUND_UP(s_len, 8);
-	if (queued_seq_count >= 255 || queued_seq_buf_end + cmd_len > QUEUED_SEQ_BUF_LEN)
+	unsigned int len = (cmd_count > 1 ? 2 : 0) + queued_seq_buf_end + (new_cmd ? 2 : 0) + cmd_len;
+
+	if (len > QUEUED_SEQ_BUF_LEN
+			|| (cmd_count > 1 && (!atomic_cmds || cmd_count > MAX_QUEUED_SEQ_CMDS))
+			|| (tdo_buffer && packet->scan_count == pending_jtag_max_scans)) {
 		/* empty out the buffer */
-		cmsis_dap_flush();
+		cmsis_dap_jtag_send(dap);
+		packet = &pending_jtag[dap->pending_fifo_put_idx];
+		new_cmd = true;
+	}
+
+	if (new_cmd) {
+		if (packet->cmd_count)
+			queued_seq_buf[queued_seq_cmd_start + 1] = queued_seq_count;
+		queued_seq_cmd_start = queued_seq_buf_end;
+		queued_seq_buf[queued_seq_buf_end++] = CMD_DAP_JTAG_SEQ;
+		queued_seq_buf[queued_seq_buf_end++] = 0;	/* sequence count, set when closed */
+		/* the response starts with the command and its status */
+		packet->status_offset[packet->cmd_count++] = queued_seq_tdo_ptr + 1;
+		queued_seq_tdo_ptr += 2;
+		queued_seq_count = 0;
+	}
 
 	++queued_seq_count;
 
@@ -1713,7 +1933,7 @@ static void cmsis_dap_add_jtag_sequence(unsigned int s_len, const uint8_t *seque
 	queued_seq_buf_end += cmd_len;
 
 	if (tdo_buffer) {
-		struct pending_scan_result *scan = &pending_scan_results[pending_scan_result_count++];
+		struct pending_scan_result *scan = &packet->scans[packet->scan_count++];
 		scan->first = queued_seq_tdo_ptr;
 		queued_seq_tdo_ptr += DIV_ROUND_UP(s_len, 8);
 		scan->length = s_len;
@@ -1729,11 +1949,14 @@ static void cmsis_dap_add_tms_sequence(const uint8_t *sequence, int s_len)
 	/* we use a series of CMD_DAP_JTAG_SEQ commands to toggle TMS,
 	   because even though it seems ridiculously inefficient, it
 	   allows us to combine TMS and scan sequences into the same
-	   USB packet. */
-	/* TODO: combine runs of the same tms value */
-	for (int i = 0; i < s_len; ++i) {
+	   USB packet. Runs of the same tms value share a sequence. */
+	for (int i = 0; i < s_len; ) {
 		bool bit = (sequence[i / 8] & (1 << (i % 8))) != 0;
-		cmsis_dap_add_jtag_sequence(1, NULL, 0, bit, NULL, 0);
+		int run = 1;
+		while (i + run < s_len && ((sequence[(i + run) / 8] & (1 << ((i + run) % 8))) != 0) == bit)
+			run++;
+		cmsis_dap_add_jtag_sequence(run, NULL, 0, bit, NULL, 0);
+		i += run;
 	}
 }
 
@@ -1887,11 +2110,10 @@ static void cmsis_dap_execute_pathmove(struct jtag_command *cmd)
 
 static void cmsis_dap_stableclocks(unsigned int num_cycles)
 {
-	uint8_t tms = tap_get_state() == TAP_RESET;
-	/* TODO: Perform optimizations? */
-	/* Execute num_cycles. */
-	for (unsigned int i = 0; i < num_cycles; i++)
-		cmsis_dap_add_tms_sequence(&tms, 1);
+	bool tms = tap_get_state() == TAP_RESET;
+
+	/* Execute num_cycles, split in sequences of up to 64 clocks */
+	cmsis_dap_add_jtag_sequence(num_cycles, NULL, 0, tms, NULL, 0);
 }
 
 static void cmsis_dap_runtest(unsigned int num_cycles)
@@ -1930,6 +2152,8 @@ static void cmsis_dap_execute_stableclocks(struct jtag_command *cmd)
 static void cmsis_dap_execute_tms(struct jtag_command *cmd)
 {
 	LOG_DEBUG_IO("TMS: %u bits", cmd->cmd.tms->num_bits);
+	/* sent on its own, after the queued sequences */
+	cmsis_dap_flush();
 	cmsis_dap_cmd_dap_swj_sequence(cmd->cmd.tms->num_bits, cmd->cmd.tms->bits);
 }
 
@@ -2162,6 +2386,45 @@ COMMAND_HANDLER(cmsis_dap_handle_info_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct cmsis_dap *dap = cmsis_dap_handle;
+	struct cmsis_dap_pipeline_stats *stats = &dap->stats;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		stats->packets = 0;
+		stats->transfers = 0;
+		stats->in_flight_sum = 0;
+		stats->full_waits = 0;
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "backend %s, %u requests in flight (probe packet count %u, up to %u)",
+		dap->backend->name, dap->packet_count, dap->probe_packet_count, dap->pending_fifo_size);
+	command_print(CMD, "round trip %" PRId64 " us, full packet service %" PRId64 " us",
+		stats->rtt_us, stats->service_us);
+
+	if (!stats->packets)
+		return ERROR_OK;
+
+	command_print(CMD, "%" PRIu64 " packets, %" PRIu64 " transfers, %u%% of the packet capacity",
+		stats->packets, stats->transfers,
+		(unsigned int)(stats->transfers * 100 / (stats->packets * pending_queue_len)));
+	command_print(CMD, "%u.%02u requests in flight on average, %u%% of the depth, %" PRIu64
+		" packets waited for a response",
+		(unsigned int)(stats->in_flight_sum / stats->packets),
+		(unsigned int)(stats->in_flight_sum * 100 / stats->packets % 100),
+		(unsigned int)(stats->in_flight_sum * 100 / (stats->packets * dap->packet_count)),
+		stats->full_waits);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(cmsis_dap_handle_cmd_command)
 {
 	uint8_t *command = cmsis_dap_handle->command;
@@ -2264,6 +2527,13 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.usage = "",
 		.help = "show cmsis-dap info",
 	},
+	{
+		.name = "stats",
+		.handler = &cmsis_dap_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "show the use of the pipeline of pending requests",
+	},
 	{
 		.name = "cmd",
 		.handler = &cmsis_dap_handle_cmd_command,
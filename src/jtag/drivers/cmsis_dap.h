@@ -3,6 +3,7 @@
 #ifndef OPENOCD_JTAG_DRIVERS_CMSIS_DAP_H
 #define OPENOCD_JTAG_DRIVERS_CMSIS_DAP_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 struct cmsis_dap_backend;
@@ -14,14 +15,32 @@ struct pending_transfer_result {
 	void *buffer;
 };
 
-/* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
-#define MAX_PENDING_REQUESTS 4
+/* Up to packet_count requests may be issued until the first response
+ * arrives. packet_count is sized at run time from the packet count of the
+ * probe, the backend and the measured latency, up to MAX_PENDING_REQUESTS */
+#define MAX_PENDING_REQUESTS 32
 
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	unsigned int transfer_count;
 	uint8_t command;
+	/* time the request was written, in microseconds */
+	int64_t sent_us;
+};
+
+/* Measurements of the pending requests pipeline */
+struct cmsis_dap_pipeline_stats {
+	/* round trip of a request alone on the link, average in microseconds */
+	int64_t rtt_us;
+	/* time the probe takes to process a full packet, average in microseconds */
+	int64_t service_us;
+	int64_t last_response_us;
+	uint64_t packets;
+	uint64_t transfers;
+	/* sum of the requests in flight after each packet is written */
+	uint64_t in_flight_sum;
+	/* packets that had to wait for a response to be written */
+	uint64_t full_waits;
 };
 
 struct cmsis_dap {
@@ -45,12 +64,18 @@ struct cmsis_dap {
 	uint8_t common_swd_cmd;
 	bool swd_cmds_differ;
 
-	/* Pending requests are organized as a FIFO - circular buffer */
-	struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
+	/* Pending requests are organized as a FIFO - circular buffer.
+	 * packet_count blocks are in use, out of pending_fifo_size allocated */
+	struct pending_request_block *pending_fifo;
+	unsigned int pending_fifo_size;
 	unsigned int packet_count;
 	unsigned int pending_fifo_put_idx, pending_fifo_get_idx;
 	unsigned int pending_fifo_block_count;
 
+	/* Packet count reported by the probe */
+	unsigned int probe_packet_count;
+	struct cmsis_dap_pipeline_stats stats;
+
 	uint16_t caps;
 
 	uint32_t swo_buf_sz;
@@ -65,6 +90,9 @@ enum cmsis_dap_blocking {
 
 struct cmsis_dap_backend {
 	const char *name;
+	/* The transport queues the requests itself, so more requests than the
+	 * packet count of the probe can be in flight */
+	bool queues_requests;
 	int (*open)(struct cmsis_dap *dap, uint16_t vids[], uint16_t pids[], const char *serial);
 	void (*close)(struct cmsis_dap *dap);
 	int (*read)(struct cmsis_dap *dap, int transfer_timeout_ms,
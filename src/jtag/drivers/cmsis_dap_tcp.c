@@ -429,6 +429,7 @@ const struct command_registration cmsis_dap_tcp_subcommand_handlers[] = {
 
 const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
 	.name = "tcp",
+	.queues_requests = true,
 	.open = cmsis_dap_tcp_open,
 	.close = cmsis_dap_tcp_close,
 	.read = cmsis_dap_tcp_read,
@@ -183,6 +183,91 @@ int interface_jtag_add_dr_scan(struct jtag_tap *active, int in_num_fields,
 	return ERROR_OK;
 }
 
+/**
+ * see jtag_add_dr_scans()
+ *
+ */
+int interface_jtag_add_dr_scans(struct jtag_tap *active, unsigned int num_scans,
+		unsigned int num_fields, const struct scan_field *in_fields,
+		unsigned int idle_cycles, enum tap_state state)
+{
+	size_t bypass_devices = 0;
+	size_t all_devices = 0;
+
+	for (struct jtag_tap *tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
+		all_devices++;
+
+		if (tap->bypass)
+			bypass_devices++;
+	}
+
+	if (all_devices == bypass_devices) {
+		LOG_ERROR("At least one TAP shouldn't be in BYPASS mode");
+
+		return ERROR_FAIL;
+	}
+
+	if (!num_scans)
+		return ERROR_OK;
+
+	/* one allocation for the whole list */
+	const size_t fields_per_scan = num_fields + bypass_devices;
+	const size_t num_cmds = num_scans * (idle_cycles ? 2 : 1);
+	struct jtag_command *cmds = cmd_queue_alloc(num_cmds * sizeof(struct jtag_command));
+	struct scan_command *scans = cmd_queue_alloc(num_scans * sizeof(struct scan_command));
+	struct scan_field *out_fields = cmd_queue_alloc(num_scans * fields_per_scan * sizeof(struct scan_field));
+	struct runtest_command *runtest = NULL;
+
+	if (idle_cycles) {
+		runtest = cmd_queue_alloc(sizeof(struct runtest_command));
+		runtest->num_cycles = idle_cycles;
+		runtest->end_state = state;
+	}
+
+	struct jtag_command *cmd = cmds;
+	struct scan_field *field = out_fields;
+
+	for (unsigned int i = 0; i < num_scans; i++) {
+		struct scan_command *scan = scans + i;
+
+		cmd->type = JTAG_SCAN;
+		cmd->cmd.scan = scan;
+		jtag_queue_command(cmd++);
+
+		scan->ir_scan = false;
+		scan->num_fields = fields_per_scan;
+		scan->fields = field;
+		scan->end_state = state;
+
+		for (struct jtag_tap *tap = jtag_tap_next_enabled(NULL); tap; tap = jtag_tap_next_enabled(tap)) {
+			if (!tap->bypass) {
+				assert(active == tap);
+
+				/* reference the caller's buffers, no copy */
+				memcpy(field, in_fields + i * num_fields, num_fields * sizeof(*field));
+				field += num_fields;
+			} else {
+				field->num_bits = 1;
+				field->out_value = NULL;
+				field->in_value = NULL;
+
+				field++;
+			}
+		}
+
+		if (runtest) {
+			/* the runtest command is never modified, share it */
+			cmd->type = JTAG_RUNTEST;
+			cmd->cmd.runtest = runtest;
+			jtag_queue_command(cmd++);
+		}
+	}
+
+	assert(field == out_fields + num_scans * fields_per_scan);
+
+	return ERROR_OK;
+}
+
 static int jtag_add_plain_scan(int num_bits, const uint8_t *out_bits,
 		uint8_t *in_bits, enum tap_state state, bool ir_scan)
 {
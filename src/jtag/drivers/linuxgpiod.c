@@ -27,6 +27,20 @@ static int last_swdio;
 static bool last_stored;
 static bool swdio_input;
 
+/*
+ * The JTAG data and clock lines, requested as a single bulk when they sit
+ * on the same chip with the same request flags, so that a clock edge is a
+ * single ioctl. The clock line is always the last one. Not used for SWD:
+ * swdio is released on each turnaround, and releasing swclk with it would
+ * let it float on the GPIO controllers that reset a freed line.
+ */
+#define OUT_BULK_MAX_LINES	3
+
+static struct gpiod_line_bulk out_bulk;
+static int out_bulk_vals[OUT_BULK_MAX_LINES];
+static struct gpiod_line_request_config out_bulk_config;
+static bool out_bulk_valid;
+
 static const struct adapter_gpio_config *adapter_gpio_config;
 
 /*
@@ -78,23 +92,41 @@ static int linuxgpiod_write(int tck, int tms, int tdi)
 		first_time = 1;
 	}
 
-	if (tdi != last_tdi) {
-		retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TDI], tdi);
-		if (retval < 0)
-			LOG_WARNING("writing tdi failed");
-	}
+	if (out_bulk_valid) {
+		/* data lines change while tck is low, keep tck rising last */
+		if (tck && !last_tck && (tdi != last_tdi || tms != last_tms)) {
+			out_bulk_vals[0] = tdi;
+			out_bulk_vals[1] = tms;
+			out_bulk_vals[2] = last_tck;
+			if (gpiod_line_set_value_bulk(&out_bulk, out_bulk_vals) < 0)
+				LOG_WARNING("writing tdi/tms failed");
+		}
+		if (tdi != last_tdi || tms != last_tms || tck != last_tck) {
+			out_bulk_vals[0] = tdi;
+			out_bulk_vals[1] = tms;
+			out_bulk_vals[2] = tck;
+			if (gpiod_line_set_value_bulk(&out_bulk, out_bulk_vals) < 0)
+				LOG_WARNING("writing tdi/tms/tck failed");
+		}
+	} else {
+		if (tdi != last_tdi) {
+			retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TDI], tdi);
+			if (retval < 0)
+				LOG_WARNING("writing tdi failed");
+		}
 
-	if (tms != last_tms) {
-		retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TMS], tms);
-		if (retval < 0)
-			LOG_WARNING("writing tms failed");
-	}
+		if (tms != last_tms) {
+			retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TMS], tms);
+			if (retval < 0)
+				LOG_WARNING("writing tms failed");
+		}
 
-	/* write clk last */
-	if (tck != last_tck) {
-		retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TCK], tck);
-		if (retval < 0)
-			LOG_WARNING("writing tck failed");
+		/* write clk last */
+		if (tck != last_tck) {
+			retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TCK], tck);
+			if (retval < 0)
+				LOG_WARNING("writing tck failed");
+		}
 	}
 
 	last_tdi = tdi;
@@ -252,58 +284,70 @@ static bool linuxgpiod_swd_mode_possible(void)
 	return true;
 }
 
-static inline void helper_release(enum adapter_gpio_config_index idx)
+static int linuxgpiod_quit(void)
 {
-	if (gpiod_line[idx]) {
-		gpiod_line_release(gpiod_line[idx]);
-		gpiod_line[idx] = NULL;
+	LOG_DEBUG("linuxgpiod_quit");
+
+	/* the lines of the bulk share one chip, release them all before closing it */
+	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i) {
+		if (gpiod_line[i]) {
+			gpiod_line_release(gpiod_line[i]);
+			gpiod_line[i] = NULL;
+		}
 	}
-	if (gpiod_chip[idx]) {
-		gpiod_chip_close(gpiod_chip[idx]);
-		gpiod_chip[idx] = NULL;
+
+	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i) {
+		if (gpiod_chip[i]) {
+			gpiod_chip_close(gpiod_chip[i]);
+			gpiod_chip[i] = NULL;
+		}
 	}
-}
 
-static int linuxgpiod_quit(void)
-{
-	LOG_DEBUG("linuxgpiod_quit");
-	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i)
-		helper_release(i);
+	out_bulk_valid = false;
 
 	return ERROR_OK;
 }
 
-static int helper_get_line(enum adapter_gpio_config_index idx)
+/* Get the line from its own chip, or from @a chip when not NULL */
+static int helper_get_line_handle(enum adapter_gpio_config_index idx, struct gpiod_chip *chip)
 {
-	if (!is_gpio_config_valid(idx))
-		return ERROR_OK;
-
-	int dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT, flags = 0, val = 0, retval;
-
-	gpiod_chip[idx] = gpiod_chip_open_by_number(adapter_gpio_config[idx].chip_num);
-	if (!gpiod_chip[idx]) {
-		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[idx].chip_num,
-			adapter_gpio_get_name(idx));
-		return ERROR_JTAG_INIT_FAILED;
+	if (!chip) {
+		gpiod_chip[idx] = gpiod_chip_open_by_number(adapter_gpio_config[idx].chip_num);
+		if (!gpiod_chip[idx]) {
+			LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[idx].chip_num,
+				adapter_gpio_get_name(idx));
+			return ERROR_JTAG_INIT_FAILED;
+		}
+		chip = gpiod_chip[idx];
 	}
 
-	gpiod_line[idx] = gpiod_chip_get_line(gpiod_chip[idx], adapter_gpio_config[idx].gpio_num);
+	gpiod_line[idx] = gpiod_chip_get_line(chip, adapter_gpio_config[idx].gpio_num);
 	if (!gpiod_line[idx]) {
 		LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx));
 		return ERROR_JTAG_INIT_FAILED;
 	}
 
+	return ERROR_OK;
+}
+
+static void helper_line_config(enum adapter_gpio_config_index idx,
+		struct gpiod_line_request_config *config, int *val)
+{
+	int dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT, flags = 0;
+
+	*val = 0;
+
 	switch (adapter_gpio_config[idx].init_state) {
 	case ADAPTER_GPIO_INIT_STATE_INPUT:
 		dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT;
 		break;
 	case ADAPTER_GPIO_INIT_STATE_INACTIVE:
 		dir = GPIOD_LINE_REQUEST_DIRECTION_OUTPUT;
-		val = 0;
+		*val = 0;
 		break;
 	case ADAPTER_GPIO_INIT_STATE_ACTIVE:
 		dir = GPIOD_LINE_REQUEST_DIRECTION_OUTPUT;
-		val = 1;
+		*val = 1;
 		break;
 	}
 
@@ -345,13 +389,17 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 	if (adapter_gpio_config[idx].active_low)
 		flags |= GPIOD_LINE_REQUEST_FLAG_ACTIVE_LOW;
 
-	struct gpiod_line_request_config config = {
+	*config = (struct gpiod_line_request_config) {
 		.consumer = "OpenOCD",
 		.request_type = dir,
 		.flags = flags,
 	};
+}
 
-	retval = gpiod_line_request(gpiod_line[idx], &config, val);
+static int helper_request_line(enum adapter_gpio_config_index idx,
+		const struct gpiod_line_request_config *config, int val)
+{
+	int retval = gpiod_line_request(gpiod_line[idx], config, val);
 	if (retval < 0) {
 		LOG_ERROR("Error requesting gpio line %s", adapter_gpio_get_name(idx));
 		return ERROR_JTAG_INIT_FAILED;
@@ -360,6 +408,76 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 	return ERROR_OK;
 }
 
+static int helper_get_line(enum adapter_gpio_config_index idx)
+{
+	if (!is_gpio_config_valid(idx))
+		return ERROR_OK;
+
+	struct gpiod_line_request_config config;
+	int val;
+
+	int retval = helper_get_line_handle(idx, NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	helper_line_config(idx, &config, &val);
+	return helper_request_line(idx, &config, val);
+}
+
+/*
+ * Request the data and clock lines, clock last, as the output bulk when they
+ * are all outputs on the same chip with the same flags, else one by one.
+ */
+static int helper_get_out_bulk(const enum adapter_gpio_config_index *idx, unsigned int count)
+{
+	struct gpiod_line_request_config config[OUT_BULK_MAX_LINES];
+	int val[OUT_BULK_MAX_LINES];
+	bool bulk = true;
+	int retval;
+
+	assert(count <= OUT_BULK_MAX_LINES);
+
+	for (unsigned int i = 0; i < count; i++) {
+		helper_line_config(idx[i], &config[i], &val[i]);
+		bulk = bulk && config[i].request_type == GPIOD_LINE_REQUEST_DIRECTION_OUTPUT
+			&& config[i].flags == config[0].flags
+			&& adapter_gpio_config[idx[i]].chip_num == adapter_gpio_config[idx[0]].chip_num;
+	}
+
+	if (!bulk) {
+		LOG_DEBUG("linuxgpiod: %s and %s not on the same chip with the same flags, set one by one",
+			adapter_gpio_get_name(idx[0]), adapter_gpio_get_name(idx[count - 1]));
+		for (unsigned int i = 0; i < count; i++) {
+			retval = helper_get_line_handle(idx[i], NULL);
+			if (retval == ERROR_OK)
+				retval = helper_request_line(idx[i], &config[i], val[i]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		return ERROR_OK;
+	}
+
+	gpiod_line_bulk_init(&out_bulk);
+	for (unsigned int i = 0; i < count; i++) {
+		retval = helper_get_line_handle(idx[i], i ? gpiod_chip[idx[0]] : NULL);
+		if (retval != ERROR_OK)
+			return retval;
+		gpiod_line_bulk_add(&out_bulk, gpiod_line[idx[i]]);
+		out_bulk_vals[i] = val[i];
+	}
+
+	out_bulk_config = config[0];
+	retval = gpiod_line_request_bulk(&out_bulk, &out_bulk_config, out_bulk_vals);
+	if (retval < 0) {
+		LOG_ERROR("Error requesting gpio lines %s to %s", adapter_gpio_get_name(idx[0]),
+			adapter_gpio_get_name(idx[count - 1]));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	out_bulk_valid = true;
+	return ERROR_OK;
+}
+
 static int linuxgpiod_init(void)
 {
 	LOG_INFO("Linux GPIOD JTAG/SWD bitbang driver");
@@ -378,10 +496,12 @@ static int linuxgpiod_init(void)
 			goto out_error;
 		}
 
+		static const enum adapter_gpio_config_index jtag_out[] = {
+			ADAPTER_GPIO_IDX_TDI, ADAPTER_GPIO_IDX_TMS, ADAPTER_GPIO_IDX_TCK,
+		};
+
 		if (helper_get_line(ADAPTER_GPIO_IDX_TDO) != ERROR_OK
-				|| helper_get_line(ADAPTER_GPIO_IDX_TDI) != ERROR_OK
-				|| helper_get_line(ADAPTER_GPIO_IDX_TCK) != ERROR_OK
-				|| helper_get_line(ADAPTER_GPIO_IDX_TMS) != ERROR_OK
+				|| helper_get_out_bulk(jtag_out, ARRAY_SIZE(jtag_out)) != ERROR_OK
 				|| helper_get_line(ADAPTER_GPIO_IDX_TRST) != ERROR_OK)
 			goto out_error;
 	}
@@ -52,6 +52,22 @@
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+/* Number of command batches that can be in flight while the next one is filled */
+#define MPSSE_BATCHES 4
+
+/* A buffer of MPSSE commands, with its write transfer and the data it reads back */
+struct mpsse_batch {
+	struct mpsse_ctx *ctx;
+	struct libusb_transfer *write_transfer;
+	uint8_t *write_buffer;
+	unsigned int write_count;
+	uint8_t *read_buffer;
+	unsigned int read_count;
+	unsigned int received;
+	struct bit_copy_queue read_queue;
+	bool write_done;
+};
+
 struct mpsse_ctx {
 	struct libusb_context *usb_ctx;
 	struct libusb_device_handle *usb_dev;
@@ -63,19 +79,26 @@ struct mpsse_ctx {
 	uint16_t index;
 	uint8_t interface;
 	enum ftdi_chip_type type;
-	uint8_t *write_buffer;
 	unsigned int write_size;
-	unsigned int write_count;
-	uint8_t *read_buffer;
 	unsigned int read_size;
-	unsigned int read_count;
+	/* batches[batch_cur] is filled, the ones before it are in flight, oldest first */
+	struct mpsse_batch batches[MPSSE_BATCHES];
+	unsigned int batch_cur;
+	unsigned int batch_first;
+	unsigned int batches_submitted;
+	/* the read transfer collects the data of all the batches in flight */
+	struct libusb_transfer *read_transfer;
+	bool read_submitted;
 	uint8_t *read_chunk;
 	unsigned int read_chunk_size;
-	struct bit_copy_queue read_queue;
+	/* error of the transfers in flight, reported by the next flush */
+	bool usb_failed;
 	int retval;
 };
 
 static void mpsse_purge(struct mpsse_ctx *ctx);
+static int mpsse_submit(struct mpsse_ctx *ctx);
+static int mpsse_wait(struct mpsse_ctx *ctx, bool all);
 
 /* Returns true if the string descriptor indexed by str_index in device matches string */
 static bool string_descriptor_equal(struct libusb_device_handle *device, uint8_t str_index,
@@ -338,22 +361,30 @@ struct mpsse_ctx *mpsse_open(const uint16_t vids[], const uint16_t pids[], const
 	if (!ctx)
 		return NULL;
 
-	bit_copy_queue_init(&ctx->read_queue);
 	ctx->read_chunk_size = 16384;
 	ctx->read_size = 16384;
 	ctx->write_size = 16384;
 	ctx->read_chunk = malloc(ctx->read_chunk_size);
-	ctx->read_buffer = malloc(ctx->read_size);
-
-	/* Use calloc to make valgrind happy: buffer_write() sets payload
-	 * on bit basis, so some bits can be left uninitialized in write_buffer.
-	 * Although this is perfectly ok with MPSSE, valgrind reports
-	 * Syscall param ioctl(USBDEVFS_SUBMITURB).buffer points to uninitialised byte(s) */
-	ctx->write_buffer = calloc(1, ctx->write_size);
-
-	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
+	ctx->read_transfer = libusb_alloc_transfer(0);
+	if (!ctx->read_chunk || !ctx->read_transfer)
 		goto error;
 
+	for (unsigned int i = 0; i < MPSSE_BATCHES; i++) {
+		struct mpsse_batch *batch = &ctx->batches[i];
+
+		batch->ctx = ctx;
+		bit_copy_queue_init(&batch->read_queue);
+		batch->read_buffer = malloc(ctx->read_size);
+		/* Use calloc to make valgrind happy: buffer_write() sets payload
+		 * on bit basis, so some bits can be left uninitialized in write_buffer.
+		 * Although this is perfectly ok with MPSSE, valgrind reports
+		 * Syscall param ioctl(USBDEVFS_SUBMITURB).buffer points to uninitialised byte(s) */
+		batch->write_buffer = calloc(1, ctx->write_size);
+		batch->write_transfer = libusb_alloc_transfer(0);
+		if (!batch->read_buffer || !batch->write_buffer || !batch->write_transfer)
+			goto error;
+	}
+
 	ctx->interface = channel;
 	ctx->index = channel + 1;
 	ctx->usb_read_timeout = 5000;
@@ -406,14 +437,27 @@ error:
 
 void mpsse_close(struct mpsse_ctx *ctx)
 {
+	/* the transfers can only be freed once completed */
+	if (ctx->batches_submitted)
+		mpsse_wait(ctx, true);
+
 	if (ctx->usb_dev)
 		libusb_close(ctx->usb_dev);
 	if (ctx->usb_ctx)
 		libusb_exit(ctx->usb_ctx);
-	bit_copy_discard(&ctx->read_queue);
 
-	free(ctx->write_buffer);
-	free(ctx->read_buffer);
+	for (unsigned int i = 0; i < MPSSE_BATCHES; i++) {
+		struct mpsse_batch *batch = &ctx->batches[i];
+
+		if (batch->write_transfer)
+			libusb_free_transfer(batch->write_transfer);
+		if (batch->read_buffer)
+			bit_copy_discard(&batch->read_queue);
+		free(batch->write_buffer);
+		free(batch->read_buffer);
+	}
+	if (ctx->read_transfer)
+		libusb_free_transfer(ctx->read_transfer);
 	free(ctx->read_chunk);
 	free(ctx);
 }
@@ -427,10 +471,16 @@ static void mpsse_purge(struct mpsse_ctx *ctx)
 {
 	int err;
 	LOG_DEBUG("-");
-	ctx->write_count = 0;
-	ctx->read_count = 0;
+	assert(ctx->batches_submitted == 0);
+	for (unsigned int i = 0; i < MPSSE_BATCHES; i++) {
+		ctx->batches[i].write_count = 0;
+		ctx->batches[i].read_count = 0;
+		bit_copy_discard(&ctx->batches[i].read_queue);
+	}
+	ctx->batch_cur = 0;
+	ctx->batch_first = 0;
+	ctx->usb_failed = false;
 	ctx->retval = ERROR_OK;
-	bit_copy_discard(&ctx->read_queue);
 	err = libusb_control_transfer(ctx->usb_dev, FTDI_DEVICE_OUT_REQTYPE, SIO_RESET_REQUEST,
 			SIO_RESET_PURGE_RX, ctx->index, NULL, 0, ctx->usb_write_timeout);
 	if (err < 0) {
@@ -446,42 +496,53 @@ static void mpsse_purge(struct mpsse_ctx *ctx)
 	}
 }
 
+static struct mpsse_batch *buffer_batch(struct mpsse_ctx *ctx)
+{
+	return &ctx->batches[ctx->batch_cur];
+}
+
 static unsigned int buffer_write_space(struct mpsse_ctx *ctx)
 {
 	/* Reserve one byte for SEND_IMMEDIATE */
-	return ctx->write_size - ctx->write_count - 1;
+	return ctx->write_size - buffer_batch(ctx)->write_count - 1;
 }
 
 static unsigned int buffer_read_space(struct mpsse_ctx *ctx)
 {
-	return ctx->read_size - ctx->read_count;
+	return ctx->read_size - buffer_batch(ctx)->read_count;
 }
 
 static void buffer_write_byte(struct mpsse_ctx *ctx, uint8_t data)
 {
+	struct mpsse_batch *batch = buffer_batch(ctx);
+
 	LOG_DEBUG_IO("%02x", data);
-	assert(ctx->write_count < ctx->write_size);
-	ctx->write_buffer[ctx->write_count++] = data;
+	assert(batch->write_count < ctx->write_size);
+	batch->write_buffer[batch->write_count++] = data;
 }
 
 static unsigned int buffer_write(struct mpsse_ctx *ctx, const uint8_t *out, unsigned int out_offset,
 	unsigned int bit_count)
 {
+	struct mpsse_batch *batch = buffer_batch(ctx);
+
 	LOG_DEBUG_IO("%d bits", bit_count);
-	assert(ctx->write_count + DIV_ROUND_UP(bit_count, 8) <= ctx->write_size);
-	bit_copy(ctx->write_buffer + ctx->write_count, 0, out, out_offset, bit_count);
-	ctx->write_count += DIV_ROUND_UP(bit_count, 8);
+	assert(batch->write_count + DIV_ROUND_UP(bit_count, 8) <= ctx->write_size);
+	bit_copy(batch->write_buffer + batch->write_count, 0, out, out_offset, bit_count);
+	batch->write_count += DIV_ROUND_UP(bit_count, 8);
 	return bit_count;
 }
 
 static unsigned int buffer_add_read(struct mpsse_ctx *ctx, uint8_t *in, unsigned int in_offset,
 	unsigned int bit_count, unsigned int offset)
 {
+	struct mpsse_batch *batch = buffer_batch(ctx);
+
 	LOG_DEBUG_IO("%d bits, offset %d", bit_count, offset);
-	assert(ctx->read_count + DIV_ROUND_UP(bit_count, 8) <= ctx->read_size);
-	bit_copy_queued(&ctx->read_queue, in, in_offset, ctx->read_buffer + ctx->read_count, offset,
+	assert(batch->read_count + DIV_ROUND_UP(bit_count, 8) <= ctx->read_size);
+	bit_copy_queued(&batch->read_queue, in, in_offset, batch->read_buffer + batch->read_count, offset,
 		bit_count);
-	ctx->read_count += DIV_ROUND_UP(bit_count, 8);
+	batch->read_count += DIV_ROUND_UP(bit_count, 8);
 	return bit_count;
 }
 
@@ -518,7 +579,7 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned int ou
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) + (length < 8) < (out || (!out && !in) ? 4 : 3)
 				|| (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = mpsse_submit(ctx);
 
 		if (length < 8) {
 			/* Transfer remaining bits in bit mode */
@@ -592,7 +653,7 @@ void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned int
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = mpsse_submit(ctx);
 
 		/* Byte transfer */
 		unsigned int this_bits = length;
@@ -635,7 +696,7 @@ void mpsse_set_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t d
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_submit(ctx);
 
 	buffer_write_byte(ctx, 0x80);
 	buffer_write_byte(ctx, data);
@@ -652,7 +713,7 @@ void mpsse_set_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_submit(ctx);
 
 	buffer_write_byte(ctx, 0x82);
 	buffer_write_byte(ctx, data);
@@ -669,7 +730,7 @@ void mpsse_read_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_submit(ctx);
 
 	buffer_write_byte(ctx, 0x81);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -685,7 +746,7 @@ void mpsse_read_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_submit(ctx);
 
 	buffer_write_byte(ctx, 0x83);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -700,7 +761,7 @@ static void single_byte_boolean_helper(struct mpsse_ctx *ctx, bool var, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_submit(ctx);
 
 	buffer_write_byte(ctx, var ? val_if_true : val_if_false);
 }
@@ -721,7 +782,7 @@ static void mpsse_set_divisor(struct mpsse_ctx *ctx, uint16_t divisor)
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = mpsse_submit(ctx);
 
 	buffer_write_byte(ctx, 0x86);
 	buffer_write_byte(ctx, divisor & 0xff);
@@ -781,127 +842,156 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 	return frequency;
 }
 
-/* Context needed by the callbacks */
-struct transfer_result {
-	struct mpsse_ctx *ctx;
-	bool done;
-	unsigned int transferred;
-};
+static struct mpsse_batch *batch_in_flight(struct mpsse_ctx *ctx, unsigned int n)
+{
+	return &ctx->batches[(ctx->batch_first + n) % MPSSE_BATCHES];
+}
+
+/* The batches in flight still waiting for read data */
+static bool read_pending(struct mpsse_ctx *ctx)
+{
+	for (unsigned int i = 0; i < ctx->batches_submitted; i++) {
+		struct mpsse_batch *batch = batch_in_flight(ctx, i);
+		if (batch->received < batch->read_count)
+			return true;
+	}
+	return false;
+}
+
+/* Hand the payload of the read data, in order, to the batches in flight */
+static void read_deliver(struct mpsse_ctx *ctx, const uint8_t *data, unsigned int size)
+{
+	for (unsigned int i = 0; i < ctx->batches_submitted && size; i++) {
+		struct mpsse_batch *batch = batch_in_flight(ctx, i);
+		unsigned int this_size = MIN(size, batch->read_count - batch->received);
+
+		memcpy(batch->read_buffer + batch->received, data, this_size);
+		batch->received += this_size;
+		data += this_size;
+		size -= this_size;
+	}
+
+	if (size)
+		LOG_DEBUG_IO("dropping %u unexpected bytes", size);
+}
 
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 {
-	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_ctx *ctx = transfer->user_data;
 
 	unsigned int packet_size = ctx->max_packet_size;
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
 	/* Strip the two status bytes sent at the beginning of each USB packet
-	 * while copying the chunk buffer to the read buffer */
+	 * while handing the chunk buffer to the batches */
 	unsigned int num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
 	unsigned int chunk_remains = transfer->actual_length;
 	for (unsigned int i = 0; i < num_packets && chunk_remains > 2; i++) {
 		unsigned int this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
-		if (this_size > ctx->read_count - res->transferred)
-			this_size = ctx->read_count - res->transferred;
-		memcpy(ctx->read_buffer + res->transferred,
-			ctx->read_chunk + packet_size * i + 2,
-			this_size);
-		res->transferred += this_size;
+		read_deliver(ctx, ctx->read_chunk + packet_size * i + 2, this_size);
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
-			res->done = true;
-			break;
-		}
 	}
 
-	LOG_DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
-		ctx->read_count);
+	LOG_DEBUG_IO("raw chunk %d, status %d", transfer->actual_length, transfer->status);
+
+	ctx->read_submitted = false;
+	if (!read_pending(ctx))
+		return;
 
-	if (!res->done)
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED
+			|| libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+		LOG_ERROR("ftdi device did not return all data");
+		ctx->usb_failed = true;
+		return;
+	}
+	ctx->read_submitted = true;
 }
 
 static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 {
-	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
-
-	res->transferred += transfer->actual_length;
+	struct mpsse_batch *batch = transfer->user_data;
+	struct mpsse_ctx *ctx = batch->ctx;
 
-	LOG_DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
+	LOG_DEBUG_IO("transferred %d of %d", transfer->actual_length, batch->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
-		res->done = true;
-	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	/* the next batches are already queued behind, a partial write cannot be resumed */
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED
+			|| (unsigned int)transfer->actual_length < batch->write_count) {
+		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
+			transfer->actual_length, batch->write_count);
+		ctx->usb_failed = true;
 	}
+	batch->write_done = true;
 }
 
-int mpsse_flush(struct mpsse_ctx *ctx)
+static void mpsse_cancel_transfers(struct mpsse_ctx *ctx)
 {
-	int retval = ctx->retval;
-
-	if (retval != ERROR_OK) {
-		LOG_DEBUG_IO("Ignoring flush due to previous error");
-		assert(ctx->write_count == 0 && ctx->read_count == 0);
-		ctx->retval = ERROR_OK;
-		return retval;
+	for (unsigned int i = 0; i < ctx->batches_submitted; i++) {
+		struct mpsse_batch *batch = batch_in_flight(ctx, i);
+		if (!batch->write_done)
+			libusb_cancel_transfer(batch->write_transfer);
 	}
+	if (ctx->read_submitted)
+		libusb_cancel_transfer(ctx->read_transfer);
+	ctx->usb_failed = true;
+}
 
-	LOG_DEBUG_IO("write %d%s, read %d", ctx->write_count, ctx->read_count ? "+1" : "",
-			ctx->read_count);
-	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
-
-	if (ctx->write_count == 0)
-		return retval;
-
-	struct libusb_transfer *read_transfer = NULL;
-	struct transfer_result read_result = { .ctx = ctx, .done = true };
-	if (ctx->read_count) {
-		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
-		read_result.done = false;
-		/* delay read transaction to ensure the FTDI chip can support us with data
-		   immediately after processing the MPSSE commands in the write transaction */
-	}
+/* Copy the read data of the oldest batch in flight to the scan buffers and reuse it */
+static void batch_retire(struct mpsse_ctx *ctx, bool deliver)
+{
+	struct mpsse_batch *batch = batch_in_flight(ctx, 0);
 
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
-	if (retval != LIBUSB_SUCCESS)
-		goto error_check;
+	if (deliver && batch->read_count)
+		bit_copy_execute(&batch->read_queue);
+	else
+		bit_copy_discard(&batch->read_queue);
+	batch->write_count = 0;
+	batch->read_count = 0;
 
-	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
-			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
-		if (retval != LIBUSB_SUCCESS)
-			goto error_check;
-	}
+	ctx->batch_first = (ctx->batch_first + 1) % MPSSE_BATCHES;
+	ctx->batches_submitted--;
+}
 
+/*
+ * Handle the USB events until the oldest batch in flight is completed, or
+ * all of them when @a all. On error, wait for all the transfers to end.
+ */
+static int mpsse_wait(struct mpsse_ctx *ctx, bool all)
+{
 	/* Polling loop, more or less taken from libftdi */
 	int64_t start = timeval_ms();
 	int64_t warn_after = 2000;
-	while (!write_result.done || !read_result.done) {
+
+	while (ctx->batches_submitted) {
+		struct mpsse_batch *batch = batch_in_flight(ctx, 0);
+
+		if (ctx->usb_failed) {
+			bool busy = ctx->read_submitted;
+			for (unsigned int i = 0; i < ctx->batches_submitted; i++)
+				busy = busy || !batch_in_flight(ctx, i)->write_done;
+			if (!busy) {
+				while (ctx->batches_submitted)
+					batch_retire(ctx, false);
+				break;
+			}
+		} else if (batch->write_done && batch->received == batch->read_count) {
+			batch_retire(ctx, true);
+			if (!all)
+				break;
+			continue;
+		}
+
 		struct timeval timeout_usb;
 
 		timeout_usb.tv_sec = 1;
 		timeout_usb.tv_usec = 0;
 
-		retval = libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL);
+		int retval = libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL);
 		keep_alive();
 
 		int64_t now = timeval_ms();
@@ -914,44 +1004,97 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		if (retval == LIBUSB_ERROR_INTERRUPTED)
 			continue;
 
-		if (retval != LIBUSB_SUCCESS) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
+		if (retval != LIBUSB_SUCCESS && !ctx->usb_failed) {
+			LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
+			mpsse_cancel_transfers(ctx);
 		}
 	}
 
-error_check:
+	return ctx->usb_failed ? ERROR_FAIL : ERROR_OK;
+}
+
+/*
+ * Send the batch being filled and move to the next one, without waiting
+ * for the transfer to complete unless all the batches are in flight.
+ */
+static int mpsse_submit(struct mpsse_ctx *ctx)
+{
+	struct mpsse_batch *batch = buffer_batch(ctx);
+	int retval;
+
+	assert(batch->write_count > 0 || batch->read_count == 0); /* No read data without write data */
+
+	if (batch->write_count == 0)
+		return ERROR_OK;
+
+	LOG_DEBUG_IO("write %d%s, read %d, %u in flight", batch->write_count,
+			batch->read_count ? "+1" : "", batch->read_count, ctx->batches_submitted);
+
+	if (batch->read_count)
+		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
+
+	/* the timeout runs from the submission, count the batches queued before */
+	batch->received = 0;
+	batch->write_done = false;
+	libusb_fill_bulk_transfer(batch->write_transfer, ctx->usb_dev, ctx->out_ep, batch->write_buffer,
+		batch->write_count, write_cb, batch,
+		ctx->usb_write_timeout * (ctx->batches_submitted + 1));
+	retval = libusb_submit_transfer(batch->write_transfer);
 	if (retval != LIBUSB_SUCCESS) {
-		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
-		retval = ERROR_FAIL;
-	} else if (write_result.transferred < ctx->write_count) {
-		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
-			write_result.transferred,
-			ctx->write_count);
-		retval = ERROR_FAIL;
-	} else if (read_result.transferred < ctx->read_count) {
-		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
-			read_result.transferred,
-			ctx->read_count);
-		retval = ERROR_FAIL;
-	} else if (ctx->read_count) {
-		ctx->write_count = 0;
-		ctx->read_count = 0;
-		bit_copy_execute(&ctx->read_queue);
-		retval = ERROR_OK;
-	} else {
-		ctx->write_count = 0;
-		bit_copy_discard(&ctx->read_queue);
-		retval = ERROR_OK;
+		LOG_ERROR("libusb_submit_transfer() failed with %s", libusb_error_name(retval));
+		batch->write_done = true;
+		ctx->usb_failed = true;
 	}
 
-	if (retval != ERROR_OK)
+	ctx->batches_submitted++;
+	ctx->batch_cur = (ctx->batch_cur + 1) % MPSSE_BATCHES;
+
+	/* the read transfer follows the write, so that the FTDI chip can support
+	 * us with data immediately after processing the MPSSE commands */
+	if (!ctx->usb_failed && !ctx->read_submitted && read_pending(ctx)) {
+		libusb_fill_bulk_transfer(ctx->read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
+			ctx->read_chunk_size, read_cb, ctx, ctx->usb_read_timeout);
+		retval = libusb_submit_transfer(ctx->read_transfer);
+		if (retval != LIBUSB_SUCCESS) {
+			LOG_ERROR("libusb_submit_transfer() failed with %s", libusb_error_name(retval));
+			mpsse_cancel_transfers(ctx);
+		} else {
+			ctx->read_submitted = true;
+		}
+	}
+
+	/* the batch to fill next is still in flight */
+	if (!ctx->usb_failed && ctx->batches_submitted == MPSSE_BATCHES)
+		mpsse_wait(ctx, false);
+
+	if (ctx->usb_failed) {
+		mpsse_wait(ctx, true);
 		mpsse_purge(ctx);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+int mpsse_flush(struct mpsse_ctx *ctx)
+{
+	int retval = ctx->retval;
+
+	if (retval != ERROR_OK) {
+		LOG_DEBUG_IO("Ignoring flush due to previous error");
+		assert(ctx->batches_submitted == 0);
+		assert(buffer_batch(ctx)->write_count == 0 && buffer_batch(ctx)->read_count == 0);
+		ctx->retval = ERROR_OK;
+		return retval;
+	}
 
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
+	retval = mpsse_submit(ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = mpsse_wait(ctx, true);
+	if (retval != ERROR_OK)
+		mpsse_purge(ctx);
 
 	return retval;
 }
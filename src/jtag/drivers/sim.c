@@ -0,0 +1,720 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * In-process simulator of a scan chain, to measure the throughput of the
+ * JTAG and DAP layers without hardware.
+ *
+ * The chain is made of TAPs with a configurable IR length and IDCODE,
+ * that implement the IDCODE and BYPASS instructions. A TAP declared as a
+ * DAP implements the ADIv5 JTAG-DP instead, with a single MEM-AP whose
+ * memory is a buffer in the host. The same DAP model is reachable through
+ * SWD.
+ *
+ * Commands are executed at the queue level: each scan shifts all the
+ * fields through the chain at once, there is no bit-banging.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/bits.h>
+#include <helper/time_support.h>
+#include <jtag/adapter.h>
+#include <jtag/interface.h>
+#include <jtag/commands.h>
+#include <jtag/swd.h>
+#include <target/arm_adi_v5.h>
+#include <transport/transport.h>
+
+#define SIM_MAX_TAPS			16
+
+/* ARM JTAG-DP instructions and data register lengths */
+#define SIM_DAP_IR_LEN			4
+#define SIM_DAP_IR_ABORT		0x8
+#define SIM_DAP_IR_DPACC		0xA
+#define SIM_DAP_IR_APACC		0xB
+#define SIM_DAP_IR_IDCODE		0xE
+#define SIM_DAP_ACC_LEN			35
+#define SIM_DAP_ACK_OK_FAULT	0x2
+
+/* IDCODE instruction of the other TAPs, any other one selects BYPASS */
+#define SIM_IR_IDCODE			0x1
+
+#define SIM_DPIDR				0x2BA01477
+#define SIM_AHB_AP_IDR			0x24770011
+#define SIM_DEFAULT_MEM_BASE	0x20000000
+#define SIM_DEFAULT_MEM_SIZE	(1024 * 1024)
+
+struct sim_tap {
+	unsigned int ir_len;
+	uint32_t idcode;
+	bool dap;
+	uint32_t ir;
+	/* value being shifted, loaded at capture and used at update */
+	uint64_t shift;
+};
+
+struct sim_dap {
+	uint32_t ctrl_stat;
+	uint32_t select;
+	/* result of the last AP read (RDBUFF) */
+	uint32_t rdbuff;
+	/* value returned by the next JTAG-DP capture */
+	uint32_t jtag_result;
+	uint32_t csw;
+	uint32_t tar;
+	/* access to an AP while a sticky error is set, for SWD FAULT */
+	bool fault;
+};
+
+struct sim_stats {
+	uint64_t queues;
+	uint64_t scans;
+	uint64_t scan_bits;
+	uint64_t dp_reads;
+	uint64_t dp_writes;
+	uint64_t ap_reads;
+	uint64_t ap_writes;
+	uint64_t mem_read_bytes;
+	uint64_t mem_write_bytes;
+	uint64_t errors;
+};
+
+static struct sim_tap sim_taps[SIM_MAX_TAPS];
+static unsigned int sim_num_taps;
+static enum tap_state sim_state = TAP_RESET;
+static struct sim_dap sim_dap;
+static struct sim_stats sim_stats;
+
+static uint8_t *sim_mem;
+static target_addr_t sim_mem_base = SIM_DEFAULT_MEM_BASE;
+static uint32_t sim_mem_size = SIM_DEFAULT_MEM_SIZE;
+static unsigned int sim_latency_us;
+
+static void sim_tap_reset(void)
+{
+	for (unsigned int i = 0; i < sim_num_taps; i++)
+		sim_taps[i].ir = sim_taps[i].dap ? SIM_DAP_IR_IDCODE : SIM_IR_IDCODE;
+}
+
+static void sim_set_state(enum tap_state state)
+{
+	sim_state = state;
+	if (state == TAP_RESET)
+		sim_tap_reset();
+}
+
+static void sim_dap_reset(void)
+{
+	memset(&sim_dap, 0, sizeof(sim_dap));
+	sim_dap.csw = CSW_32BIT | CSW_DEVICE_EN;
+}
+
+static uint8_t *sim_mem_ptr(uint32_t address, unsigned int len)
+{
+	if (address < sim_mem_base || address - sim_mem_base + len > sim_mem_size)
+		return NULL;
+	return sim_mem + (address - sim_mem_base);
+}
+
+static uint32_t sim_mem_ap_transfer_size(void)
+{
+	if ((sim_dap.csw & CSW_ADDRINC_MASK) == CSW_ADDRINC_PACKED)
+		return 4;
+	return 1u << (sim_dap.csw & CSW_SIZE_MASK);
+}
+
+/* Access the memory through DRW or BDx, data is placed on its byte lanes */
+static uint32_t sim_mem_ap_access(uint32_t address, unsigned int len, bool rnw, uint32_t value)
+{
+	uint8_t *mem = sim_mem_ptr(address, len);
+
+	if (!mem) {
+		sim_dap.ctrl_stat |= SSTICKYERR;
+		sim_stats.errors++;
+		return 0;
+	}
+
+	if (rnw) {
+		value = 0;
+		for (unsigned int i = 0; i < len; i++)
+			value |= (uint32_t)mem[i] << (8 * ((address + i) & 3));
+		sim_stats.mem_read_bytes += len;
+	} else {
+		for (unsigned int i = 0; i < len; i++)
+			mem[i] = value >> (8 * ((address + i) & 3));
+		sim_stats.mem_write_bytes += len;
+	}
+
+	return value;
+}
+
+static uint32_t sim_ap_access(unsigned int reg, bool rnw, uint32_t value)
+{
+	unsigned int apsel = sim_dap.select >> 24;
+	unsigned int addr = (sim_dap.select & ADIV5_DP_SELECT_APBANK) | reg;
+
+	if (rnw)
+		sim_stats.ap_reads++;
+	else
+		sim_stats.ap_writes++;
+
+	if (sim_dap.ctrl_stat & SSTICKYERR) {
+		/* transactions are discarded until the sticky error is cleared */
+		sim_dap.fault = true;
+		return 0;
+	}
+
+	/* only AP #0 is implemented */
+	if (apsel != 0)
+		return 0;
+
+	switch (addr) {
+	case ADIV5_MEM_AP_REG_CSW:
+		if (rnw)
+			return sim_dap.csw;
+		/* sizes up to 32 bits, no TrInProg, DeviceEn always set */
+		if ((value & CSW_SIZE_MASK) > CSW_32BIT)
+			value = (value & ~CSW_SIZE_MASK) | (sim_dap.csw & CSW_SIZE_MASK);
+		sim_dap.csw = (value & ~CSW_TRIN_PROG) | CSW_DEVICE_EN;
+		return 0;
+	case ADIV5_MEM_AP_REG_TAR:
+		if (!rnw)
+			sim_dap.tar = value;
+		return rnw ? sim_dap.tar : 0;
+	case ADIV5_MEM_AP_REG_DRW: {
+		uint32_t len = sim_mem_ap_transfer_size();
+		value = sim_mem_ap_access(sim_dap.tar, len, rnw, value);
+		if (sim_dap.csw & CSW_ADDRINC_MASK)
+			sim_dap.tar += len;
+		return rnw ? value : 0;
+	}
+	case ADIV5_MEM_AP_REG_BD0:
+	case ADIV5_MEM_AP_REG_BD1:
+	case ADIV5_MEM_AP_REG_BD2:
+	case ADIV5_MEM_AP_REG_BD3:
+		value = sim_mem_ap_access((sim_dap.tar & ~0xf) | (addr & 0xc), 4, rnw, value);
+		return rnw ? value : 0;
+	case ADIV5_MEM_AP_REG_BASE:
+		/* debug register format, no ROM table */
+		return 0x2;
+	case ADIV5_AP_REG_IDR:
+		return SIM_AHB_AP_IDR;
+	default:
+		return 0;
+	}
+}
+
+static void sim_dp_abort(uint32_t value)
+{
+	if (value & STKCMPCLR)
+		sim_dap.ctrl_stat &= ~SSTICKYCMP;
+	if (value & STKERRCLR)
+		sim_dap.ctrl_stat &= ~SSTICKYERR;
+	if (value & ORUNERRCLR)
+		sim_dap.ctrl_stat &= ~SSTICKYORUN;
+}
+
+static uint32_t sim_dp_access(unsigned int reg, bool rnw, uint32_t value, bool swd)
+{
+	unsigned int bank = sim_dap.select & DP_SELECT_DPBANK;
+
+	if (rnw)
+		sim_stats.dp_reads++;
+	else
+		sim_stats.dp_writes++;
+
+	switch (reg) {
+	case 0x0:
+		if (rnw)
+			return bank == 0 ? SIM_DPIDR : 0;
+		if (swd)
+			sim_dp_abort(value);
+		return 0;
+	case 0x4:
+		if (rnw)
+			return bank == 0 ? sim_dap.ctrl_stat : 0;
+		if (bank != 0)
+			return 0;
+		/* sticky bits are write-one-to-clear on JTAG-DP, read-only on SW-DP */
+		if (!swd)
+			sim_dap.ctrl_stat &= ~(value & (SSTICKYORUN | SSTICKYCMP | SSTICKYERR));
+		sim_dap.ctrl_stat = (sim_dap.ctrl_stat & (SSTICKYORUN | SSTICKYCMP | SSTICKYERR))
+			| (value & ~(SSTICKYORUN | SSTICKYCMP | SSTICKYERR | CDBGPWRUPACK | CSYSPWRUPACK));
+		/* power up is immediate */
+		if (sim_dap.ctrl_stat & CDBGPWRUPREQ)
+			sim_dap.ctrl_stat |= CDBGPWRUPACK;
+		if (sim_dap.ctrl_stat & CSYSPWRUPREQ)
+			sim_dap.ctrl_stat |= CSYSPWRUPACK;
+		return 0;
+	case 0x8:
+		if (!rnw)
+			sim_dap.select = value;
+		/* RESEND on SW-DP */
+		return swd ? sim_dap.rdbuff : sim_dap.select;
+	case 0xC:
+		return rnw ? sim_dap.rdbuff : 0;
+	default:
+		return 0;
+	}
+}
+
+/* Transaction through DPACC or APACC, on update of the data register */
+static void sim_jtag_dp_update(unsigned int ir, uint64_t dr)
+{
+	bool rnw = dr & 1;
+	unsigned int reg = (dr >> 1 & 0x3) << 2;
+	uint32_t value = dr >> 3;
+
+	if (ir == SIM_DAP_IR_ABORT) {
+		sim_dp_abort(value);
+		return;
+	}
+
+	if (ir == SIM_DAP_IR_APACC) {
+		value = sim_ap_access(reg, rnw, value);
+		if (rnw)
+			sim_dap.rdbuff = value;
+	} else {
+		value = sim_dp_access(reg, rnw, value, false);
+	}
+
+	sim_dap.jtag_result = value;
+}
+
+static unsigned int sim_tap_dr_len(const struct sim_tap *tap)
+{
+	if (tap->dap) {
+		switch (tap->ir) {
+		case SIM_DAP_IR_ABORT:
+		case SIM_DAP_IR_DPACC:
+		case SIM_DAP_IR_APACC:
+			return SIM_DAP_ACC_LEN;
+		case SIM_DAP_IR_IDCODE:
+			return 32;
+		default:
+			return 1;
+		}
+	}
+
+	return tap->ir == SIM_IR_IDCODE && tap->idcode ? 32 : 1;
+}
+
+static uint64_t sim_tap_capture(const struct sim_tap *tap, bool ir_scan)
+{
+	if (ir_scan)
+		return 0x1;
+
+	if (sim_tap_dr_len(tap) == 32)
+		return tap->idcode;
+
+	if (sim_tap_dr_len(tap) == SIM_DAP_ACC_LEN)
+		return SIM_DAP_ACK_OK_FAULT | (uint64_t)sim_dap.jtag_result << 3;
+
+	return 0;
+}
+
+static void sim_tap_update(struct sim_tap *tap, bool ir_scan)
+{
+	if (ir_scan) {
+		tap->ir = tap->shift & ((1ull << tap->ir_len) - 1);
+		return;
+	}
+
+	if (tap->dap && sim_tap_dr_len(tap) == SIM_DAP_ACC_LEN)
+		sim_jtag_dp_update(tap->ir, tap->shift);
+}
+
+/*
+ * Shift the whole scan through the chain. The TAP closest to TDO owns the
+ * low bits of the chain register; the bits of the scan are shifted in at
+ * its top and come out from its bottom.
+ */
+static int sim_scan(struct scan_command *cmd)
+{
+	bool ir_scan = cmd->ir_scan;
+	enum tap_state pause = ir_scan ? TAP_IRPAUSE : TAP_DRPAUSE;
+	unsigned int chain_len = 0;
+	unsigned int len[SIM_MAX_TAPS];
+
+	for (unsigned int i = 0; i < sim_num_taps; i++) {
+		struct sim_tap *tap = &sim_taps[i];
+
+		len[i] = ir_scan ? tap->ir_len : sim_tap_dr_len(tap);
+		chain_len += len[i];
+		/* shifting resumed from pause does not capture again */
+		if (sim_state != pause)
+			tap->shift = sim_tap_capture(tap, ir_scan);
+	}
+
+	uint8_t *buffer;
+	unsigned int scan_len = jtag_build_buffer(cmd, &buffer);
+	uint8_t *chain = calloc(1, DIV_ROUND_UP(chain_len + scan_len, 8));
+	if (!chain) {
+		free(buffer);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* chain register followed by the bits to shift in */
+	unsigned int pos = 0;
+	for (unsigned int i = 0; i < sim_num_taps; i++) {
+		uint8_t value[8];
+		h_u64_to_le(value, sim_taps[i].shift);
+		buf_set_buf(value, 0, chain, pos, len[i]);
+		pos += len[i];
+	}
+	buf_set_buf(buffer, 0, chain, chain_len, scan_len);
+
+	/* the first bits out are the chain register, followed by the bits in */
+	buf_set_buf(chain, 0, buffer, 0, scan_len);
+	pos = scan_len;
+	for (unsigned int i = 0; i < sim_num_taps; i++) {
+		uint8_t value[8] = { 0 };
+		buf_set_buf(chain, pos, value, 0, len[i]);
+		sim_taps[i].shift = le_to_h_u64(value);
+		pos += len[i];
+	}
+	free(chain);
+
+	int retval = jtag_read_buffer(buffer, cmd);
+	free(buffer);
+
+	sim_stats.scans++;
+	sim_stats.scan_bits += scan_len;
+
+	/* update, unless the scan stays in pause */
+	if (cmd->end_state != pause)
+		for (unsigned int i = 0; i < sim_num_taps; i++)
+			sim_tap_update(&sim_taps[i], ir_scan);
+
+	sim_set_state(cmd->end_state);
+
+	return retval;
+}
+
+static void sim_tms(const uint8_t *bits, unsigned int num_bits)
+{
+	for (unsigned int i = 0; i < num_bits; i++)
+		sim_set_state(tap_state_transition(sim_state, (bits[i / 8] >> (i % 8)) & 1));
+}
+
+static int sim_execute_queue(struct jtag_command *cmd_queue)
+{
+	int retval = ERROR_OK;
+
+	sim_stats.queues++;
+
+	for (struct jtag_command *cmd = cmd_queue; cmd; cmd = cmd->next) {
+		switch (cmd->type) {
+		case JTAG_RESET:
+			if (cmd->cmd.reset->trst == 1)
+				sim_set_state(TAP_RESET);
+			break;
+		case JTAG_RUNTEST:
+			sim_set_state(cmd->cmd.runtest->end_state);
+			break;
+		case JTAG_STABLECLOCKS:
+			break;
+		case JTAG_TLR_RESET:
+			sim_set_state(TAP_RESET);
+			sim_set_state(cmd->cmd.statemove->end_state);
+			break;
+		case JTAG_PATHMOVE:
+			for (unsigned int i = 0; i < cmd->cmd.pathmove->num_states; i++)
+				sim_set_state(cmd->cmd.pathmove->path[i]);
+			break;
+		case JTAG_TMS:
+			sim_tms(cmd->cmd.tms->bits, cmd->cmd.tms->num_bits);
+			break;
+		case JTAG_SLEEP:
+			jtag_sleep(cmd->cmd.sleep->us);
+			break;
+		case JTAG_SCAN:
+			if (sim_scan(cmd->cmd.scan) != ERROR_OK)
+				retval = ERROR_JTAG_QUEUE_FAILED;
+			break;
+		default:
+			LOG_ERROR("BUG: unknown JTAG command type 0x%X", cmd->type);
+			retval = ERROR_FAIL;
+			break;
+		}
+	}
+
+	if (sim_latency_us)
+		jtag_sleep(sim_latency_us);
+
+	return retval;
+}
+
+static int sim_swd_init(void)
+{
+	return ERROR_OK;
+}
+
+static int sim_swd_switch_seq(enum swd_special_seq seq)
+{
+	if (seq == LINE_RESET || seq == JTAG_TO_SWD || seq == DORMANT_TO_SWD)
+		sim_dap.select = 0;
+
+	return ERROR_OK;
+}
+
+static void sim_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
+{
+	unsigned int reg = (cmd & SWD_CMD_A32) >> 1;
+	uint32_t data;
+
+	if (cmd & SWD_CMD_APNDP) {
+		/* AP reads are posted, the value is the one of the previous read */
+		data = sim_dap.rdbuff;
+		sim_dap.rdbuff = sim_ap_access(reg, true, 0);
+	} else {
+		data = sim_dp_access(reg, true, 0, true);
+	}
+
+	if (value)
+		*value = data;
+}
+
+static void sim_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_clk)
+{
+	unsigned int reg = (cmd & SWD_CMD_A32) >> 1;
+
+	if (cmd & SWD_CMD_APNDP)
+		sim_ap_access(reg, false, value);
+	else
+		sim_dp_access(reg, false, value, true);
+}
+
+static int sim_swd_run_queue(void)
+{
+	sim_stats.queues++;
+
+	if (sim_latency_us)
+		jtag_sleep(sim_latency_us);
+
+	if (sim_dap.fault) {
+		sim_dap.fault = false;
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int sim_init(void)
+{
+	if (transport_is_jtag() && !sim_num_taps) {
+		LOG_ERROR("sim: no TAP in the simulated scan chain, use 'sim tap'");
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	free(sim_mem);
+	sim_mem = calloc(1, sim_mem_size);
+	if (!sim_mem) {
+		LOG_ERROR("sim: can't allocate %" PRIu32 " bytes of memory", sim_mem_size);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	sim_set_state(TAP_RESET);
+	sim_dap_reset();
+
+	LOG_INFO("sim: %u TAP(s), memory at " TARGET_ADDR_FMT ", %" PRIu32 " bytes",
+			sim_num_taps, sim_mem_base, sim_mem_size);
+
+	return ERROR_OK;
+}
+
+static int sim_quit(void)
+{
+	free(sim_mem);
+	sim_mem = NULL;
+
+	return ERROR_OK;
+}
+
+static int sim_reset(int trst, int srst)
+{
+	if (trst == 1)
+		sim_set_state(TAP_RESET);
+
+	return ERROR_OK;
+}
+
+static int sim_speed(int speed)
+{
+	return ERROR_OK;
+}
+
+static int sim_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+static int sim_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(sim_handle_tap_command)
+{
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sim_num_taps == SIM_MAX_TAPS) {
+		command_print(CMD, "at most %d TAPs can be simulated", SIM_MAX_TAPS);
+		return ERROR_FAIL;
+	}
+
+	struct sim_tap *tap = &sim_taps[sim_num_taps];
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], tap->ir_len);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], tap->idcode);
+	tap->dap = false;
+
+	if (CMD_ARGC == 3) {
+		if (strcmp(CMD_ARGV[2], "dap"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		tap->dap = true;
+	}
+
+	if (tap->ir_len < 2 || tap->ir_len > 32 || (tap->dap && tap->ir_len != SIM_DAP_IR_LEN)) {
+		command_print(CMD, "invalid IR length %u", tap->ir_len);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	sim_num_taps++;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(sim_handle_memory_command)
+{
+	if (CMD_ARGC == 0) {
+		command_print(CMD, TARGET_ADDR_FMT " %" PRIu32, sim_mem_base, sim_mem_size);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], sim_mem_base);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], sim_mem_size);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(sim_handle_latency_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], sim_latency_us);
+
+	command_print(CMD, "%u us", sim_latency_us);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(sim_handle_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(&sim_stats, 0, sizeof(sim_stats));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "queues %" PRIu64, sim_stats.queues);
+	command_print(CMD, "scans %" PRIu64 ", %" PRIu64 " bits", sim_stats.scans, sim_stats.scan_bits);
+	command_print(CMD, "DP reads %" PRIu64 ", writes %" PRIu64, sim_stats.dp_reads, sim_stats.dp_writes);
+	command_print(CMD, "AP reads %" PRIu64 ", writes %" PRIu64, sim_stats.ap_reads, sim_stats.ap_writes);
+	command_print(CMD, "memory bytes read %" PRIu64 ", written %" PRIu64,
+			sim_stats.mem_read_bytes, sim_stats.mem_write_bytes);
+	command_print(CMD, "memory errors %" PRIu64, sim_stats.errors);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration sim_subcommand_handlers[] = {
+	{
+		.name = "tap",
+		.handler = sim_handle_tap_command,
+		.mode = COMMAND_CONFIG,
+		.help = "append a TAP to the simulated scan chain, starting "
+			"from TDO; with 'dap' the TAP is an ARM JTAG-DP",
+		.usage = "ir_len idcode ['dap']",
+	},
+	{
+		.name = "memory",
+		.handler = sim_handle_memory_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the address and size of the memory behind the MEM-AP",
+		.usage = "[address size]",
+	},
+	{
+		.name = "latency",
+		.handler = sim_handle_latency_command,
+		.mode = COMMAND_ANY,
+		.help = "set the delay added to each queue execution, "
+			"to model the round trip of a real adapter",
+		.usage = "[microseconds]",
+	},
+	{
+		.name = "stats",
+		.handler = sim_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "display or reset the counters of the simulator",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration sim_command_handlers[] = {
+	{
+		.name = "sim",
+		.mode = COMMAND_ANY,
+		.help = "scan chain simulator commands",
+		.chain = sim_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static struct jtag_interface sim_interface = {
+	.supported = DEBUG_CAP_TMS_SEQ,
+	.execute_queue = sim_execute_queue,
+};
+
+static const struct swd_driver sim_swd = {
+	.init = sim_swd_init,
+	.switch_seq = sim_swd_switch_seq,
+	.read_reg = sim_swd_read_reg,
+	.write_reg = sim_swd_write_reg,
+	.run = sim_swd_run_queue,
+};
+
+struct adapter_driver sim_adapter_driver = {
+	.name = "sim",
+	.transport_ids = TRANSPORT_JTAG | TRANSPORT_SWD,
+	.transport_preferred_id = TRANSPORT_JTAG,
+	.commands = sim_command_handlers,
+
+	.init = sim_init,
+	.quit = sim_quit,
+	.reset = sim_reset,
+	.speed = sim_speed,
+	.khz = sim_khz,
+	.speed_div = sim_speed_div,
+
+	.jtag_ops = &sim_interface,
+	.swd_ops = &sim_swd,
+};
@@ -404,6 +404,7 @@ extern struct adapter_driver presto_adapter_driver;
 extern struct adapter_driver remote_bitbang_adapter_driver;
 extern struct adapter_driver rlink_adapter_driver;
 extern struct adapter_driver rshim_dap_adapter_driver;
+extern struct adapter_driver sim_adapter_driver;
 extern struct adapter_driver stlink_dap_adapter_driver;
 extern struct adapter_driver sysfsgpio_adapter_driver;
 extern struct adapter_driver ulink_adapter_driver;
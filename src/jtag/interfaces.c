@@ -134,6 +134,9 @@ struct adapter_driver *adapter_drivers[] = {
 #if BUILD_RSHIM == 1
 		&rshim_dap_adapter_driver,
 #endif
+#if BUILD_SIM == 1
+		&sim_adapter_driver,
+#endif
 #if BUILD_HLADAPTER_STLINK == 1
 		&stlink_dap_adapter_driver,
 #endif
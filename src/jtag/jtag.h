@@ -318,6 +318,17 @@ void jtag_add_plain_ir_scan(int num_bits, const uint8_t *out_bits, uint8_t *in_b
  */
 void jtag_add_dr_scan(struct jtag_tap *tap, int num_fields,
 		const struct scan_field *fields, enum tap_state endstate);
+/**
+ * Queue @a num_scans DR scans of @a num_fields fields each, taken in
+ * order from @a fields, each of them followed by @a idle_cycles in
+ * Run-Test/Idle when non zero. This is the same as calling
+ * jtag_add_dr_scan() and jtag_add_runtest() for each scan, except that
+ * the out_value buffers are not copied in the queue: as the in_value
+ * buffers, they must stay valid until the queue is executed.
+ */
+void jtag_add_dr_scans(struct jtag_tap *tap, unsigned int num_scans,
+		unsigned int num_fields, const struct scan_field *fields,
+		unsigned int idle_cycles, enum tap_state endstate);
 /** A version of jtag_add_dr_scan() that uses the check_value/mask fields */
 void jtag_add_dr_scan_check(struct jtag_tap *tap, int num_fields,
 		struct scan_field *fields, enum tap_state endstate);
@@ -46,6 +46,10 @@ int interface_jtag_add_plain_ir_scan(
 int interface_jtag_add_dr_scan(struct jtag_tap *active,
 		int num_fields, const struct scan_field *fields,
 		enum tap_state endstate);
+int interface_jtag_add_dr_scans(struct jtag_tap *active,
+		unsigned int num_scans, unsigned int num_fields,
+		const struct scan_field *fields, unsigned int idle_cycles,
+		enum tap_state endstate);
 int interface_jtag_add_plain_dr_scan(
 		int num_bits, const uint8_t *out_bits, uint8_t *in_bits,
 		enum tap_state endstate);
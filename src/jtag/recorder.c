@@ -0,0 +1,569 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Recorder of the adapter traffic in a binary ring file.
+ *
+ * The file starts with a header followed by the ring. Each record starts
+ * with its type, its total length, always a multiple of 8, and a time
+ * stamp in microseconds. A record never wraps at the end of the ring, a
+ * padding record fills the space left instead. The padding has only its
+ * type and length, so that it also fits in the last 8 bytes of the ring.
+ * The header keeps the
+ * logical position of the oldest complete record (tail) and of the next
+ * one to write (head), so the file is valid at any time and can be read
+ * after a crash when it is mapped in memory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <helper/align.h>
+#include <helper/command.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <helper/types.h>
+#include "interface.h"
+#include "commands.h"
+#include "recorder.h"
+#include "swd.h"
+
+#define RECORDER_MAGIC				"OOCDJREC"
+#define RECORDER_VERSION			1
+#define RECORDER_HEADER_SIZE		64
+#define RECORDER_RECORD_HEADER		16
+#define RECORDER_PAD_HEADER			8
+#define RECORDER_DEFAULT_SIZE_KIB	(16 * 1024)
+#define RECORDER_SWD_READS			1024
+
+enum recorder_record_type {
+	REC_PAD = 0x00,
+	REC_JTAG_QUEUE = 0x01,
+	/* JTAG commands, 0x10 + enum jtag_command_type */
+	REC_JTAG_CMD = 0x10,
+	REC_SWD_READ = 0x20,
+	REC_SWD_WRITE = 0x21,
+	REC_SWD_SEQ = 0x22,
+	REC_SWD_RUN = 0x23,
+};
+
+/* offsets in the file header */
+#define HDR_MAGIC			0
+#define HDR_VERSION			8
+#define HDR_HEADER_SIZE		12
+#define HDR_DATA_SIZE		16
+#define HDR_HEAD			24
+#define HDR_TAIL			32
+#define HDR_START_US		40
+#define HDR_RECORDS			48
+#define HDR_DROPPED			56
+
+bool jtag_recorder_active;
+
+static struct {
+	char *filename;
+	int fd;
+	/* file header followed by the ring */
+	uint8_t *map;
+	size_t map_size;
+	bool mapped;
+	uint64_t size;
+	uint64_t head;
+	uint64_t tail;
+	uint64_t records;
+	uint64_t dropped;
+} recorder = {
+	.fd = -1,
+};
+
+/* SWD reads whose value is only known once the queue is run */
+static struct recorder_swd_read {
+	uint32_t *value;
+	uint64_t pos;
+} *recorder_swd_reads;
+static unsigned int recorder_num_swd_reads;
+static unsigned int recorder_max_swd_reads;
+static const struct swd_driver *recorder_swd_real;
+
+int64_t jtag_recorder_time_us(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static uint8_t *recorder_at(uint64_t pos)
+{
+	return recorder.map + RECORDER_HEADER_SIZE + pos % recorder.size;
+}
+
+static void recorder_update_header(void)
+{
+	uint8_t *hdr = recorder.map;
+
+	h_u64_to_le(&hdr[HDR_HEAD], recorder.head);
+	h_u64_to_le(&hdr[HDR_TAIL], recorder.tail);
+	h_u64_to_le(&hdr[HDR_RECORDS], recorder.records);
+	h_u64_to_le(&hdr[HDR_DROPPED], recorder.dropped);
+}
+
+/* drop the oldest records until 'len' bytes are free after head */
+static void recorder_make_room(uint64_t len)
+{
+	while (recorder.head + len - recorder.tail > recorder.size)
+		recorder.tail += le_to_h_u32(recorder_at(recorder.tail) + 4);
+}
+
+static void recorder_put_header(uint8_t *rec, enum recorder_record_type type,
+		uint32_t len, int64_t t_us)
+{
+	h_u16_to_le(&rec[0], type);
+	h_u16_to_le(&rec[2], 0);
+	h_u32_to_le(&rec[4], len);
+	h_u64_to_le(&rec[8], t_us);
+}
+
+static void recorder_put_pad(uint8_t *rec, uint32_t len)
+{
+	h_u16_to_le(&rec[0], REC_PAD);
+	h_u16_to_le(&rec[2], 0);
+	h_u32_to_le(&rec[4], len);
+}
+
+/*
+ * Reserve a record with 'payload' bytes after its header, return a pointer
+ * to the payload in the ring, already zeroed, or NULL if it does not fit.
+ * 'pos' returns the logical position of the record.
+ */
+static uint8_t *recorder_reserve(enum recorder_record_type type, size_t payload,
+		int64_t t_us, uint64_t *pos)
+{
+	uint64_t len = ALIGN_UP(RECORDER_RECORD_HEADER + payload, 8);
+
+	if (len > recorder.size / 2) {
+		recorder.dropped++;
+		return NULL;
+	}
+
+	uint64_t to_end = recorder.size - recorder.head % recorder.size;
+	if (to_end < len) {
+		recorder_make_room(to_end);
+		recorder_put_pad(recorder_at(recorder.head), to_end);
+		recorder.head += to_end;
+	}
+
+	recorder_make_room(len);
+	uint8_t *rec = recorder_at(recorder.head);
+	recorder_put_header(rec, type, len, t_us);
+	memset(rec + RECORDER_RECORD_HEADER, 0, len - RECORDER_RECORD_HEADER);
+
+	if (pos)
+		*pos = recorder.head;
+	recorder.head += len;
+	recorder.records++;
+
+	return rec + RECORDER_RECORD_HEADER;
+}
+
+static size_t recorder_scan_size(const struct scan_command *scan)
+{
+	size_t size = 8;
+
+	for (unsigned int i = 0; i < scan->num_fields; i++) {
+		const struct scan_field *field = &scan->fields[i];
+		size_t bytes = DIV_ROUND_UP(field->num_bits, 8);
+
+		size += 8;
+		if (field->out_value)
+			size += bytes;
+		if (field->in_value)
+			size += bytes;
+	}
+
+	return size;
+}
+
+static void recorder_jtag_scan(const struct scan_command *scan, int64_t t_us)
+{
+	uint8_t *p = recorder_reserve(REC_JTAG_CMD + JTAG_SCAN, recorder_scan_size(scan), t_us, NULL);
+	if (!p)
+		return;
+
+	p[0] = scan->ir_scan;
+	p[1] = scan->end_state;
+	h_u16_to_le(&p[2], MIN(scan->num_fields, UINT16_MAX));
+	p += 8;
+
+	for (unsigned int i = 0; i < scan->num_fields && i < UINT16_MAX; i++) {
+		const struct scan_field *field = &scan->fields[i];
+		size_t bytes = DIV_ROUND_UP(field->num_bits, 8);
+
+		h_u32_to_le(&p[0], field->num_bits);
+		p[4] = (field->out_value ? BIT(0) : 0) | (field->in_value ? BIT(1) : 0);
+		p += 8;
+		if (field->out_value) {
+			memcpy(p, field->out_value, bytes);
+			p += bytes;
+		}
+		if (field->in_value) {
+			memcpy(p, field->in_value, bytes);
+			p += bytes;
+		}
+	}
+}
+
+void jtag_recorder_jtag_queue(const struct jtag_command *cmd, int result,
+		int64_t start_us, int64_t end_us)
+{
+	uint8_t *p = recorder_reserve(REC_JTAG_QUEUE, 16, end_us, NULL);
+	if (p) {
+		h_u32_to_le(&p[0], result);
+		h_u64_to_le(&p[8], start_us);
+	}
+
+	for (; cmd; cmd = cmd->next) {
+		enum recorder_record_type type = REC_JTAG_CMD + cmd->type;
+
+		switch (cmd->type) {
+		case JTAG_SCAN:
+			recorder_jtag_scan(cmd->cmd.scan, end_us);
+			break;
+		case JTAG_TLR_RESET:
+			p = recorder_reserve(type, 8, end_us, NULL);
+			if (p)
+				p[0] = cmd->cmd.statemove->end_state;
+			break;
+		case JTAG_RUNTEST:
+			p = recorder_reserve(type, 8, end_us, NULL);
+			if (p) {
+				h_u32_to_le(&p[0], cmd->cmd.runtest->num_cycles);
+				p[4] = cmd->cmd.runtest->end_state;
+			}
+			break;
+		case JTAG_RESET:
+			p = recorder_reserve(type, 8, end_us, NULL);
+			if (p) {
+				p[0] = (uint8_t)(int8_t)cmd->cmd.reset->trst;
+				p[1] = (uint8_t)(int8_t)cmd->cmd.reset->srst;
+			}
+			break;
+		case JTAG_PATHMOVE:
+			p = recorder_reserve(type, 8 + cmd->cmd.pathmove->num_states, end_us, NULL);
+			if (p) {
+				h_u32_to_le(&p[0], cmd->cmd.pathmove->num_states);
+				for (unsigned int i = 0; i < cmd->cmd.pathmove->num_states; i++)
+					p[8 + i] = cmd->cmd.pathmove->path[i];
+			}
+			break;
+		case JTAG_SLEEP:
+			p = recorder_reserve(type, 8, end_us, NULL);
+			if (p)
+				h_u32_to_le(&p[0], cmd->cmd.sleep->us);
+			break;
+		case JTAG_STABLECLOCKS:
+			p = recorder_reserve(type, 8, end_us, NULL);
+			if (p)
+				h_u32_to_le(&p[0], cmd->cmd.stableclocks->num_cycles);
+			break;
+		case JTAG_TMS:
+			p = recorder_reserve(type, 8 + DIV_ROUND_UP(cmd->cmd.tms->num_bits, 8), end_us, NULL);
+			if (p) {
+				h_u32_to_le(&p[0], cmd->cmd.tms->num_bits);
+				memcpy(&p[8], cmd->cmd.tms->bits, DIV_ROUND_UP(cmd->cmd.tms->num_bits, 8));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	recorder_update_header();
+}
+
+static int recorder_swd_init(void)
+{
+	return recorder_swd_real->init();
+}
+
+static int recorder_swd_switch_seq(enum swd_special_seq seq)
+{
+	uint8_t *p = recorder_reserve(REC_SWD_SEQ, 8, jtag_recorder_time_us(), NULL);
+	if (p)
+		h_u32_to_le(&p[0], seq);
+
+	return recorder_swd_real->switch_seq(seq);
+}
+
+static bool recorder_swd_read_add(uint32_t *value, uint64_t pos)
+{
+	if (recorder_num_swd_reads == recorder_max_swd_reads) {
+		unsigned int max = recorder_max_swd_reads ? 2 * recorder_max_swd_reads : RECORDER_SWD_READS;
+		struct recorder_swd_read *reads = realloc(recorder_swd_reads, max * sizeof(*reads));
+		if (!reads)
+			return false;
+		recorder_swd_reads = reads;
+		recorder_max_swd_reads = max;
+	}
+
+	recorder_swd_reads[recorder_num_swd_reads].value = value;
+	recorder_swd_reads[recorder_num_swd_reads].pos = pos;
+	recorder_num_swd_reads++;
+
+	return true;
+}
+
+static void recorder_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_hint)
+{
+	uint64_t pos;
+	uint8_t *p = recorder_reserve(REC_SWD_READ, 16, jtag_recorder_time_us(), &pos);
+	if (p) {
+		p[0] = cmd;
+		h_u32_to_le(&p[8], ap_delay_hint);
+		/* the record stays without its value */
+		if (value && !recorder_swd_read_add(value, pos))
+			recorder.dropped++;
+	}
+
+	recorder_swd_real->read_reg(cmd, value, ap_delay_hint);
+}
+
+static void recorder_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_hint)
+{
+	uint8_t *p = recorder_reserve(REC_SWD_WRITE, 16, jtag_recorder_time_us(), NULL);
+	if (p) {
+		p[0] = cmd;
+		p[1] = 1;
+		h_u32_to_le(&p[4], value);
+		h_u32_to_le(&p[8], ap_delay_hint);
+	}
+
+	recorder_swd_real->write_reg(cmd, value, ap_delay_hint);
+}
+
+static int recorder_swd_run(void)
+{
+	int64_t start_us = jtag_recorder_time_us();
+	int retval = recorder_swd_real->run();
+
+	/* fill in the values read, unless the records were overwritten */
+	for (unsigned int i = 0; i < recorder_num_swd_reads; i++) {
+		if (retval != ERROR_OK || recorder_swd_reads[i].pos < recorder.tail)
+			continue;
+		uint8_t *p = recorder_at(recorder_swd_reads[i].pos) + RECORDER_RECORD_HEADER;
+		p[1] = 1;
+		h_u32_to_le(&p[4], *recorder_swd_reads[i].value);
+	}
+	recorder_num_swd_reads = 0;
+
+	uint8_t *p = recorder_reserve(REC_SWD_RUN, 16, jtag_recorder_time_us(), NULL);
+	if (p) {
+		h_u32_to_le(&p[0], retval);
+		h_u64_to_le(&p[8], start_us);
+	}
+	recorder_update_header();
+
+	return retval;
+}
+
+static int *recorder_swd_trace(bool swo)
+{
+	return recorder_swd_real->trace(swo);
+}
+
+static const struct swd_driver recorder_swd_driver = {
+	.init = recorder_swd_init,
+	.switch_seq = recorder_swd_switch_seq,
+	.read_reg = recorder_swd_read_reg,
+	.write_reg = recorder_swd_write_reg,
+	.run = recorder_swd_run,
+	.trace = recorder_swd_trace,
+};
+
+const struct swd_driver *jtag_recorder_swd_driver(const struct swd_driver *swd)
+{
+	if (!jtag_recorder_active || !swd)
+		return swd;
+
+	recorder_swd_real = swd;
+	return &recorder_swd_driver;
+}
+
+static int recorder_start(const char *filename, uint64_t size)
+{
+	recorder.size = size;
+	recorder.map_size = RECORDER_HEADER_SIZE + size;
+	recorder.head = 0;
+	recorder.tail = 0;
+	recorder.records = 0;
+	recorder.dropped = 0;
+	recorder.mapped = false;
+
+#ifdef HAVE_SYS_MMAN_H
+	recorder.fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (recorder.fd < 0) {
+		LOG_ERROR("Can't open recorder file \"%s\": %s", filename, strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	if (ftruncate(recorder.fd, recorder.map_size) == 0) {
+		recorder.map = mmap(NULL, recorder.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, recorder.fd, 0);
+		if (recorder.map != MAP_FAILED)
+			recorder.mapped = true;
+	}
+	if (!recorder.mapped) {
+		LOG_DEBUG("Can't map recorder file, recording in memory");
+		close(recorder.fd);
+		recorder.fd = -1;
+	}
+#endif
+
+	if (!recorder.mapped) {
+		recorder.map = calloc(1, recorder.map_size);
+		if (!recorder.map) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	recorder.filename = strdup(filename);
+	if (!recorder.filename) {
+		LOG_ERROR("Out of memory");
+		jtag_recorder_stop();
+		return ERROR_FAIL;
+	}
+
+	uint8_t *hdr = recorder.map;
+	memcpy(&hdr[HDR_MAGIC], RECORDER_MAGIC, 8);
+	h_u32_to_le(&hdr[HDR_VERSION], RECORDER_VERSION);
+	h_u32_to_le(&hdr[HDR_HEADER_SIZE], RECORDER_HEADER_SIZE);
+	h_u64_to_le(&hdr[HDR_DATA_SIZE], recorder.size);
+	h_u64_to_le(&hdr[HDR_START_US], jtag_recorder_time_us());
+	recorder_update_header();
+
+	recorder_num_swd_reads = 0;
+	jtag_recorder_active = true;
+
+	return ERROR_OK;
+}
+
+void jtag_recorder_stop(void)
+{
+	if (!recorder.map)
+		return;
+
+	jtag_recorder_active = false;
+	recorder_update_header();
+
+#ifdef HAVE_SYS_MMAN_H
+	if (recorder.mapped) {
+		munmap(recorder.map, recorder.map_size);
+		close(recorder.fd);
+		recorder.fd = -1;
+		recorder.map = NULL;
+	}
+#endif
+
+	if (recorder.map) {
+		/* recorded in memory, only the used part of the ring is saved */
+		FILE *f = recorder.filename ? fopen(recorder.filename, "wb") : NULL;
+		size_t len = RECORDER_HEADER_SIZE + MIN(recorder.head, recorder.size);
+		if (!f || fwrite(recorder.map, 1, len, f) != len)
+			LOG_ERROR("Can't write recorder file \"%s\"", recorder.filename ? recorder.filename : "");
+		if (f)
+			fclose(f);
+		free(recorder.map);
+		recorder.map = NULL;
+	}
+
+	free(recorder.filename);
+	recorder.filename = NULL;
+
+	free(recorder_swd_reads);
+	recorder_swd_reads = NULL;
+	recorder_num_swd_reads = 0;
+	recorder_max_swd_reads = 0;
+}
+
+COMMAND_HANDLER(handle_recorder_start_command)
+{
+	uint64_t size_kib = RECORDER_DEFAULT_SIZE_KIB;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_NUMBER(u64, CMD_ARGV[1], size_kib);
+
+	if (size_kib < 64) {
+		command_print(CMD, "recorder size must be at least 64 KiB");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	jtag_recorder_stop();
+
+	return recorder_start(CMD_ARGV[0], size_kib * 1024);
+}
+
+COMMAND_HANDLER(handle_recorder_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	jtag_recorder_stop();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_recorder_status_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!jtag_recorder_active) {
+		command_print(CMD, "recorder stopped");
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "recording to %s%s: %" PRIu64 " records, %" PRIu64 " bytes written, "
+			"%" PRIu64 " bytes kept, %" PRIu64 " records dropped or incomplete",
+			recorder.filename, recorder.mapped ? "" : " (in memory)",
+			recorder.records, recorder.head, recorder.head - recorder.tail,
+			recorder.dropped);
+
+	return ERROR_OK;
+}
+
+const struct command_registration jtag_recorder_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_recorder_start_command,
+		.mode = COMMAND_ANY,
+		.help = "start recording the adapter traffic in a ring file",
+		.usage = "filename [size_kib]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_recorder_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "stop recording the adapter traffic",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_recorder_status_command,
+		.mode = COMMAND_ANY,
+		.help = "display the state of the adapter traffic recorder",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
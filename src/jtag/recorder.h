@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_JTAG_RECORDER_H
+#define OPENOCD_JTAG_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file
+ * Binary recorder of the JTAG commands and SWD transactions executed by
+ * the adapter. Records are stored in a ring file, decoded offline by
+ * tools/jtag_record_decode.py.
+ */
+
+struct jtag_command;
+struct swd_driver;
+struct command_registration;
+
+/** Set while a recording is active, checked before calling the recorder */
+extern bool jtag_recorder_active;
+
+/** Record the JTAG commands of a queue just executed, with its result */
+void jtag_recorder_jtag_queue(const struct jtag_command *cmd, int result,
+		int64_t start_us, int64_t end_us);
+
+/**
+ * @returns a driver that records the transactions and forwards them to
+ * @a swd while a recording is active, else @a swd itself.
+ */
+const struct swd_driver *jtag_recorder_swd_driver(const struct swd_driver *swd);
+
+/** @returns the current time in microseconds, as stored in the records */
+int64_t jtag_recorder_time_us(void);
+
+void jtag_recorder_stop(void);
+
+extern const struct command_registration jtag_recorder_command_handlers[];
+
+#endif /* OPENOCD_JTAG_RECORDER_H */
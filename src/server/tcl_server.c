@@ -16,6 +16,18 @@
 #define TCL_SERVER_VERSION		"TCL Server 0.1"
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
+#define TCL_OUTBUF_INITIAL		(4*1024)
+
+/* Header of the frames sent in binary mode, followed by 'length' bytes */
+#define TCL_FRAME_MAGIC			0x00
+#define TCL_FRAME_HEADER_SIZE	8
+
+enum tcl_frame_type {
+	TCL_FRAME_TARGET_TRACE = 1,
+	TCL_FRAME_TARGET_EVENT = 2,
+	TCL_FRAME_TARGET_STATE = 3,
+	TCL_FRAME_TARGET_RESET = 4,
+};
 
 struct tcl_connection {
 	int tc_linedrop;
@@ -26,6 +38,10 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	bool tc_binary;
+	/* reused to build the notification and trace messages */
+	uint8_t *tc_outbuf;
+	size_t tc_outbuf_size;
 };
 
 static char *tcl_port;
@@ -36,26 +52,75 @@ static int tcl_input(struct connection *connection);
 static int tcl_output(struct connection *connection, const void *buf, ssize_t len);
 static int tcl_closed(struct connection *connection);
 
+/* make room for at least 'len' bytes in the per-connection output buffer */
+static uint8_t *tcl_outbuf_reserve(struct tcl_connection *tclc, size_t len)
+{
+	if (len <= tclc->tc_outbuf_size)
+		return tclc->tc_outbuf;
+
+	size_t size = tclc->tc_outbuf_size ? tclc->tc_outbuf_size : TCL_OUTBUF_INITIAL;
+	while (size < len)
+		size *= 2;
+
+	uint8_t *outbuf = realloc(tclc->tc_outbuf, size);
+	if (!outbuf) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+	tclc->tc_outbuf = outbuf;
+	tclc->tc_outbuf_size = size;
+	return outbuf;
+}
+
+/* send a binary frame: magic, type, two reserved bytes, little endian length, payload */
+static int tcl_output_frame(struct connection *connection, enum tcl_frame_type type,
+		const void *data, size_t len)
+{
+	struct tcl_connection *tclc = connection->priv;
+	uint8_t *buf = tcl_outbuf_reserve(tclc, TCL_FRAME_HEADER_SIZE + len);
+	if (!buf)
+		return ERROR_FAIL;
+
+	buf[0] = TCL_FRAME_MAGIC;
+	buf[1] = type;
+	buf[2] = 0;
+	buf[3] = 0;
+	h_u32_to_le(&buf[4], len);
+	memcpy(&buf[TCL_FRAME_HEADER_SIZE], data, len);
+
+	return tcl_output(connection, buf, TCL_FRAME_HEADER_SIZE + len);
+}
+
+static int tcl_output_notification(struct connection *connection, enum tcl_frame_type type,
+		const char *type_name, const char *key, const char *value)
+{
+	struct tcl_connection *tclc = connection->priv;
+	char buf[256];
+
+	if (tclc->tc_binary)
+		return tcl_output_frame(connection, type, value, strlen(value));
+
+	snprintf(buf, sizeof(buf), "type %s %s %s\r\n\x1a", type_name, key, value);
+	return tcl_output(connection, buf, strlen(buf));
+}
+
 static int tcl_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
 {
 	struct connection *connection = priv;
 	struct tcl_connection *tclc;
-	char buf[256];
 
 	tclc = connection->priv;
 
-	if (tclc->tc_notify) {
-		snprintf(buf, sizeof(buf), "type target_event event %s\r\n\x1a", target_event_name(event));
-		tcl_output(connection, buf, strlen(buf));
-	}
+	if (tclc->tc_notify)
+		tcl_output_notification(connection, TCL_FRAME_TARGET_EVENT,
+				"target_event", "event", target_event_name(event));
 
 	if (tclc->tc_laststate != target->state) {
 		tclc->tc_laststate = target->state;
-		if (tclc->tc_notify) {
-			snprintf(buf, sizeof(buf), "type target_state state %s\r\n\x1a", target_state_name(target));
-			tcl_output(connection, buf, strlen(buf));
-		}
+		if (tclc->tc_notify)
+			tcl_output_notification(connection, TCL_FRAME_TARGET_STATE,
+					"target_state", "state", target_state_name(target));
 	}
 
 	return ERROR_OK;
@@ -66,14 +131,12 @@ static int tcl_target_callback_reset_handler(struct target *target,
 {
 	struct connection *connection = priv;
 	struct tcl_connection *tclc;
-	char buf[256];
 
 	tclc = connection->priv;
 
-	if (tclc->tc_notify) {
-		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n\x1a", target_reset_mode_name(reset_mode));
-		tcl_output(connection, buf, strlen(buf));
-	}
+	if (tclc->tc_notify)
+		tcl_output_notification(connection, TCL_FRAME_TARGET_RESET,
+				"target_reset", "mode", target_reset_mode_name(reset_mode));
 
 	return ERROR_OK;
 }
@@ -83,25 +146,30 @@ static int tcl_target_callback_trace_handler(struct target *target,
 {
 	struct connection *connection = priv;
 	struct tcl_connection *tclc;
-	char *header = "type target_trace data ";
-	char *trailer = "\r\n\x1a";
-	size_t hex_len = len * 2 + 1;
-	size_t max_len = hex_len + strlen(header) + strlen(trailer);
-	char *buf, *hex;
+	static const char header[] = "type target_trace data ";
+	static const char trailer[] = "\r\n\x1a";
+	const size_t header_len = sizeof(header) - 1;
+	const size_t trailer_len = sizeof(trailer) - 1;
 
 	tclc = connection->priv;
 
-	if (tclc->tc_trace) {
-		hex = malloc(hex_len);
-		buf = malloc(max_len);
-		hexify(hex, data, len, hex_len);
-		snprintf(buf, max_len, "%s%s%s", header, hex, trailer);
-		tcl_output(connection, buf, strlen(buf));
-		free(hex);
-		free(buf);
-	}
+	if (!tclc->tc_trace)
+		return ERROR_OK;
 
-	return ERROR_OK;
+	if (tclc->tc_binary)
+		return tcl_output_frame(connection, TCL_FRAME_TARGET_TRACE, data, len);
+
+	/* hexify() needs room for its terminating NUL, overwritten by the trailer */
+	size_t max_len = header_len + 2 * len + 1 + trailer_len;
+	char *buf = (char *)tcl_outbuf_reserve(tclc, max_len);
+	if (!buf)
+		return ERROR_FAIL;
+
+	memcpy(buf, header, header_len);
+	size_t hex_len = hexify(buf + header_len, data, len, 2 * len + 1);
+	memcpy(buf + header_len + hex_len, trailer, trailer_len);
+
+	return tcl_output(connection, buf, header_len + hex_len + trailer_len);
 }
 
 /* write data out to a socket.
@@ -254,6 +322,7 @@ static int tcl_closed(struct connection *connection)
 	/* cleanup connection context */
 	if (tclc) {
 		free(tclc->tc_line);
+		free(tclc->tc_outbuf);
 		free(tclc);
 		connection->priv = NULL;
 	}
@@ -323,6 +392,23 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+COMMAND_HANDLER(handle_tcl_binary_command)
+{
+	struct connection *connection = NULL;
+	struct tcl_connection *tclc = NULL;
+
+	if (CMD_CTX->output_handler_priv)
+		connection = CMD_CTX->output_handler_priv;
+
+	if (connection && !strcmp(connection->service->name, "tcl")) {
+		tclc = connection->priv;
+		return CALL_COMMAND_HANDLER(handle_command_parse_bool, &tclc->tc_binary, "Binary framing of notifications and trace ");
+	} else {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+}
+
 static const struct command_registration tcl_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -347,6 +433,13 @@ static const struct command_registration tcl_subcommand_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "binary",
+		.handler = handle_tcl_binary_command,
+		.mode = COMMAND_EXEC,
+		.help = "Binary framing of target notifications and trace output",
+		.usage = "[on|off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -37,6 +37,7 @@ enum halt_mode {
 struct aarch64_private_config {
 	struct adiv5_private_config adiv5_config;
 	struct arm_cti *cti;
+	uint64_t memory_ap_num;
 };
 
 static int aarch64_poll(struct target *target);
@@ -602,6 +603,9 @@ static int aarch64_restore_one(struct target *target, bool current,
 	if (!debug_execution)
 		target_free_all_working_areas(target);
 
+	/* the core may change its translation tables once running */
+	arm_tlb_flush(&armv8->dpm.tlb);
+
 	/* current = true: continue on current pc, otherwise continue at <address> */
 	resume_pc = buf_get_u64(arm->pc->value, 0, 64);
 	if (!current)
@@ -979,6 +983,9 @@ static int aarch64_debug_entry(struct target *target)
 	enum arm_state core_state;
 	uint32_t dscr;
 
+	/* the core may have halted without our resume, e.g. after a reset */
+	arm_tlb_flush(&dpm->tlb);
+
 	/* make sure to clear all sticky errors */
 	retval = mem_ap_write_atomic_u32(armv8->debug_ap,
 			armv8->debug_base + CPUV8_DBG_DRCR, DRCR_CSE);
@@ -2008,11 +2015,12 @@ static int aarch64_assert_reset(struct target *target)
 		return ERROR_FAIL;
 	}
 
-	/* registers are now invalid */
+	/* registers and cached translations are now invalid */
 	if (armv8->arm.core_cache) {
 		register_cache_invalidate(armv8->arm.core_cache);
 		register_cache_invalidate(armv8->arm.core_cache->next);
 	}
+	arm_tlb_flush(&armv8->dpm.tlb);
 
 	target->state = TARGET_RESET;
 
@@ -2021,6 +2029,7 @@ static int aarch64_assert_reset(struct target *target)
 
 static int aarch64_deassert_reset(struct target *target)
 {
+	struct armv8_common *armv8 = target_to_armv8(target);
 	int retval;
 
 	LOG_DEBUG(" ");
@@ -2028,6 +2037,9 @@ static int aarch64_deassert_reset(struct target *target)
 	/* be certain SRST is off */
 	adapter_deassert_reset();
 
+	/* the core may have run and remapped before the halt */
+	arm_tlb_flush(&armv8->dpm.tlb);
+
 	if (!target_was_examined(target))
 		return ERROR_OK;
 
@@ -2509,6 +2521,162 @@ static int aarch64_read_cpu_memory(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * Select the system bus MEM-AP for a memory access instead of the DCC
+ * path through the core. Only done while halted, so that the caches can
+ * be made coherent with the system bus before the access.
+ */
+static bool aarch64_use_memory_ap(struct target *target, uint32_t size)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	if (aarch64->memaccess_mode == AARCH64_MEMACCESS_CPU)
+		return false;
+
+	if (!aarch64->memory_ap) {
+		if (aarch64->memaccess_mode == AARCH64_MEMACCESS_SYSBUS)
+			LOG_TARGET_WARNING(target, "no system bus AP, accessing memory through the core");
+		return false;
+	}
+
+	return target->state == TARGET_HALTED && size <= 8;
+}
+
+/* Clean and invalidate by VA the data cache lines of a range accessed
+ * through the system bus, so that the system bus and the halted core
+ * agree on its content. Nothing to do while the data cache is off. */
+static int aarch64_memory_ap_clean(struct target *target, target_addr_t va, uint32_t len)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	struct armv8_cache_common *cache = &armv8->armv8_mmu.armv8_cache;
+
+	if (!cache->d_u_cache_enabled)
+		return ERROR_OK;
+
+	if (!cache->info_valid)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	return armv8_cache_d_inner_flush_virt(armv8, va, len);
+}
+
+/* Access a physical range through the system bus, in full TAR
+ * auto-increment blocks as split by mem_ap_read_buf()/mem_ap_write_buf(),
+ * with the security attribute of the core or of the translated page */
+static int aarch64_memory_ap_access(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, uint8_t *rbuf, const uint8_t *wbuf, bool nonsecure)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+	struct adiv5_ap *ap = aarch64->memory_ap;
+	uint32_t csw_default = ap->csw_default;
+	int retval;
+
+	if (aarch64->memory_ap_csw_nonsec) {
+		if (nonsecure)
+			ap->csw_default |= aarch64->memory_ap_csw_nonsec;
+		else
+			ap->csw_default &= ~aarch64->memory_ap_csw_nonsec;
+	} else if (!nonsecure) {
+		LOG_TARGET_DEBUG(target, "the system bus AP cannot select a secure access");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/* 64 bits accesses are done as pairs of words, same bytes in memory */
+	if (size == 8) {
+		size = 4;
+		count *= 2;
+	}
+
+	if (rbuf)
+		retval = mem_ap_read_buf(ap, rbuf, size, count, address);
+	else
+		retval = mem_ap_write_buf(ap, wbuf, size, count, address);
+
+	ap->csw_default = csw_default;
+	return retval;
+}
+
+/* Access a physical range through the system bus with the security state
+ * of the core. The cache lines can only be maintained by VA, so with the
+ * MMU and the data cache on this is left to the core, unless the system
+ * bus was explicitly requested. */
+static int aarch64_memory_ap_access_phys(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, uint8_t *rbuf, const uint8_t *wbuf)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+	struct armv8_common *armv8 = &aarch64->armv8_common;
+	bool nonsecure = armv8->dpm.dscr & DSCR_NON_SECURE;
+	int retval;
+
+	if (!armv8->armv8_mmu.mmu_enabled) {
+		/* flat mapping, the physical address is the VA */
+		retval = aarch64_memory_ap_clean(target, address, size * count);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (armv8->armv8_mmu.armv8_cache.d_u_cache_enabled &&
+			aarch64->memaccess_mode != AARCH64_MEMACCESS_SYSBUS) {
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	return aarch64_memory_ap_access(target, address, size, count, rbuf, wbuf, nonsecure);
+}
+
+/* Access a virtual range through the system bus, translating it page by
+ * page; the translations are cached by the DPM while the core is halted.
+ * The NS bit of PAR only gives the security of the page for a translation
+ * done in secure state. */
+static int aarch64_memory_ap_access_virt(struct target *target, target_addr_t address,
+	uint32_t size, uint32_t count, uint8_t *rbuf, const uint8_t *wbuf)
+{
+	/* smallest translation granule */
+	const uint32_t page_size = 4096;
+	bool core_nonsecure = target_to_armv8(target)->dpm.dscr & DSCR_NON_SECURE;
+	int retval;
+
+	while (count) {
+		uint64_t par;
+		uint32_t page_left = page_size - (address & (page_size - 1));
+		uint32_t n = MIN(count, MAX(page_left / size, 1u));
+
+		retval = armv8_mmu_translate_va_par(target, address, &par);
+		if (retval != ERROR_OK)
+			return retval;
+		if (par & 1) {
+			LOG_TARGET_DEBUG(target, "no translation for 0x%" TARGET_PRIxADDR, address);
+			return ERROR_TARGET_TRANSLATION_FAULT;
+		}
+
+		retval = aarch64_memory_ap_clean(target, address, n * size);
+		if (retval != ERROR_OK)
+			return retval;
+
+		target_addr_t phys = (par & 0xFFFFFFFFF000ULL) | (address & 0xFFF);
+		bool nonsecure = core_nonsecure || (par & BIT(9));
+		retval = aarch64_memory_ap_access(target, phys, size, n, rbuf, wbuf, nonsecure);
+		if (retval != ERROR_OK)
+			return retval;
+
+		address += n * size;
+		count -= n;
+		if (rbuf)
+			rbuf += n * size;
+		else
+			wbuf += n * size;
+	}
+
+	return ERROR_OK;
+}
+
+/* In auto mode a failed system bus access, e.g. to secure memory, is
+ * retried through the core; an explicitly requested one just fails */
+static bool aarch64_memory_ap_done(struct target *target, int retval)
+{
+	if (retval == ERROR_OK || target_to_aarch64(target)->memaccess_mode == AARCH64_MEMACCESS_SYSBUS)
+		return true;
+
+	LOG_TARGET_DEBUG(target, "system bus access failed, retrying through the core");
+	return false;
+}
+
 static int aarch64_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
@@ -2516,6 +2684,12 @@ static int aarch64_read_phys_memory(struct target *target,
 	int retval = ERROR_COMMAND_SYNTAX_ERROR;
 
 	if (count && buffer) {
+		if (aarch64_use_memory_ap(target, size)) {
+			retval = aarch64_memory_ap_access_phys(target, address, size, count, buffer, NULL);
+			if (aarch64_memory_ap_done(target, retval))
+				return retval;
+		}
+
 		/* read memory through APB-AP */
 		retval = aarch64_mmu_modify(target, 0);
 		if (retval != ERROR_OK)
@@ -2542,6 +2716,16 @@ static int aarch64_read_memory(struct target *target, target_addr_t address,
 		if (retval != ERROR_OK)
 			return retval;
 	}
+
+	if (aarch64_use_memory_ap(target, size)) {
+		if (mmu_enabled)
+			retval = aarch64_memory_ap_access_virt(target, address, size, count, buffer, NULL);
+		else
+			retval = aarch64_memory_ap_access_phys(target, address, size, count, buffer, NULL);
+		if (aarch64_memory_ap_done(target, retval))
+			return retval;
+	}
+
 	return aarch64_read_cpu_memory(target, address, size, count, buffer);
 }
 
@@ -2552,6 +2736,12 @@ static int aarch64_write_phys_memory(struct target *target,
 	int retval = ERROR_COMMAND_SYNTAX_ERROR;
 
 	if (count && buffer) {
+		if (aarch64_use_memory_ap(target, size)) {
+			retval = aarch64_memory_ap_access_phys(target, address, size, count, NULL, buffer);
+			if (aarch64_memory_ap_done(target, retval))
+				return retval;
+		}
+
 		/* write memory through APB-AP */
 		retval = aarch64_mmu_modify(target, 0);
 		if (retval != ERROR_OK)
@@ -2579,6 +2769,16 @@ static int aarch64_write_memory(struct target *target, target_addr_t address,
 		if (retval != ERROR_OK)
 			return retval;
 	}
+
+	if (aarch64_use_memory_ap(target, size)) {
+		if (mmu_enabled)
+			retval = aarch64_memory_ap_access_virt(target, address, size, count, NULL, buffer);
+		else
+			retval = aarch64_memory_ap_access_phys(target, address, size, count, NULL, buffer);
+		if (aarch64_memory_ap_done(target, retval))
+			return retval;
+	}
+
 	return aarch64_write_cpu_memory(target, address, size, count, buffer);
 }
 
@@ -2614,6 +2814,55 @@ static int aarch64_handle_target_request(void *priv)
 	return ERROR_OK;
 }
 
+/* Get the system bus MEM-AP given by '-memory-ap'. It is not searched
+ * for, the first AXI or AHB MEM-AP of a DAP can be the port of another bus
+ * master. Its absence is not an error, memory is then accessed through
+ * the core only. */
+static void aarch64_find_memory_ap(struct target *target)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+	struct aarch64_private_config *pc = target->private_config;
+	struct adiv5_dap *swjdp = aarch64->armv8_common.arm.dap;
+	struct adiv5_ap *ap;
+	uint32_t idr;
+
+	if (pc->memory_ap_num == DP_APSEL_INVALID)
+		return;
+
+	ap = dap_get_ap(swjdp, pc->memory_ap_num);
+	if (!ap)
+		return;
+
+	int retval = dap_queue_ap_read(ap, AP_REG_IDR(swjdp), &idr);
+	if (retval == ERROR_OK)
+		retval = dap_run(swjdp);
+	if (retval == ERROR_OK)
+		retval = mem_ap_init(ap);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_WARNING(target, "Could not initialize the system bus AP");
+		dap_put_ap(ap);
+		return;
+	}
+
+	switch (idr & AP_TYPE_MASK) {
+	case AP_TYPE_AXI_AP:
+	case AP_TYPE_AXI5_AP:
+		aarch64->memory_ap_csw_nonsec = CSW_AXI_ARPROT1_NONSEC;
+		break;
+	case AP_TYPE_AHB5_AP:
+	case AP_TYPE_AHB5H_AP:
+		aarch64->memory_ap_csw_nonsec = CSW_AHB_SPROT;
+		break;
+	default:
+		/* only non-secure accesses are done through it */
+		aarch64->memory_ap_csw_nonsec = 0;
+		break;
+	}
+
+	LOG_TARGET_DEBUG(target, "system bus AP 0x%" PRIx64 " (IDR 0x%08" PRIx32 ")", ap->ap_num, idr);
+	aarch64->memory_ap = ap;
+}
+
 static int aarch64_examine_first(struct target *target)
 {
 	struct aarch64_common *aarch64 = target_to_aarch64(target);
@@ -2655,6 +2904,9 @@ static int aarch64_examine_first(struct target *target)
 
 	armv8->debug_ap->memaccess_tck = 10;
 
+	if (!aarch64->memory_ap)
+		aarch64_find_memory_ap(target);
+
 	if (!target->dbgbase_set) {
 		/* Lookup Processor DAP */
 		retval = dap_lookup_cs_component(armv8->debug_ap, ARM_CS_C9_DEVTYPE_CORE_DEBUG,
@@ -2798,6 +3050,7 @@ static int aarch64_init_arch_info(struct target *target,
 
 	/* Setup struct aarch64_common */
 	aarch64->common_magic = AARCH64_COMMON_MAGIC;
+	aarch64->memaccess_mode = AARCH64_MEMACCESS_CPU;
 	armv8->arm.dap = dap;
 
 	/* register arch-specific functions */
@@ -2867,6 +3120,8 @@ static void aarch64_deinit_target(struct target *target)
 
 	if (armv8->debug_ap)
 		dap_put_ap(armv8->debug_ap);
+	if (aarch64->memory_ap)
+		dap_put_ap(aarch64->memory_ap);
 
 	armv8_free_reg_cache(target);
 	free(aarch64->brp_list);
@@ -2902,10 +3157,12 @@ static int aarch64_virt2phys(struct target *target, target_addr_t virt,
  */
 enum aarch64_cfg_param {
 	CFG_CTI,
+	CFG_MEMORY_AP,
 };
 
 static const struct jim_nvp nvp_config_opts[] = {
 	{ .name = "-cti", .value = CFG_CTI },
+	{ .name = "-memory-ap", .value = CFG_MEMORY_AP },
 	{ .name = NULL, .value = -1 }
 };
 
@@ -2919,6 +3176,7 @@ static int aarch64_jim_configure(struct target *target, struct jim_getopt_info *
 	if (!pc) {
 		pc = calloc(1, sizeof(struct aarch64_private_config));
 		pc->adiv5_config.ap_num = DP_APSEL_INVALID;
+		pc->memory_ap_num = DP_APSEL_INVALID;
 		target->private_config = pc;
 	}
 
@@ -2978,6 +3236,34 @@ static int aarch64_jim_configure(struct target *target, struct jim_getopt_info *
 			break;
 		}
 
+		case CFG_MEMORY_AP:
+			if (goi->is_configure) {
+				/* jim_wide is a signed 64 bits int, ap_num is unsigned with max 52 bits */
+				jim_wide ap_num;
+				e = jim_getopt_wide(goi, &ap_num);
+				if (e != JIM_OK)
+					return e;
+				if (ap_num < 0 || (ap_num > DP_APSEL_MAX && (ap_num & 0xfff))) {
+					Jim_SetResultString(goi->interp, "Invalid AP number!", -1);
+					return JIM_ERR;
+				}
+				pc->memory_ap_num = ap_num;
+			} else {
+				if (goi->argc != 0) {
+					Jim_WrongNumArgs(goi->interp,
+							goi->argc, goi->argv,
+							"NO PARAMS");
+					return JIM_ERR;
+				}
+
+				if (pc->memory_ap_num == DP_APSEL_INVALID) {
+					Jim_SetResultString(goi->interp, "memory AP not configured", -1);
+					return JIM_ERR;
+				}
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, pc->memory_ap_num));
+			}
+			break;
+
 		default:
 			return JIM_CONTINUE;
 		}
@@ -3067,6 +3353,42 @@ COMMAND_HANDLER(aarch64_mask_interrupts_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(aarch64_memaccess_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	static const struct nvp nvp_memaccess_modes[] = {
+		{ .name = "auto", .value = AARCH64_MEMACCESS_AUTO },
+		{ .name = "cpu", .value = AARCH64_MEMACCESS_CPU },
+		{ .name = "sysbus", .value = AARCH64_MEMACCESS_SYSBUS },
+		{ .name = NULL, .value = -1 },
+	};
+	const struct nvp *n;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		n = nvp_name2value(nvp_memaccess_modes, CMD_ARGV[0]);
+		if (!n->name) {
+			LOG_ERROR("Unknown parameter: %s - should be auto, cpu or sysbus", CMD_ARGV[0]);
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+
+		aarch64->memaccess_mode = n->value;
+	}
+
+	n = nvp_value2name(nvp_memaccess_modes, aarch64->memaccess_mode);
+	if (aarch64->memory_ap)
+		command_print(CMD, "aarch64 memaccess %s, system bus AP 0x%" PRIx64,
+			n->name, aarch64->memory_ap->ap_num);
+	else
+		command_print(CMD, "aarch64 memaccess %s, no system bus AP", n->name);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(aarch64_mcrmrc_command)
 {
 	bool is_mcr = false;
@@ -3199,6 +3521,14 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 		.help = "mask aarch64 interrupts during single-step",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "memaccess",
+		.handler = aarch64_memaccess_command,
+		.mode = COMMAND_ANY,
+		.help = "select the path of memory accesses, through the core "
+			"or the system bus AP",
+		.usage = "['auto'|'cpu'|'sysbus']",
+	},
 	{
 		.name = "mcr",
 		.mode = COMMAND_EXEC,
@@ -3216,6 +3546,9 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 	{
 		.chain = smp_command_handlers,
 	},
+	{
+		.chain = arm_tlb_command_handlers,
+	},
 
 
 	COMMAND_REGISTRATION_DONE
@@ -29,6 +29,12 @@ enum aarch64_isrmasking_mode {
 	AARCH64_ISRMASK_ON,
 };
 
+enum aarch64_memaccess_mode {
+	AARCH64_MEMACCESS_AUTO,
+	AARCH64_MEMACCESS_CPU,
+	AARCH64_MEMACCESS_SYSBUS,
+};
+
 struct aarch64_brp {
 	int used;
 	int type;
@@ -58,6 +64,12 @@ struct aarch64_common {
 	struct aarch64_brp *wp_list;
 
 	enum aarch64_isrmasking_mode isrmasking_mode;
+
+	/* System bus MEM-AP, used to access memory without the core */
+	struct adiv5_ap *memory_ap;
+	enum aarch64_memaccess_mode memaccess_mode;
+	/* CSW bit of the system bus MEM-AP selecting non-secure accesses, 0 if none */
+	uint32_t memory_ap_csw_nonsec;
 };
 
 static inline struct aarch64_common *
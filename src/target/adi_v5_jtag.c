@@ -271,16 +271,17 @@ static int adi_jtag_dp_scan_cmd(struct adiv5_dap *dap, struct dap_cmd *cmd, uint
 	cmd->fields[1].out_value = cmd->outvalue_buf;
 	cmd->fields[1].in_value = cmd->invalue;
 
-	jtag_add_dr_scan(tap, 2, cmd->fields, TAP_IDLE);
-
 	/* Add specified number of tck clocks after starting AP register
 	 * access or memory bus access, giving the hardware time to complete
 	 * the access.
 	 * They provide more time for the (MEM) AP to complete the read ...
 	 * See "Minimum Response Time" for JTAG-DP, in the ADIv5/ADIv6 spec.
+	 *
+	 * The out buffers are in the cmd, kept in the journal until the
+	 * queue is run, so they are not copied in the queue.
 	 */
-	if (cmd->instr == JTAG_DP_APACC && cmd->memaccess_tck != 0)
-		jtag_add_runtest(cmd->memaccess_tck, TAP_IDLE);
+	unsigned int idle = (cmd->instr == JTAG_DP_APACC) ? cmd->memaccess_tck : 0;
+	jtag_add_dr_scans(tap, 1, 2, cmd->fields, idle, TAP_IDLE);
 
 	return ERROR_OK;
 }
@@ -793,6 +793,10 @@ int dap_dp_init(struct adiv5_dap *dap)
 	dap->do_reconnect = false;
 	dap_invalidate_cache(dap);
 
+	/* the power state of the components may have changed */
+	for (unsigned int i = 0; i <= DP_APSEL_MAX; i++)
+		dap->ap[i].cs_index_valid = false;
+
 	/*
 	 * Early initialize dap->dp_ctrl_stat.
 	 * In jtag mode only, if the following queue run (in dap_dp_poll_register)
@@ -1213,6 +1217,14 @@ struct adiv5_ap *dap_get_config_ap(struct adiv5_dap *dap, uint64_t ap_num)
 	return ap;
 }
 
+void dap_cs_index_free(struct adiv5_ap *ap)
+{
+	free(ap->cs_index);
+	ap->cs_index = NULL;
+	ap->cs_index_count = 0;
+	ap->cs_index_valid = false;
+}
+
 /* Decrement AP refcount and release the AP when refcount reaches zero */
 int dap_put_ap(struct adiv5_ap *ap)
 {
@@ -1225,6 +1237,7 @@ int dap_put_ap(struct adiv5_ap *ap)
 
 	LOG_DEBUG("refcount AP#0x%" PRIx64 " put %u", ap->ap_num, ap->refcount);
 	if (!is_ap_in_use(ap)) {
+		dap_cs_index_free(ap);
 		/* defaults from dap_instance_init() */
 		ap->ap_num = DP_APSEL_INVALID;
 		ap->memaccess_tck = 255;
@@ -1847,6 +1860,9 @@ static int rtp_ops_rom_table_entry(const struct rtp_ops *ops,
 /* Broken ROM tables can have circular references. Stop after a while */
 #define ROM_TABLE_MAX_DEPTH (16)
 
+/* Number of ROM table entries read with a single dap_run() */
+#define ROM_TABLE_ENTRIES_PER_RUN (16)
+
 /**
  * Value used only during lookup of a CoreSight component in ROM table.
  * Return CORESIGHT_COMPONENT_FOUND when component is found.
@@ -1870,25 +1886,48 @@ static int rtp_rom_loop(enum coresight_access_mode mode, const struct rtp_ops *o
 	assert(IS_ALIGNED(base_address, ARM_CS_ALIGN));
 
 	unsigned int offset = 0;
+	uint32_t romentries_low[ROM_TABLE_ENTRIES_PER_RUN];
+	uint32_t romentries_high[ROM_TABLE_ENTRIES_PER_RUN];
+	unsigned int num_read = 0;
+	unsigned int next = 0;
 	while (max_entries--) {
 		uint64_t romentry;
 		uint32_t romentry_low, romentry_high;
 		target_addr_t component_base;
 		unsigned int saved_offset = offset;
+		int retval = ERROR_OK;
 
-		int retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_low);
-		offset += 4;
-		if (retval == ERROR_OK && width == 64) {
-			retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_high);
-			offset += 4;
-		}
-		if (retval == ERROR_OK)
-			retval = dap_run(ap->dap);
-		if (retval != ERROR_OK) {
-			LOG_DEBUG("Failed read ROM table entry");
-			return retval;
+		/*
+		 * Read the following entries in a single run. The entries
+		 * after the end of the table read as zero.
+		 */
+		if (next == num_read) {
+			num_read = MIN(max_entries + 1, ROM_TABLE_ENTRIES_PER_RUN);
+			next = 0;
+			unsigned int read_offset = offset;
+			for (unsigned int i = 0; i < num_read && retval == ERROR_OK; i++) {
+				retval = dap_queue_read_reg(mode, ap, base_address, read_offset,
+						&romentries_low[i]);
+				read_offset += 4;
+				if (retval == ERROR_OK && width == 64) {
+					retval = dap_queue_read_reg(mode, ap, base_address, read_offset,
+							&romentries_high[i]);
+					read_offset += 4;
+				}
+			}
+			if (retval == ERROR_OK)
+				retval = dap_run(ap->dap);
+			if (retval != ERROR_OK) {
+				LOG_DEBUG("Failed read ROM table entry");
+				return rtp_ops_rom_table_entry(ops, retval, depth, offset, 0);
+			}
 		}
 
+		romentry_low = romentries_low[next];
+		romentry_high = (width == 64) ? romentries_high[next] : 0;
+		next++;
+		offset += width / 8;
+
 		if (width == 64) {
 			romentry = (((uint64_t)romentry_high) << 32) | romentry_low;
 			component_base = base_address +
@@ -2253,22 +2292,42 @@ int dap_info_command(struct command_invocation *cmd, struct adiv5_ap *ap)
 
 /* Actions for dap_lookup_cs_component() */
 
-struct dap_lookup_data {
-	/* input */
-	unsigned int idx;
-	unsigned int type;
-	/* output */
-	uint64_t component_base;
+/* A Class 0x9 CoreSight component found while parsing the ROM tables */
+struct cs_index_entry {
 	uint64_t ap_num;
+	target_addr_t component_base;
+	uint32_t devtype;
+};
+
+struct dap_lookup_data {
+	/* Components in the order of the ROM table parsing */
+	struct cs_index_entry *entries;
+	unsigned int count;
+	unsigned int allocated;
+	/* Some component or ROM table could not be read */
+	bool incomplete;
 };
 
+static int dap_lookup_cs_component_rom_table_entry(int retval, int depth,
+		unsigned int offset, uint64_t romentry, void *priv)
+{
+	struct dap_lookup_data *lookup = priv;
+
+	if (retval != ERROR_OK)
+		lookup->incomplete = true;
+
+	return retval;
+}
+
 static int dap_lookup_cs_component_cs_component(int retval,
 		struct cs_component_vals *v, int depth, void *priv)
 {
 	struct dap_lookup_data *lookup = priv;
 
-	if (retval != ERROR_OK)
+	if (retval != ERROR_OK) {
+		lookup->incomplete = true;
 		return retval;
+	}
 
 	if (!is_valid_arm_cs_cidr(v->cid))
 		return ERROR_OK;
@@ -2277,51 +2336,113 @@ static int dap_lookup_cs_component_cs_component(int retval,
 	if (class != ARM_CS_CLASS_0X9_CS_COMPONENT)
 		return ERROR_OK;
 
-	if ((v->devtype_memtype & ARM_CS_C9_DEVTYPE_MASK) != lookup->type)
-		return ERROR_OK;
-
-	if (lookup->idx) {
-		/* search for next one */
-		--lookup->idx;
-		return ERROR_OK;
+	if (lookup->count == lookup->allocated) {
+		unsigned int allocated = lookup->allocated ? 2 * lookup->allocated : 16;
+		struct cs_index_entry *entries = realloc(lookup->entries,
+				allocated * sizeof(*entries));
+		if (!entries) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		lookup->entries = entries;
+		lookup->allocated = allocated;
 	}
 
-	/* Found! */
-	lookup->component_base = v->component_base;
-	lookup->ap_num = v->ap->ap_num;
-	return CORESIGHT_COMPONENT_FOUND;
+	struct cs_index_entry *entry = &lookup->entries[lookup->count++];
+	entry->ap_num = v->ap->ap_num;
+	entry->component_base = v->component_base;
+	entry->devtype = v->devtype_memtype & ARM_CS_C9_DEVTYPE_MASK;
+	return ERROR_OK;
 }
 
-int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
-		target_addr_t *addr, int32_t core_id)
+/*
+ * Parse all the ROM tables reachable from the AP once, and keep the index
+ * of the CoreSight components in the AP. All the cores behind the same AP
+ * then look up their component without parsing the ROM tables again. The
+ * index is not kept when some part could not be read, e.g. because it was
+ * powered down, so that a later lookup can find it.
+ */
+static int dap_cs_index_build(struct adiv5_ap *ap)
 {
 	struct dap_lookup_data lookup = {
-		.type = type,
-		.idx  = core_id,
+		.entries = NULL,
 	};
 	struct rtp_ops dap_lookup_cs_component_ops = {
 		.ap_header       = NULL,
 		.mem_ap_header   = NULL,
 		.cs_component    = dap_lookup_cs_component_cs_component,
-		.rom_table_entry = NULL,
+		.rom_table_entry = dap_lookup_cs_component_rom_table_entry,
 		.priv            = &lookup,
 	};
 
+	dap_cs_index_free(ap);
+
 	int retval = rtp_ap(&dap_lookup_cs_component_ops, ap, 0);
-	if (retval == CORESIGHT_COMPONENT_FOUND) {
-		if (lookup.ap_num != ap->ap_num) {
-			/* TODO: handle search from root ROM table */
-			LOG_DEBUG("CS lookup ended in AP # 0x%" PRIx64 ". Ignore it", lookup.ap_num);
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
-		LOG_DEBUG("CS lookup found at 0x%" PRIx64, lookup.component_base);
-		*addr = lookup.component_base;
-		return ERROR_OK;
-	}
 	if (retval != ERROR_OK) {
-		LOG_DEBUG("CS lookup error %d", retval);
+		free(lookup.entries);
 		return retval;
 	}
+
+	ap->cs_index = lookup.entries;
+	ap->cs_index_count = lookup.count;
+	ap->cs_index_valid = !lookup.incomplete;
+	LOG_DEBUG("AP#0x%" PRIx64 ": %u CoreSight components%s", ap->ap_num,
+			lookup.count, lookup.incomplete ? ", incomplete" : "");
+	return ERROR_OK;
+}
+
+int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
+		target_addr_t *addr, int32_t core_id)
+{
+	bool rebuilt = false;
+
+	if (!ap->cs_index_valid) {
+		int retval = dap_cs_index_build(ap);
+		if (retval != ERROR_OK) {
+			LOG_DEBUG("CS lookup error %d", retval);
+			return retval;
+		}
+		rebuilt = true;
+	}
+
+	while (true) {
+		unsigned int idx = core_id;
+		for (unsigned int i = 0; i < ap->cs_index_count; i++) {
+			const struct cs_index_entry *entry = &ap->cs_index[i];
+
+			if (entry->devtype != type)
+				continue;
+
+			if (idx) {
+				/* search for next one */
+				--idx;
+				continue;
+			}
+
+			/* Found! */
+			if (entry->ap_num != ap->ap_num) {
+				/* TODO: handle search from root ROM table */
+				LOG_DEBUG("CS lookup ended in AP # 0x%" PRIx64 ". Ignore it", entry->ap_num);
+				return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+			}
+			LOG_DEBUG("CS lookup found at 0x%" PRIx64, entry->component_base);
+			*addr = entry->component_base;
+			return ERROR_OK;
+		}
+
+		if (rebuilt)
+			break;
+
+		/* The component may have been powered down or RAZ when the
+		 * index was built, parse the ROM tables again once */
+		int retval = dap_cs_index_build(ap);
+		if (retval != ERROR_OK) {
+			LOG_DEBUG("CS lookup error %d", retval);
+			return retval;
+		}
+		rebuilt = true;
+	}
+
 	LOG_DEBUG("CS lookup not found");
 	return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 }
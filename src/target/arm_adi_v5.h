@@ -326,6 +326,12 @@ struct adiv5_ap {
 
 	/* AP referenced during config. Never put it, even when refcount reaches zero */
 	bool config_ap_never_release;
+
+	/* CoreSight components found behind this AP by the first
+	 * dap_lookup_cs_component(), reused by the following lookups */
+	struct cs_index_entry *cs_index;
+	unsigned int cs_index_count;
+	bool cs_index_valid;
 };
 
 
@@ -762,6 +768,9 @@ static inline bool dap_is_multidrop(struct adiv5_dap *dap)
 int dap_lookup_cs_component(struct adiv5_ap *ap,
 			uint8_t type, target_addr_t *addr, int32_t idx);
 
+/* Free the index of CoreSight components built by dap_lookup_cs_component() */
+void dap_cs_index_free(struct adiv5_ap *ap);
+
 struct target;
 
 /* Put debug link into SWD mode */
@@ -17,6 +17,7 @@
 #include "helper/command.h"
 #include "transport/transport.h"
 #include "jtag/interface.h"
+#include "jtag/recorder.h"
 
 static OOCD_LIST_HEAD(all_dap);
 
@@ -60,7 +61,7 @@ const char *adiv5_dap_name(struct adiv5_dap *self)
 const struct swd_driver *adiv5_dap_swd_driver(struct adiv5_dap *self)
 {
 	struct arm_dap_object *obj = container_of(self, struct arm_dap_object, dap);
-	return obj->swd;
+	return jtag_recorder_swd_driver(obj->swd);
 }
 
 struct adiv5_dap *adiv5_get_dap(struct arm_dap_object *obj)
@@ -167,6 +168,8 @@ int dap_cleanup_all(void)
 		for (unsigned int i = 0; i <= DP_APSEL_MAX; i++) {
 			if (dap->ap[i].refcount != 0)
 				LOG_ERROR("BUG: refcount AP#%u still %u at exit", i, dap->ap[i].refcount);
+			/* also kept by the config APs, which are never put */
+			dap_cs_index_free(&dap->ap[i]);
 		}
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
@@ -105,6 +105,8 @@ static int dpm_mcr(struct target *target, int cpnum,
 			ARMV4_5_MCR(cpnum, op1, 0, crn, crm, op2),
 			value);
 
+	arm_tlb_cp15_write(&dpm->tlb, cpnum, crn);
+
 	dpm->finish(dpm);
 	return retval;
 }
@@ -127,6 +129,8 @@ static int dpm_mcrr(struct target *target, int cpnum,
 	retval = dpm->instr_write_data_r0_r1(dpm,
 			ARMV5_T_MCRR(cpnum, op, 0, 1, crm), value);
 
+	arm_tlb_cp15_write(&dpm->tlb, cpnum, crm);
+
 	dpm->finish(dpm);
 
 	return retval;
@@ -1096,6 +1100,7 @@ int arm_dpm_setup(struct arm_dpm *dpm)
 	struct reg_cache *cache = NULL;
 
 	arm->dpm = dpm;
+	arm_tlb_init(&dpm->tlb);
 
 	/* register access setup */
 	arm->full_context = arm_dpm_full_context;
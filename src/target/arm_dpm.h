@@ -7,6 +7,8 @@
 #ifndef OPENOCD_TARGET_ARM_DPM_H
 #define OPENOCD_TARGET_ARM_DPM_H
 
+#include "arm_tlb.h"
+
 /**
  * @file
  * This is the interface to the Debug Programmers Model for ARMv6 and
@@ -50,6 +52,9 @@ struct arm_dpm {
 	/** Cache of DIDR */
 	uint64_t didr;
 
+	/** Cache of the address translations done while halted */
+	struct arm_tlb tlb;
+
 	/** Invoke before a series of instruction operations */
 	int (*prepare)(struct arm_dpm *dpm);
 
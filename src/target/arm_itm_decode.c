@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Table driven decoder for the ITM/DWT trace packet stream.
+ *
+ * Every header byte is classified once through a 256 entry table that
+ * gives the packet kind and the size of its payload. Payloads of source
+ * packets are handed out by pointer into the caller's buffer, so that
+ * only packets straddling two buffers are copied in the decoder state.
+ */
+
+/*
+ * Relevant specifications from ARM include:
+ *
+ * ARMv7-M Architecture Reference Manual, Appendix D4          ARM DDI 0403E
+ * CoreSight(tm) Architecture Specification, Chapter D4        ARM IHI 0029E
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <helper/bits.h>
+#include "arm_itm_decode.h"
+
+#define TPIU_FRAME_SIZE			16
+#define TPIU_FRAME_SYNC			0xFFFFFF7F
+#define TPIU_NULL_ID			0x00
+
+#define ITM_SYNC_MIN_ZEROS		5
+#define ITM_SYNC_END			0x80
+#define ITM_CONTINUATION		BIT(7)
+
+/* DWT hardware source discriminator IDs */
+#define DWT_ID_EVENT_COUNTER	0
+#define DWT_ID_EXCEPTION		1
+#define DWT_ID_PC_SAMPLE		2
+#define DWT_ID_DATA_TRACE_MIN	8
+#define DWT_ID_DATA_TRACE_MAX	23
+
+enum itm_packet_kind {
+	ITM_PKT_RESERVED,
+	ITM_PKT_SYNC_ZERO,
+	ITM_PKT_SYNC_END,
+	ITM_PKT_OVERFLOW,
+	ITM_PKT_TIMESTAMP_SHORT,
+	ITM_PKT_TIMESTAMP,		/* local/global timestamp with continuation payload */
+	ITM_PKT_EXTENSION,
+	ITM_PKT_SOFTWARE,
+	ITM_PKT_HARDWARE,
+};
+
+struct itm_header_info {
+	uint8_t kind;
+	uint8_t len;
+};
+
+static struct itm_header_info itm_header_table[256];
+static bool itm_header_table_ready;
+
+static const char * const event_counter_names[] = {
+	"CPI", "EXC", "SLEEP", "LSU", "FOLD", "CYC",
+};
+
+const char *arm_itm_event_counter_name(unsigned int bit)
+{
+	if (bit >= ARRAY_SIZE(event_counter_names))
+		return "?";
+	return event_counter_names[bit];
+}
+
+static void itm_header_table_init(void)
+{
+	static const uint8_t source_len[4] = { 0, 1, 2, 4 };
+
+	for (unsigned int h = 0; h < 256; h++) {
+		struct itm_header_info *info = &itm_header_table[h];
+
+		info->kind = ITM_PKT_RESERVED;
+		info->len = 0;
+
+		if (h & 0x03) {
+			info->kind = (h & BIT(2)) ? ITM_PKT_HARDWARE : ITM_PKT_SOFTWARE;
+			info->len = source_len[h & 0x03];
+		} else if (h == 0x00) {
+			info->kind = ITM_PKT_SYNC_ZERO;
+		} else if (h == ITM_SYNC_END) {
+			info->kind = ITM_PKT_SYNC_END;
+		} else if (h == 0x70) {
+			info->kind = ITM_PKT_OVERFLOW;
+		} else if ((h & 0x8f) == 0x00) {
+			/* local timestamp format 2, value 1..6 in the header */
+			info->kind = ITM_PKT_TIMESTAMP_SHORT;
+		} else if ((h & 0xcf) == 0xc0 || h == 0x94 || h == 0xb4) {
+			/* local timestamp format 1, global timestamp 1 and 2 */
+			info->kind = ITM_PKT_TIMESTAMP;
+		} else if ((h & 0x0b) == 0x08) {
+			info->kind = ITM_PKT_EXTENSION;
+		}
+	}
+
+	itm_header_table_ready = true;
+}
+
+void arm_itm_decode_reset(struct arm_itm_decoder *dec)
+{
+	dec->frame_pos = 0;
+	dec->cur_id = TPIU_NULL_ID;
+	dec->sync_window = 0;
+	dec->header = 0;
+	dec->payload_len = 0;
+	dec->payload_pos = 0;
+	dec->continuation = false;
+	dec->zeros = 0;
+}
+
+void arm_itm_decode_init(struct arm_itm_decoder *dec, const struct arm_itm_decode_ops *ops, void *priv)
+{
+	if (!itm_header_table_ready)
+		itm_header_table_init();
+
+	memset(dec, 0, sizeof(*dec));
+	dec->trace_id = 1;
+	dec->ops = ops;
+	dec->priv = priv;
+	arm_itm_decode_reset(dec);
+}
+
+static void itm_hardware_packet(struct arm_itm_decoder *dec, unsigned int id,
+		const uint8_t *data, unsigned int len)
+{
+	struct arm_itm_decode_stats *stats = &dec->stats;
+	uint32_t value = 0;
+
+	for (unsigned int i = 0; i < len; i++)
+		value |= (uint32_t)data[i] << (8 * i);
+
+	switch (id) {
+	case DWT_ID_EVENT_COUNTER:
+		for (unsigned int i = 0; i < ARRAY_SIZE(stats->event_counters); i++)
+			if (value & BIT(i))
+				stats->event_counters[i]++;
+		break;
+	case DWT_ID_EXCEPTION:
+		if (len != 2) {
+			stats->errors++;
+			break;
+		}
+		stats->exceptions[value & 0x1ff][(value >> 12) & 0x3]++;
+		break;
+	case DWT_ID_PC_SAMPLE:
+		if (len == 4) {
+			stats->pc_samples++;
+			if (dec->ops && dec->ops->pc_sample)
+				dec->ops->pc_sample(dec->priv, value, false);
+		} else {
+			stats->pc_sleep_samples++;
+			if (dec->ops && dec->ops->pc_sample)
+				dec->ops->pc_sample(dec->priv, 0, true);
+		}
+		break;
+	default:
+		if (id >= DWT_ID_DATA_TRACE_MIN && id <= DWT_ID_DATA_TRACE_MAX)
+			stats->data_trace_packets++;
+		else
+			stats->errors++;
+		break;
+	}
+}
+
+static void itm_source_packet(struct arm_itm_decoder *dec, uint8_t header,
+		const uint8_t *data, unsigned int len)
+{
+	unsigned int id = header >> 3;
+
+	if (header & BIT(2)) {
+		itm_hardware_packet(dec, id, data, len);
+		return;
+	}
+
+	dec->stats.stimulus_packets[id]++;
+	dec->stats.stimulus_bytes[id] += len;
+	if (dec->ops && dec->ops->stimulus)
+		dec->ops->stimulus(dec->priv, id, data, len);
+}
+
+/* Decode a contiguous run of ITM bytes, free of any TPIU framing */
+static void itm_decode_stream(struct arm_itm_decoder *dec, const uint8_t *buf, size_t size)
+{
+	size_t i = 0;
+
+	while (i < size) {
+		/* complete a payload left over from the previous buffer */
+		if (dec->payload_len) {
+			while (dec->payload_pos < dec->payload_len && i < size)
+				dec->payload[dec->payload_pos++] = buf[i++];
+			if (dec->payload_pos < dec->payload_len)
+				return;
+			itm_source_packet(dec, dec->header, dec->payload, dec->payload_len);
+			dec->payload_len = 0;
+			dec->payload_pos = 0;
+			continue;
+		}
+
+		if (dec->continuation) {
+			dec->continuation = buf[i++] & ITM_CONTINUATION;
+			continue;
+		}
+
+		uint8_t header = buf[i++];
+		const struct itm_header_info *info = &itm_header_table[header];
+
+		if (info->kind != ITM_PKT_SYNC_ZERO && info->kind != ITM_PKT_SYNC_END)
+			dec->zeros = 0;
+
+		switch (info->kind) {
+		case ITM_PKT_SOFTWARE:
+		case ITM_PKT_HARDWARE:
+			if (size - i >= info->len) {
+				itm_source_packet(dec, header, &buf[i], info->len);
+				i += info->len;
+			} else {
+				dec->header = header;
+				dec->payload_len = info->len;
+				dec->payload_pos = 0;
+			}
+			break;
+		case ITM_PKT_SYNC_ZERO:
+			dec->zeros++;
+			break;
+		case ITM_PKT_SYNC_END:
+			if (dec->zeros >= ITM_SYNC_MIN_ZEROS)
+				dec->stats.syncs++;
+			else
+				dec->stats.errors++;
+			dec->zeros = 0;
+			break;
+		case ITM_PKT_OVERFLOW:
+			dec->stats.overflows++;
+			break;
+		case ITM_PKT_TIMESTAMP_SHORT:
+			dec->stats.timestamps++;
+			break;
+		case ITM_PKT_TIMESTAMP:
+			dec->stats.timestamps++;
+			dec->continuation = true;
+			break;
+		case ITM_PKT_EXTENSION:
+			dec->continuation = header & ITM_CONTINUATION;
+			break;
+		default:
+			dec->stats.errors++;
+			break;
+		}
+	}
+}
+
+/*
+ * Extract the bytes of the ITM source from a 16 bytes TPIU frame.
+ * Even bytes carry either an ID change (bit 0 set) or data whose bit 0
+ * is stored in the auxiliary byte 15; odd bytes always carry data.
+ */
+static void tpiu_decode_frame(struct arm_itm_decoder *dec)
+{
+	const uint8_t *frame = dec->frame;
+	const uint8_t aux = frame[TPIU_FRAME_SIZE - 1];
+	uint8_t out[TPIU_FRAME_SIZE - 1];
+	unsigned int n = 0;
+
+	for (unsigned int i = 0; i < TPIU_FRAME_SIZE / 2; i++) {
+		const uint8_t even = frame[2 * i];
+		const bool has_odd = i < TPIU_FRAME_SIZE / 2 - 1;
+		const bool aux_bit = aux & BIT(i);
+
+		if (even & BIT(0)) {
+			uint8_t new_id = even >> 1;
+			/* aux bit set: the new ID applies after the next data byte */
+			if (!aux_bit)
+				dec->cur_id = new_id;
+			if (has_odd && dec->cur_id == dec->trace_id)
+				out[n++] = frame[2 * i + 1];
+			dec->cur_id = new_id;
+		} else {
+			if (dec->cur_id == dec->trace_id) {
+				out[n++] = even | aux_bit;
+				if (has_odd)
+					out[n++] = frame[2 * i + 1];
+			}
+		}
+	}
+
+	dec->stats.frames++;
+	if (n)
+		itm_decode_stream(dec, out, n);
+}
+
+void arm_itm_decode(struct arm_itm_decoder *dec, const uint8_t *buf, size_t size)
+{
+	dec->stats.bytes += size;
+
+	if (!dec->deframe) {
+		itm_decode_stream(dec, buf, size);
+		return;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		dec->sync_window = (dec->sync_window << 8) | buf[i];
+		if (dec->sync_window == TPIU_FRAME_SYNC) {
+			/* frame synchronization, next byte starts a frame */
+			dec->frame_pos = 0;
+			continue;
+		}
+
+		dec->frame[dec->frame_pos++] = buf[i];
+		if (dec->frame_pos == TPIU_FRAME_SIZE) {
+			tpiu_decode_frame(dec);
+			dec->frame_pos = 0;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_ITM_DECODE_H
+#define OPENOCD_TARGET_ARM_ITM_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file
+ * Streaming decoder for the ITM/DWT packet protocol, as described in
+ * ARMv7-M Architecture Reference Manual, Appendix D4 "Debug ITM and DWT
+ * Packet Protocol", with optional removal of the TPIU formatter framing.
+ */
+
+#define ITM_STIMULUS_PORTS		32
+#define ITM_EXCEPTION_NUMBERS	512
+
+/* Function field of a DWT exception trace packet */
+enum itm_exception_function {
+	ITM_EXC_ENTER = 1,
+	ITM_EXC_EXIT = 2,
+	ITM_EXC_RETURN = 3,
+};
+
+struct arm_itm_decode_ops {
+	/**
+	 * Payload of an instrumentation (stimulus port) packet. @a data points
+	 * either into the buffer passed to arm_itm_decode() or, for packets
+	 * split across two calls, into the decoder's own state.
+	 */
+	void (*stimulus)(void *priv, unsigned int port, const uint8_t *data, unsigned int len);
+	/** DWT periodic PC sample; @a sleep is set when the core was sleeping */
+	void (*pc_sample)(void *priv, uint32_t pc, bool sleep);
+};
+
+struct arm_itm_decode_stats {
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t timestamps;
+	uint64_t errors;
+	uint64_t stimulus_packets[ITM_STIMULUS_PORTS];
+	uint64_t stimulus_bytes[ITM_STIMULUS_PORTS];
+	uint64_t pc_samples;
+	uint64_t pc_sleep_samples;
+	/** Count of DWT event counter wraps, one per bit of the packet payload */
+	uint64_t event_counters[6];
+	uint64_t data_trace_packets;
+	uint32_t exceptions[ITM_EXCEPTION_NUMBERS][ITM_EXC_RETURN + 1];
+};
+
+struct arm_itm_decoder {
+	/** Remove TPIU formatter framing before decoding */
+	bool deframe;
+	/** Formatter trace source ID carrying the ITM stream */
+	uint8_t trace_id;
+
+	/* formatter state */
+	uint8_t frame[16];
+	unsigned int frame_pos;
+	uint8_t cur_id;
+	uint32_t sync_window;
+
+	/* ITM packet state */
+	uint8_t header;
+	uint8_t payload[5];
+	unsigned int payload_len;
+	unsigned int payload_pos;
+	bool continuation;
+	unsigned int zeros;
+
+	const struct arm_itm_decode_ops *ops;
+	void *priv;
+
+	struct arm_itm_decode_stats stats;
+};
+
+void arm_itm_decode_init(struct arm_itm_decoder *dec, const struct arm_itm_decode_ops *ops, void *priv);
+void arm_itm_decode_reset(struct arm_itm_decoder *dec);
+void arm_itm_decode(struct arm_itm_decoder *dec, const uint8_t *buf, size_t size);
+
+const char *arm_itm_event_counter_name(unsigned int bit);
+
+#endif /* OPENOCD_TARGET_ARM_ITM_DECODE_H */
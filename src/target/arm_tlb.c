@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+
+#include "arm.h"
+#include "arm_dpm.h"
+#include "arm_tlb.h"
+#include "target.h"
+
+void arm_tlb_init(struct arm_tlb *tlb)
+{
+	memset(tlb, 0, sizeof(*tlb));
+	tlb->enabled = true;
+}
+
+void arm_tlb_flush(struct arm_tlb *tlb)
+{
+	for (unsigned int i = 0; i < ARM_TLB_ENTRIES; i++)
+		tlb->entries[i].valid = false;
+	tlb->flushes++;
+}
+
+static struct arm_tlb_entry *arm_tlb_entry(struct arm_tlb *tlb, uint32_t context, uint64_t va_page)
+{
+	return &tlb->entries[(va_page ^ (context << 5)) % ARM_TLB_ENTRIES];
+}
+
+bool arm_tlb_lookup(struct arm_tlb *tlb, uint32_t context, uint64_t va, uint64_t *par)
+{
+	if (!tlb->enabled)
+		return false;
+
+	uint64_t va_page = va >> ARM_TLB_PAGE_SHIFT;
+	struct arm_tlb_entry *entry = arm_tlb_entry(tlb, context, va_page);
+
+	if (entry->valid && entry->context == context && entry->va_page == va_page) {
+		tlb->hits++;
+		*par = entry->par;
+		return true;
+	}
+
+	tlb->misses++;
+	return false;
+}
+
+void arm_tlb_insert(struct arm_tlb *tlb, uint32_t context, uint64_t va, uint64_t par)
+{
+	if (!tlb->enabled)
+		return;
+
+	uint64_t va_page = va >> ARM_TLB_PAGE_SHIFT;
+	struct arm_tlb_entry *entry = arm_tlb_entry(tlb, context, va_page);
+
+	entry->valid = true;
+	entry->context = context;
+	entry->va_page = va_page;
+	entry->par = par;
+}
+
+/**
+ * Flush the cache on a write to a CP15 register of the system control
+ * (SCTLR, SCR), translation table (TTBRx, TTBCR), domain, memory
+ * remapping or context ID groups. @a crn is CRm for a 64-bit MCRR.
+ */
+void arm_tlb_cp15_write(struct arm_tlb *tlb, int cpnum, uint32_t crn)
+{
+	if (cpnum != 15)
+		return;
+
+	switch (crn) {
+	case 1:
+	case 2:
+	case 3:
+	case 10:
+	case 13:
+		arm_tlb_flush(tlb);
+		break;
+	default:
+		break;
+	}
+}
+
+COMMAND_HANDLER(arm_tlb_handle_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct arm *arm = target_to_arm(target);
+
+	if (!is_arm(arm) || !arm->dpm) {
+		command_print(CMD, "current target isn't an ARM with a DPM");
+		return ERROR_TARGET_INVALID;
+	}
+
+	struct arm_tlb *tlb = &arm->dpm->tlb;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "flush")) {
+			arm_tlb_flush(tlb);
+			return ERROR_OK;
+		}
+		if (!strcmp(CMD_ARGV[0], "reset_stats")) {
+			tlb->hits = 0;
+			tlb->misses = 0;
+			tlb->flushes = 0;
+			return ERROR_OK;
+		}
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		if (!enable)
+			arm_tlb_flush(tlb);
+		tlb->enabled = enable;
+	}
+
+	command_print(CMD, "translation cache %s, %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " flushes",
+			tlb->enabled ? "enabled" : "disabled", tlb->hits, tlb->misses, tlb->flushes);
+
+	return ERROR_OK;
+}
+
+const struct command_registration arm_tlb_command_handlers[] = {
+	{
+		.name = "tlb",
+		.handler = arm_tlb_handle_command,
+		.mode = COMMAND_EXEC,
+		.help = "display or configure the cache of the virtual to "
+			"physical address translations",
+		.usage = "['enable'|'disable'|'flush'|'reset_stats']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
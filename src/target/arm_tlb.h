@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_TLB_H
+#define OPENOCD_TARGET_ARM_TLB_H
+
+#include <helper/command.h>
+
+/**
+ * @file
+ * Host side cache of the address translations done by a halted ARMv7-A or
+ * ARMv8 core. Each entry keeps the PAR value returned by the address
+ * translation operation for a 4 KiB page of a translation context (core
+ * mode or exception level), so that the attributes can be decoded again
+ * on a hit.
+ *
+ * The cache only holds while the core is halted: it must be flushed when
+ * the core resumes and when the debugger writes a register that changes
+ * the translation.
+ */
+
+#define ARM_TLB_ENTRIES		256
+#define ARM_TLB_PAGE_SHIFT	12
+
+struct arm_tlb_entry {
+	bool valid;
+	uint32_t context;
+	uint64_t va_page;
+	uint64_t par;
+};
+
+struct arm_tlb {
+	bool enabled;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t flushes;
+	struct arm_tlb_entry entries[ARM_TLB_ENTRIES];
+};
+
+void arm_tlb_init(struct arm_tlb *tlb);
+void arm_tlb_flush(struct arm_tlb *tlb);
+bool arm_tlb_lookup(struct arm_tlb *tlb, uint32_t context, uint64_t va, uint64_t *par);
+void arm_tlb_insert(struct arm_tlb *tlb, uint32_t context, uint64_t va, uint64_t par);
+void arm_tlb_cp15_write(struct arm_tlb *tlb, int cpnum, uint32_t crn);
+
+extern const struct command_registration arm_tlb_command_handlers[];
+
+#endif /* OPENOCD_TARGET_ARM_TLB_H */
@@ -30,12 +30,14 @@
 #include <helper/jim-nvp.h>
 #include <helper/list.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
 #include <target/arm_adi_v5.h>
 #include <target/target.h>
 #include <transport/transport.h>
+#include "arm_itm_decode.h"
 #include "arm_tpiu_swo.h"
 
 /* START_DEPRECATED_TPIU */
@@ -44,6 +46,7 @@
 /* END_DEPRECATED_TPIU */
 
 #define TCP_SERVICE_NAME                "tpiu_swo_trace"
+#define TCP_ITM_SERVICE_NAME            "tpiu_swo_itm"
 
 /* default for Cortex-M3 and Cortex-M4 specific TPIU */
 #define TPIU_SWO_DEFAULT_BASE           0xE0040000
@@ -86,6 +89,51 @@ struct arm_tpiu_swo_event_action {
 	struct arm_tpiu_swo_event_action *next;
 };
 
+#define ARM_TPIU_SWO_ITM_PORT_BUF_SIZE	4096
+#define ARM_TPIU_SWO_MAX_PC_SAMPLES		1000000
+
+#define ARM_TPIU_SWO_DEFAULT_BUFFER_SIZE	(1024 * 1024)
+#define ARM_TPIU_SWO_MIN_BUFFER_SIZE		4096
+/* bytes handed to each destination per poll, a slow one cannot delay the capture */
+#define ARM_TPIU_SWO_CONSUMER_CHUNK			(64 * 1024)
+
+/** Destinations reading the captured trace data from the ring */
+enum arm_tpiu_swo_consumer_id {
+	TPIU_SWO_CONSUMER_TCL,
+	TPIU_SWO_CONSUMER_FILE,
+	TPIU_SWO_CONSUMER_TCP,
+	TPIU_SWO_CONSUMER_ITM,
+	TPIU_SWO_CONSUMERS,
+};
+
+static const char * const arm_tpiu_swo_consumer_names[TPIU_SWO_CONSUMERS] = {
+	[TPIU_SWO_CONSUMER_TCL] = "tcl trace",
+	[TPIU_SWO_CONSUMER_FILE] = "file",
+	[TPIU_SWO_CONSUMER_TCP] = "tcp",
+	[TPIU_SWO_CONSUMER_ITM] = "itm decoder",
+};
+
+/** Position of one destination in the capture ring */
+struct arm_tpiu_swo_consumer {
+	bool active;
+	/** total of the bytes captured up to the next one to consume */
+	uint64_t read_pos;
+	/** bytes overwritten in the ring before being consumed */
+	uint64_t dropped;
+};
+
+/** Destination of the payload of one ITM stimulus port */
+struct arm_tpiu_swo_itm_port {
+	/** a filename or :port, same syntax as -output */
+	char *out_filename;
+	FILE *file;
+	/** track TCP connections */
+	struct list_head connections;
+	/** payload is accumulated here and written once per poll */
+	uint8_t buf[ARM_TPIU_SWO_ITM_PORT_BUF_SIZE];
+	size_t len;
+};
+
 struct arm_tpiu_swo_object {
 	struct list_head lh;
 	struct adiv5_mem_ap_spot spot;
@@ -112,6 +160,29 @@ struct arm_tpiu_swo_object {
 	char *out_filename;
 	/** track TCP connections */
 	struct list_head connections;
+	/** Decode ITM/DWT packets in the captured trace data */
+	bool en_itm_decode;
+	/** Formatter trace source ID of the ITM */
+	unsigned int itm_trace_id;
+	/** ITM decoder, allocated at the first enable with decoding on */
+	struct arm_itm_decoder *itm;
+	/** Per stimulus port output, NULL when the port is not routed */
+	struct arm_tpiu_swo_itm_port *itm_ports[ITM_STIMULUS_PORTS];
+	/** DWT PC samples collected by the ITM decoder */
+	uint32_t *pc_samples;
+	uint32_t num_pc_samples;
+	uint32_t max_pc_samples;
+	uint64_t dropped_pc_samples;
+	int64_t pc_samples_start_ms;
+	/** Size of the capture ring */
+	uint32_t buffer_size;
+	/** Trace data drained from the adapter, waiting for the destinations */
+	uint8_t *ring;
+	/** total of the bytes captured */
+	uint64_t write_pos;
+	struct arm_tpiu_swo_consumer consumers[TPIU_SWO_CONSUMERS];
+	uint64_t adapter_reads;
+	uint64_t max_backlog;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
@@ -123,39 +194,216 @@ struct arm_tpiu_swo_connection {
 };
 
 struct arm_tpiu_swo_priv_connection {
-	struct arm_tpiu_swo_object *obj;
+	struct list_head *connections;
 };
 
 static OOCD_LIST_HEAD(all_tpiu_swo);
 
-#define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
+static void arm_tpiu_swo_itm_port_flush(struct arm_tpiu_swo_itm_port *port)
+{
+	struct arm_tpiu_swo_connection *c;
 
-static int arm_tpiu_swo_poll_trace(void *priv)
+	if (!port->len)
+		return;
+
+	if (port->file) {
+		if (fwrite(port->buf, 1, port->len, port->file) == port->len)
+			fflush(port->file);
+		else
+			LOG_ERROR("Error writing to the ITM port destination file");
+	}
+
+	list_for_each_entry(c, &port->connections, lh)
+		if (connection_write(c->connection, port->buf, port->len) != (int)port->len)
+			LOG_ERROR("Error writing to connection");
+
+	port->len = 0;
+}
+
+static void arm_tpiu_swo_itm_stimulus(void *priv, unsigned int port_num, const uint8_t *data, unsigned int len)
 {
 	struct arm_tpiu_swo_object *obj = priv;
-	uint8_t buf[ARM_TPIU_SWO_TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
-	struct arm_tpiu_swo_connection *c;
+	struct arm_tpiu_swo_itm_port *port = obj->itm_ports[port_num];
 
-	int retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
-		return retval;
+	if (!port)
+		return;
 
-	target_call_trace_callbacks(/*target*/NULL, size, buf);
+	if (port->len + len > sizeof(port->buf))
+		arm_tpiu_swo_itm_port_flush(port);
+	memcpy(&port->buf[port->len], data, len);
+	port->len += len;
+}
 
-	if (obj->file) {
-		if (fwrite(buf, 1, size, obj->file) == size) {
-			fflush(obj->file);
-		} else {
-			LOG_ERROR("Error writing to the SWO trace destination file");
-			return ERROR_FAIL;
+static void arm_tpiu_swo_itm_pc_sample(void *priv, uint32_t pc, bool sleep)
+{
+	struct arm_tpiu_swo_object *obj = priv;
+
+	if (sleep)
+		return;
+
+	if (obj->num_pc_samples == obj->max_pc_samples) {
+		if (obj->max_pc_samples == ARM_TPIU_SWO_MAX_PC_SAMPLES) {
+			obj->dropped_pc_samples++;
+			return;
+		}
+		uint32_t max = obj->max_pc_samples ? 2 * obj->max_pc_samples : 4096;
+		if (max > ARM_TPIU_SWO_MAX_PC_SAMPLES)
+			max = ARM_TPIU_SWO_MAX_PC_SAMPLES;
+		uint32_t *samples = realloc(obj->pc_samples, max * sizeof(*samples));
+		if (!samples) {
+			obj->dropped_pc_samples++;
+			return;
 		}
+		obj->pc_samples = samples;
+		obj->max_pc_samples = max;
 	}
 
-	if (obj->out_filename[0] == ':')
+	if (!obj->num_pc_samples)
+		obj->pc_samples_start_ms = timeval_ms();
+	obj->pc_samples[obj->num_pc_samples++] = pc;
+}
+
+static const struct arm_itm_decode_ops arm_tpiu_swo_itm_ops = {
+	.stimulus = arm_tpiu_swo_itm_stimulus,
+	.pc_sample = arm_tpiu_swo_itm_pc_sample,
+};
+
+/* Drain the adapter into the ring, until it has no more trace data */
+static int arm_tpiu_swo_capture(struct arm_tpiu_swo_object *obj)
+{
+	uint64_t captured = 0;
+
+	/* at most one ring per poll, to let the rest of OpenOCD run */
+	while (captured < obj->buffer_size) {
+		uint32_t offset = obj->write_pos % obj->buffer_size;
+		size_t requested = obj->buffer_size - offset;
+		size_t size = requested;
+
+		int retval = adapter_poll_trace(&obj->ring[offset], &size);
+		if (retval != ERROR_OK)
+			return retval;
+		obj->adapter_reads++;
+		if (!size)
+			break;
+
+		obj->write_pos += size;
+		captured += size;
+
+		/* the destinations lagging more than the ring lose the oldest data */
+		for (unsigned int i = 0; i < TPIU_SWO_CONSUMERS; i++) {
+			struct arm_tpiu_swo_consumer *c = &obj->consumers[i];
+			if (!c->active)
+				continue;
+			if (obj->write_pos - c->read_pos > obj->buffer_size) {
+				c->dropped += obj->write_pos - c->read_pos - obj->buffer_size;
+				c->read_pos = obj->write_pos - obj->buffer_size;
+			}
+			if (obj->write_pos - c->read_pos > obj->max_backlog)
+				obj->max_backlog = obj->write_pos - c->read_pos;
+		}
+
+		if (size < requested)
+			break;
+	}
+
+	return ERROR_OK;
+}
+
+static int arm_tpiu_swo_deliver(struct arm_tpiu_swo_object *obj, enum arm_tpiu_swo_consumer_id id,
+		uint8_t *buf, size_t size)
+{
+	struct arm_tpiu_swo_connection *c;
+
+	switch (id) {
+	case TPIU_SWO_CONSUMER_TCL:
+		target_call_trace_callbacks(/*target*/NULL, size, buf);
+		break;
+	case TPIU_SWO_CONSUMER_FILE:
+		if (fwrite(buf, 1, size, obj->file) != size) {
+			LOG_ERROR("Error writing to the SWO trace destination file");
+			return ERROR_FAIL;
+		}
+		break;
+	case TPIU_SWO_CONSUMER_TCP:
 		list_for_each_entry(c, &obj->connections, lh)
 			if (connection_write(c->connection, buf, size) != (int)size)
 				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
+		break;
+	case TPIU_SWO_CONSUMER_ITM:
+		arm_itm_decode(obj->itm, buf, size);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+/* Hand the captured data to each destination, up to a chunk each unless @a all */
+static int arm_tpiu_swo_consume(struct arm_tpiu_swo_object *obj, bool all)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < TPIU_SWO_CONSUMERS; i++) {
+		struct arm_tpiu_swo_consumer *c = &obj->consumers[i];
+		uint64_t budget = all ? UINT64_MAX : ARM_TPIU_SWO_CONSUMER_CHUNK;
+
+		if (!c->active || c->read_pos == obj->write_pos)
+			continue;
+
+		while (c->read_pos < obj->write_pos && budget) {
+			uint32_t offset = c->read_pos % obj->buffer_size;
+			uint64_t size = MIN(obj->write_pos - c->read_pos, obj->buffer_size - offset);
+			size = MIN(size, budget);
+
+			int retval1 = arm_tpiu_swo_deliver(obj, i, &obj->ring[offset], size);
+			if (retval1 != ERROR_OK)
+				retval = retval1;
+			c->read_pos += size;
+			budget -= size;
+		}
+
+		/* keep the writes to the destination files batched */
+		if (i == TPIU_SWO_CONSUMER_FILE && c->read_pos == obj->write_pos)
+			fflush(obj->file);
+
+		if (i == TPIU_SWO_CONSUMER_ITM)
+			for (unsigned int j = 0; j < ITM_STIMULUS_PORTS; j++)
+				if (obj->itm_ports[j])
+					arm_tpiu_swo_itm_port_flush(obj->itm_ports[j]);
+	}
+
+	return retval;
+}
+
+static int arm_tpiu_swo_poll_trace(void *priv)
+{
+	struct arm_tpiu_swo_object *obj = priv;
+
+	int retval = arm_tpiu_swo_capture(obj);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return arm_tpiu_swo_consume(obj, false);
+}
+
+/* Set up the capture ring and the destinations reading from it */
+static int arm_tpiu_swo_ring_open(struct arm_tpiu_swo_object *obj)
+{
+	obj->ring = malloc(obj->buffer_size);
+	if (!obj->ring) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	obj->write_pos = 0;
+	obj->adapter_reads = 0;
+	obj->max_backlog = 0;
+	memset(obj->consumers, 0, sizeof(obj->consumers));
+	obj->consumers[TPIU_SWO_CONSUMER_TCL].active = true;
+	obj->consumers[TPIU_SWO_CONSUMER_FILE].active = obj->file;
+	obj->consumers[TPIU_SWO_CONSUMER_TCP].active = obj->out_filename[0] == ':';
+	obj->consumers[TPIU_SWO_CONSUMER_ITM].active = obj->en_itm_decode && obj->itm;
 
 	return ERROR_OK;
 }
@@ -198,12 +446,32 @@ static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_t
 
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
+	/* the destinations get what has been captured so far */
+	if (obj->ring) {
+		arm_tpiu_swo_consume(obj, true);
+		free(obj->ring);
+		obj->ring = NULL;
+	}
+
 	if (obj->file) {
 		fclose(obj->file);
 		obj->file = NULL;
 	}
 	if (obj->out_filename[0] == ':')
 		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
+
+	for (unsigned int i = 0; i < ITM_STIMULUS_PORTS; i++) {
+		struct arm_tpiu_swo_itm_port *port = obj->itm_ports[i];
+		if (!port)
+			continue;
+		if (port->file) {
+			fclose(port->file);
+			port->file = NULL;
+		}
+		if (port->out_filename[0] == ':')
+			remove_service(TCP_ITM_SERVICE_NAME, &port->out_filename[1]);
+		port->len = 0;
+	}
 }
 
 int arm_tpiu_swo_cleanup_all(void)
@@ -238,6 +506,13 @@ int arm_tpiu_swo_cleanup_all(void)
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
+		for (unsigned int i = 0; i < ITM_STIMULUS_PORTS; i++) {
+			if (obj->itm_ports[i])
+				free(obj->itm_ports[i]->out_filename);
+			free(obj->itm_ports[i]);
+		}
+		free(obj->itm);
+		free(obj->pc_samples);
 		free(obj->name);
 		free(obj->out_filename);
 		free(obj);
@@ -249,14 +524,13 @@ int arm_tpiu_swo_cleanup_all(void)
 static int arm_tpiu_swo_service_new_connection(struct connection *connection)
 {
 	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
-	struct arm_tpiu_swo_object *obj = priv->obj;
 	struct arm_tpiu_swo_connection *c = malloc(sizeof(*c));
 	if (!c) {
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
 	c->connection = connection;
-	list_add(&c->lh, &obj->connections);
+	list_add(&c->lh, priv->connections);
 	return ERROR_OK;
 }
 
@@ -279,10 +553,9 @@ static int arm_tpiu_swo_service_input(struct connection *connection)
 static int arm_tpiu_swo_service_connection_closed(struct connection *connection)
 {
 	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
-	struct arm_tpiu_swo_object *obj = priv->obj;
 	struct arm_tpiu_swo_connection *c, *tmp;
 
-	list_for_each_entry_safe(c, tmp, &obj->connections, lh)
+	list_for_each_entry_safe(c, tmp, priv->connections, lh)
 		if (c->connection == connection) {
 			list_del(&c->lh);
 			free(c);
@@ -318,6 +591,9 @@ enum arm_tpiu_swo_cfg_param {
 	CFG_BITRATE,
 	CFG_OUTFILE,
 	CFG_EVENT,
+	CFG_ITM_DECODE,
+	CFG_ITM_ID,
+	CFG_BUFFER_SIZE,
 };
 
 static const struct jim_nvp nvp_arm_tpiu_swo_config_opts[] = {
@@ -328,6 +604,9 @@ static const struct jim_nvp nvp_arm_tpiu_swo_config_opts[] = {
 	{ .name = "-pin-freq",      .value = CFG_BITRATE },
 	{ .name = "-output",        .value = CFG_OUTFILE },
 	{ .name = "-event",         .value = CFG_EVENT },
+	{ .name = "-itm-decode",    .value = CFG_ITM_DECODE },
+	{ .name = "-itm-id",        .value = CFG_ITM_ID },
+	{ .name = "-buffer-size",   .value = CFG_BUFFER_SIZE },
 	/* handled by mem_ap_spot, added for jim_getopt_nvp_unknown() */
 	{ .name = "-dap",           .value = -1 },
 	{ .name = "-ap-num",        .value = -1 },
@@ -544,6 +823,59 @@ static int arm_tpiu_swo_configure(struct jim_getopt_info *goi, struct arm_tpiu_s
 				}
 			}
 			break;
+		case CFG_ITM_DECODE:
+			if (goi->is_configure) {
+				struct jim_nvp *p;
+				e = jim_getopt_nvp(goi, nvp_arm_tpiu_swo_bool_opts, &p);
+				if (e != JIM_OK)
+					return e;
+				obj->en_itm_decode = p->value;
+			} else {
+				if (goi->argc)
+					goto err_no_params;
+				struct jim_nvp *p;
+				e = jim_nvp_value2name(goi->interp, nvp_arm_tpiu_swo_bool_opts, obj->en_itm_decode, &p);
+				if (e != JIM_OK) {
+					Jim_SetResultString(goi->interp, "itm-decode error", -1);
+					return JIM_ERR;
+				}
+				Jim_SetResult(goi->interp, Jim_NewStringObj(goi->interp, p->name, -1));
+			}
+			break;
+		case CFG_ITM_ID:
+			if (goi->is_configure) {
+				jim_wide id;
+				e = jim_getopt_wide(goi, &id);
+				if (e != JIM_OK)
+					return e;
+				if (id < 1 || id > 0x6f) {
+					Jim_SetResultString(goi->interp, "Invalid trace ID!", -1);
+					return JIM_ERR;
+				}
+				obj->itm_trace_id = id;
+			} else {
+				if (goi->argc)
+					goto err_no_params;
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, obj->itm_trace_id));
+			}
+			break;
+		case CFG_BUFFER_SIZE:
+			if (goi->is_configure) {
+				jim_wide size;
+				e = jim_getopt_wide(goi, &size);
+				if (e != JIM_OK)
+					return e;
+				if (size < ARM_TPIU_SWO_MIN_BUFFER_SIZE || size > UINT32_MAX) {
+					Jim_SetResultString(goi->interp, "Invalid buffer size!", -1);
+					return JIM_ERR;
+				}
+				obj->buffer_size = size;
+			} else {
+				if (goi->argc)
+					goto err_no_params;
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, obj->buffer_size));
+			}
+			break;
 		}
 	}
 
@@ -605,6 +937,62 @@ static const struct service_driver arm_tpiu_swo_service_driver = {
 	.keep_client_alive_handler = NULL,
 };
 
+static const struct service_driver arm_tpiu_swo_itm_service_driver = {
+	.name = TCP_ITM_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = arm_tpiu_swo_service_new_connection,
+	.input_handler = arm_tpiu_swo_service_input,
+	.connection_closed_handler = arm_tpiu_swo_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static int arm_tpiu_swo_itm_open(struct command_invocation *cmd, struct arm_tpiu_swo_object *obj)
+{
+	if (!obj->itm) {
+		obj->itm = malloc(sizeof(*obj->itm));
+		if (!obj->itm) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+	arm_itm_decode_init(obj->itm, &arm_tpiu_swo_itm_ops, obj);
+	obj->num_pc_samples = 0;
+	obj->dropped_pc_samples = 0;
+	obj->itm->trace_id = obj->itm_trace_id;
+	/* synchronous trace port output is always formatted */
+	obj->itm->deframe = obj->en_formatter || obj->pin_protocol == TPIU_SPPR_PROTOCOL_SYNC;
+
+	for (unsigned int i = 0; i < ITM_STIMULUS_PORTS; i++) {
+		struct arm_tpiu_swo_itm_port *port = obj->itm_ports[i];
+		if (!port)
+			continue;
+
+		if (port->out_filename[0] == ':') {
+			struct arm_tpiu_swo_priv_connection *priv = malloc(sizeof(*priv));
+			if (!priv) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			priv->connections = &port->connections;
+			LOG_INFO("starting ITM port %u server for %s on %s", i, obj->name, &port->out_filename[1]);
+			int retval = add_service(&arm_tpiu_swo_itm_service_driver, &port->out_filename[1],
+				CONNECTION_LIMIT_UNLIMITED, priv);
+			if (retval != ERROR_OK) {
+				command_print(cmd, "Can't configure ITM port %u TCP port %s", i, &port->out_filename[1]);
+				return retval;
+			}
+		} else {
+			port->file = fopen(port->out_filename, "ab");
+			if (!port->file) {
+				command_print(cmd, "Can't open ITM port %u destination file \"%s\"", i, port->out_filename);
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 {
 	struct arm_tpiu_swo_object *obj = CMD_DATA;
@@ -733,7 +1121,7 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 				LOG_ERROR("Out of memory");
 				return ERROR_FAIL;
 			}
-			priv->obj = obj;
+			priv->connections = &obj->connections;
 			LOG_INFO("starting trace server for %s on %s", obj->name, &obj->out_filename[1]);
 			retval = add_service(&arm_tpiu_swo_service_driver, &obj->out_filename[1],
 				CONNECTION_LIMIT_UNLIMITED, priv);
@@ -749,6 +1137,20 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 			}
 		}
 
+		if (obj->en_itm_decode) {
+			retval = arm_tpiu_swo_itm_open(CMD, obj);
+			if (retval != ERROR_OK) {
+				arm_tpiu_swo_close_output(obj);
+				return retval;
+			}
+		}
+
+		retval = arm_tpiu_swo_ring_open(obj);
+		if (retval != ERROR_OK) {
+			arm_tpiu_swo_close_output(obj);
+			return retval;
+		}
+
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
 			&swo_pin_freq, obj->traceclkin_freq, &prescaler);
 		if (retval != ERROR_OK) {
@@ -876,6 +1278,223 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_disable)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_arm_tpiu_swo_stats)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "captured %" PRIu64 " bytes in %" PRIu64 " adapter reads, buffer %" PRIu32
+			" bytes, %" PRIu64 " bytes pending at most",
+			obj->write_pos, obj->adapter_reads, obj->buffer_size, obj->max_backlog);
+
+	for (unsigned int i = 0; i < TPIU_SWO_CONSUMERS; i++) {
+		const struct arm_tpiu_swo_consumer *c = &obj->consumers[i];
+		if (c->active)
+			command_print(CMD, "%s: %" PRIu64 " bytes pending, %" PRIu64 " bytes dropped",
+					arm_tpiu_swo_consumer_names[i], obj->write_pos - c->read_pos, c->dropped);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_port)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	unsigned int port_num;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port_num);
+	if (port_num >= ITM_STIMULUS_PORTS) {
+		command_print(CMD, "Invalid ITM stimulus port %u", port_num);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct arm_tpiu_swo_itm_port *port = obj->itm_ports[port_num];
+
+	if (CMD_ARGC == 1) {
+		command_print(CMD, "%s", port ? port->out_filename : "none");
+		return ERROR_OK;
+	}
+
+	if (obj->enabled) {
+		command_print(CMD, "Cannot configure ITM port; %s is enabled!", obj->name);
+		return ERROR_FAIL;
+	}
+
+	if (!strcmp(CMD_ARGV[1], "none")) {
+		if (port) {
+			free(port->out_filename);
+			free(port);
+			obj->itm_ports[port_num] = NULL;
+		}
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGV[1][0] == ':') {
+		char *end;
+		long tcp_port = strtol(CMD_ARGV[1] + 1, &end, 0);
+		if (tcp_port <= 0 || tcp_port > UINT16_MAX || *end != '\0') {
+			command_print(CMD, "Invalid TCP port \'%s\'", CMD_ARGV[1] + 1);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	char *out_filename = strdup(CMD_ARGV[1]);
+	if (!out_filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (!port) {
+		port = calloc(1, sizeof(*port));
+		if (!port) {
+			LOG_ERROR("Out of memory");
+			free(out_filename);
+			return ERROR_FAIL;
+		}
+		INIT_LIST_HEAD(&port->connections);
+		obj->itm_ports[port_num] = port;
+	}
+	free(port->out_filename);
+	port->out_filename = out_filename;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_stats)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!obj->itm) {
+		command_print(CMD, "ITM decoding has not been enabled on %s", obj->name);
+		return ERROR_OK;
+	}
+
+	const struct arm_itm_decode_stats *stats = &obj->itm->stats;
+
+	command_print(CMD, "bytes %" PRIu64 " frames %" PRIu64 " syncs %" PRIu64
+			" overflows %" PRIu64 " timestamps %" PRIu64 " errors %" PRIu64,
+			stats->bytes, stats->frames, stats->syncs,
+			stats->overflows, stats->timestamps, stats->errors);
+
+	for (unsigned int i = 0; i < ITM_STIMULUS_PORTS; i++)
+		if (stats->stimulus_packets[i])
+			command_print(CMD, "stimulus port %2u: %" PRIu64 " packets, %" PRIu64 " bytes",
+					i, stats->stimulus_packets[i], stats->stimulus_bytes[i]);
+
+	command_print(CMD, "PC samples %" PRIu64 " (sleeping %" PRIu64 ", stored %" PRIu32
+			", dropped %" PRIu64 ")", stats->pc_samples, stats->pc_sleep_samples,
+			obj->num_pc_samples, obj->dropped_pc_samples);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(stats->event_counters); i++)
+		if (stats->event_counters[i])
+			command_print(CMD, "event counter %s: %" PRIu64 " wraps",
+					arm_itm_event_counter_name(i), stats->event_counters[i]);
+
+	if (stats->data_trace_packets)
+		command_print(CMD, "data trace packets %" PRIu64, stats->data_trace_packets);
+
+	for (unsigned int i = 0; i < ITM_EXCEPTION_NUMBERS; i++) {
+		const uint32_t *exc = stats->exceptions[i];
+		if (exc[ITM_EXC_ENTER] || exc[ITM_EXC_EXIT] || exc[ITM_EXC_RETURN])
+			command_print(CMD, "exception %3u: enter %" PRIu32 " exit %" PRIu32 " return %" PRIu32,
+					i, exc[ITM_EXC_ENTER], exc[ITM_EXC_EXIT], exc[ITM_EXC_RETURN]);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_gmon)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 1 && CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t start_address = 0;
+	uint32_t end_address = 0;
+	bool with_range = false;
+	if (CMD_ARGC == 3) {
+		with_range = true;
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], start_address);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], end_address);
+		if (start_address > end_address || (end_address - start_address) < 2) {
+			command_print(CMD, "Error: end - start < 2");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	if (!obj->num_pc_samples) {
+		command_print(CMD, "No PC samples collected on %s", obj->name);
+		return ERROR_FAIL;
+	}
+
+	uint32_t duration_ms = timeval_ms() - obj->pc_samples_start_ms;
+	if (!duration_ms)
+		duration_ms = 1;
+
+	write_gmon(obj->pc_samples, obj->num_pc_samples, CMD_ARGV[0],
+		with_range, start_address, end_address, target, duration_ms);
+	command_print(CMD, "Wrote %s", CMD_ARGV[0]);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_reset)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (obj->itm)
+		memset(&obj->itm->stats, 0, sizeof(obj->itm->stats));
+	obj->num_pc_samples = 0;
+	obj->dropped_pc_samples = 0;
+
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_tpiu_swo_itm_command_handlers[] = {
+	{
+		.name = "port",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_port,
+		.help = "route the payload of an ITM stimulus port to a file or TCP port",
+		.usage = "port_num [(filename|:port|none)]",
+	},
+	{
+		.name = "stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_itm_stats,
+		.help = "display the ITM/DWT packet counters",
+		.usage = "",
+	},
+	{
+		.name = "gmon",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_itm_gmon,
+		.help = "write the DWT PC samples to a gmon.out file",
+		.usage = "filename [start end]",
+	},
+	{
+		.name = "reset",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_itm_reset,
+		.help = "clear the ITM/DWT packet counters and PC samples",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration arm_tpiu_swo_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -912,6 +1531,20 @@ static const struct command_registration arm_tpiu_swo_instance_command_handlers[
 		.usage = "",
 		.help = "Disables the TPIU/SWO output",
 	},
+	{
+		.name = "stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_arm_tpiu_swo_stats,
+		.usage = "",
+		.help = "Displays the counters of the trace data capture",
+	},
+	{
+		.name = "itm",
+		.mode = COMMAND_ANY,
+		.help = "ITM/DWT packet decoder commands",
+		.usage = "",
+		.chain = arm_tpiu_swo_itm_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -939,6 +1572,8 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_create)
 	adiv5_mem_ap_spot_init(&obj->spot);
 	obj->spot.base = TPIU_SWO_DEFAULT_BASE;
 	obj->port_width = 1;
+	obj->itm_trace_id = 1;
+	obj->buffer_size = ARM_TPIU_SWO_DEFAULT_BUFFER_SIZE;
 	obj->out_filename = strdup("external");
 	if (!obj->out_filename) {
 		LOG_ERROR("Out of memory");
@@ -19,20 +19,18 @@
 #include "armv7a.h"
 #include "armv7a_mmu.h"
 #include "arm_opcodes.h"
+#include "arm_tlb.h"
 #include "cortex_a.h"
 
 #define SCTLR_BIT_AFE (1 << 29)
 
-/*  V7 method VA TO PA  */
-int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
-	target_addr_t *val, int meminfo)
+/* Translate a VA with the CP15 VA to PA operation, return PAR */
+static int armv7a_mmu_read_par(struct target *target, uint32_t va, uint32_t *par)
 {
-	int retval = ERROR_FAIL;
 	struct armv7a_common *armv7a = target_to_armv7a(target);
 	struct arm_dpm *dpm = armv7a->arm.dpm;
-	uint32_t virt = va & ~0xfff, value;
-	uint32_t NOS, NS, INNER, OUTER, SS;
-	*val = 0xdeadbeef;
+	int retval;
+
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
 		goto done;
@@ -40,14 +38,41 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 	 *  use VA to PA CP15 register for conversion */
 	retval = dpm->instr_write_data_r0(dpm,
 			ARMV4_5_MCR(15, 0, 0, 7, 8, 0),
-			virt);
+			va & ~0xfff);
 	if (retval != ERROR_OK)
 		goto done;
 	retval = dpm->instr_read_data_r0(dpm,
 			ARMV4_5_MRC(15, 0, 0, 7, 4, 0),
-			&value);
-	if (retval != ERROR_OK)
-		goto done;
+			par);
+
+done:
+	dpm->finish(dpm);
+
+	return retval;
+}
+
+/*  V7 method VA TO PA  */
+int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
+	target_addr_t *val, int meminfo)
+{
+	int retval;
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct arm_tlb *tlb = &armv7a->arm.dpm->tlb;
+	uint32_t value;
+	uint64_t par;
+	uint32_t NOS, NS, INNER, OUTER, SS;
+	*val = 0xdeadbeef;
+
+	if (arm_tlb_lookup(tlb, armv7a->arm.core_mode, va, &par)) {
+		value = par;
+	} else {
+		retval = armv7a_mmu_read_par(target, va, &value);
+		if (retval != ERROR_OK)
+			return retval;
+		/* bit 0 set: translation aborted, don't cache it */
+		if (!(value & 1))
+			arm_tlb_insert(tlb, armv7a->arm.core_mode, va, value);
+	}
 
 	/* decode memory attribute */
 	SS = (value >> 1) & 1;
@@ -110,10 +135,7 @@ int armv7a_mmu_translate_va_pa(struct target *target, uint32_t va,
 		}
 	}
 
-done:
-	dpm->finish(dpm);
-
-	return retval;
+	return ERROR_OK;
 }
 
 static const char *desc_bits_to_string(bool c_bit, bool b_bit, bool s_bit, bool ap2, int ap10, bool afe)
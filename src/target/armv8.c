@@ -1134,30 +1134,15 @@ static void armv8_decode_memory_attr(int attr)
 	}
 }
 
-/*  V8 method VA TO PA  */
-int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
-	target_addr_t *val, int meminfo)
+/* Translate a VA with the AT operation of the current exception level, return PAR */
+static int armv8_mmu_read_par(struct target *target, target_addr_t va, uint64_t *par)
 {
 	struct armv8_common *armv8 = target_to_armv8(target);
 	struct arm *arm = target_to_arm(target);
 	struct arm_dpm *dpm = &armv8->dpm;
 	enum arm_mode target_mode = ARM_MODE_ANY;
-	uint32_t retval;
+	int retval;
 	uint32_t instr = 0;
-	uint64_t par;
-
-	static const char * const shared_name[] = {
-			"Non-", "UNDEFINED ", "Outer ", "Inner "
-	};
-
-	static const char * const secure_name[] = {
-			"Secure", "Not Secure"
-	};
-
-	if (target->state != TARGET_HALTED) {
-		LOG_TARGET_ERROR(target, "not halted");
-		return ERROR_TARGET_NOT_HALTED;
-	}
 
 	retval = dpm->prepare(dpm);
 	if (retval != ERROR_OK)
@@ -1192,7 +1177,7 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 	retval = dpm->instr_write_data_r0_64(dpm, instr, (uint64_t)va);
 	/* read result from PAR_EL1 */
 	if (retval == ERROR_OK)
-		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_PAR_EL1, 0), &par);
+		retval = dpm->instr_read_data_r0_64(dpm, ARMV8_MRS(SYSTEM_PAR_EL1, 0), par);
 
 	/* switch back to saved PE mode */
 	if (target_mode != ARM_MODE_ANY)
@@ -1200,6 +1185,50 @@ int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
 
 	dpm->finish(dpm);
 
+	return retval;
+}
+
+/* Translate a VA through the translation cache, return PAR, with bit 0 set on a fault */
+int armv8_mmu_translate_va_par(struct target *target, target_addr_t va, uint64_t *par)
+{
+	struct armv8_common *armv8 = target_to_armv8(target);
+	struct arm *arm = target_to_arm(target);
+	struct arm_tlb *tlb = &armv8->dpm.tlb;
+	uint32_t context = armv8_curel_from_core_mode(arm->core_mode);
+
+	if (target->state != TARGET_HALTED) {
+		LOG_TARGET_ERROR(target, "not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if (arm_tlb_lookup(tlb, context, va, par))
+		return ERROR_OK;
+
+	int retval = armv8_mmu_read_par(target, va, par);
+	if (retval != ERROR_OK)
+		return retval;
+	/* failed translations are not cached */
+	if (!(*par & 1))
+		arm_tlb_insert(tlb, context, va, *par);
+	return ERROR_OK;
+}
+
+/*  V8 method VA TO PA  */
+int armv8_mmu_translate_va_pa(struct target *target, target_addr_t va,
+	target_addr_t *val, int meminfo)
+{
+	int retval;
+	uint64_t par;
+
+	static const char * const shared_name[] = {
+			"Non-", "UNDEFINED ", "Outer ", "Inner "
+	};
+
+	static const char * const secure_name[] = {
+			"Secure", "Not Secure"
+	};
+
+	retval = armv8_mmu_translate_va_par(target, va, &par);
 	if (retval != ERROR_OK)
 		return retval;
 
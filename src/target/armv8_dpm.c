@@ -525,6 +525,8 @@ static int dpmv8_mcr(struct target *target, int cpnum,
 			ARMV4_5_MCR(cpnum, op1, 0, crn, crm, op2),
 			value);
 
+	arm_tlb_cp15_write(&dpm->tlb, cpnum, crn);
+
 	dpm->finish(dpm);
 	return retval;
 }
@@ -729,6 +731,98 @@ static int dpmv8_write_reg(struct arm_dpm *dpm, struct reg *r, unsigned int regn
 	return retval;
 }
 
+/*
+ * Pipelined transfers of the AArch64 general purpose registers. The ITR
+ * writes and DTR accesses of all the registers are queued at once, without
+ * polling DSCR.ITE or the DTR full flags in between: each instruction is
+ * executed by the core long before the next DAP access reaches it. The
+ * DSCR is read once at the end of the transaction, a sticky ITR overrun,
+ * DTR underrun/overrun or error flag reveals a lost step; the registers
+ * are then left to the polled path, reading or writing them is idempotent.
+ */
+#define DSCR_PIPELINE_ERRORS	(DSCR_ERR | DSCR_TXU | DSCR_RTO | DSCR_ITO)
+
+/* Run the queued transfers, @a done tells whether they all succeeded */
+static int dpmv8_pipeline_run(struct arm_dpm *dpm, bool *done)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint32_t dscr;
+	int retval;
+
+	*done = false;
+
+	retval = mem_ap_read_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DSCR, &dscr);
+	if (retval == ERROR_OK)
+		retval = dap_run(armv8->debug_ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (dscr & DSCR_PIPELINE_ERRORS) {
+		LOG_DEBUG("pipelined register transfer failed, dscr 0x%08" PRIx32, dscr);
+		retval = mem_ap_write_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DRCR, DRCR_CSE);
+		dscr &= ~DSCR_PIPELINE_ERRORS;
+	} else {
+		*done = true;
+	}
+	dpm->dscr = dscr;
+
+	return retval;
+}
+
+static int dpmv8_read_gp_regs_pipelined(struct arm_dpm *dpm)
+{
+	struct arm *arm = dpm->arm;
+	struct armv8_common *armv8 = arm->arch_info;
+	uint32_t lo[ARMV8_R30 + 1], hi[ARMV8_R30 + 1];
+	unsigned int regs[ARMV8_R30 + 1];
+	unsigned int n = 0;
+	bool done;
+	int retval = ERROR_OK;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return ERROR_OK;
+
+	for (unsigned int i = ARMV8_R0; i <= ARMV8_R30; i++) {
+		struct reg *r = armv8_reg_current(arm, i);
+		if (r->exist && !r->valid)
+			regs[n++] = i;
+	}
+	if (n < 2)
+		return ERROR_OK;
+
+	for (unsigned int k = 0; k < n && retval == ERROR_OK; k++) {
+		/* MSR DBGDTR_EL0, Xn then read DTRTX (low) and DTRRX (high) */
+		retval = mem_ap_write_u32(armv8->debug_ap, armv8->debug_base + CPUV8_DBG_ITR,
+				ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, regs[k]));
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DTRTX, &lo[k]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DTRRX, &hi[k]);
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = dpmv8_pipeline_run(dpm, &done);
+	if (retval != ERROR_OK || !done)
+		return retval;
+
+	for (unsigned int k = 0; k < n; k++) {
+		struct reg *r = armv8_reg_current(arm, regs[k]);
+		uint64_t value_64 = ((uint64_t)hi[k] << 32) | lo[k];
+
+		buf_set_u64(r->value, 0, 64, value_64);
+		r->valid = true;
+		r->dirty = false;
+		LOG_DEBUG("READ: %s, %16.8llx", r->name, (unsigned long long)value_64);
+	}
+
+	return ERROR_OK;
+}
+
 /**
  * Read basic registers of the current context:  R0 to R15, and CPSR in AArch32
  * state or R0 to R31, PC and CPSR in AArch64 state;
@@ -752,6 +846,11 @@ int armv8_dpm_read_current_registers(struct arm_dpm *dpm)
 
 	cache = arm->core_cache;
 
+	/* the general purpose registers in a single transaction, if possible */
+	retval = dpmv8_read_gp_regs_pipelined(dpm);
+	if (retval != ERROR_OK)
+		goto fail;
+
 	/* read R0 first (it's used for scratch), then CPSR */
 	r = cache->reg_list + ARMV8_R0;
 	if (!r->valid) {
@@ -819,6 +918,59 @@ fail:
 	return retval;
 }
 
+static int dpmv8_write_gp_regs_pipelined(struct arm_dpm *dpm)
+{
+	struct arm *arm = dpm->arm;
+	struct armv8_common *armv8 = arm->arch_info;
+	unsigned int regs[ARMV8_R30 + 1];
+	unsigned int n = 0;
+	bool done;
+	int retval = ERROR_OK;
+
+	if (armv8_dpm_get_core_state(dpm) != ARM_STATE_AARCH64)
+		return ERROR_OK;
+
+	/* R0 is the scratch register, it is written last by the polled path */
+	for (unsigned int i = ARMV8_R1; i <= ARMV8_R30; i++) {
+		struct reg *r = armv8_reg_current(arm, i);
+		if (r->exist && r->valid && r->dirty)
+			regs[n++] = i;
+	}
+	if (n < 2)
+		return ERROR_OK;
+
+	for (unsigned int k = 0; k < n && retval == ERROR_OK; k++) {
+		struct reg *r = armv8_reg_current(arm, regs[k]);
+		uint64_t value_64 = buf_get_u64(r->value, 0, 64);
+
+		/* write DTRRX (low) and DTRTX (high) then MRS Xn, DBGDTR_EL0 */
+		retval = mem_ap_write_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRRX, value_64);
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DTRTX, value_64 >> 32);
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv8->debug_ap, armv8->debug_base + CPUV8_DBG_ITR,
+					ARMV8_MRS(SYSTEM_DBG_DBGDTR_EL0, regs[k]));
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = dpmv8_pipeline_run(dpm, &done);
+	if (retval != ERROR_OK || !done)
+		return retval;
+
+	for (unsigned int k = 0; k < n; k++) {
+		struct reg *r = armv8_reg_current(arm, regs[k]);
+
+		r->dirty = false;
+		LOG_DEBUG("WRITE: %s, %16.8llx", r->name,
+			(unsigned long long)buf_get_u64(r->value, 0, 64));
+	}
+
+	return ERROR_OK;
+}
+
 /* Avoid needless I/O ... leave breakpoints and watchpoints alone
  * unless they're removed, or need updating because of single-stepping
  * or running debugger code.
@@ -924,6 +1076,11 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	if (retval != ERROR_OK)
 		goto done;
 
+	/* the general purpose registers in a single transaction, if possible */
+	retval = dpmv8_write_gp_regs_pipelined(dpm);
+	if (retval != ERROR_OK)
+		goto done;
+
 	/* check everything except our scratch register R0 */
 	for (unsigned int i = 1; i < cache->num_regs; i++) {
 		struct arm_reg *r;
@@ -1410,6 +1567,7 @@ int armv8_dpm_setup(struct arm_dpm *dpm)
 	struct target *target = arm->target;
 	struct reg_cache *cache;
 	arm->dpm = dpm;
+	arm_tlb_init(&dpm->tlb);
 
 	/* register access setup */
 	arm->full_context = armv8_dpm_full_context;
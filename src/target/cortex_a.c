@@ -828,6 +828,9 @@ static int cortex_a_internal_restore(struct target *target, bool current,
 	if (!debug_execution)
 		target_free_all_working_areas(target);
 
+	/* the core may change its translation tables once running */
+	arm_tlb_flush(&arm->dpm->tlb);
+
 #if 0
 	if (debug_execution) {
 		/* Disable interrupts */
@@ -1030,6 +1033,9 @@ static int cortex_a_debug_entry(struct target *target)
 
 	LOG_DEBUG("dscr = 0x%08" PRIx32, cortex_a->cpudbg_dscr);
 
+	/* the core may have halted without our resume, e.g. after a reset */
+	arm_tlb_flush(&armv7a->dpm.tlb);
+
 	/* REVISIT surely we should not re-read DSCR !! */
 	retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
 			armv7a->debug_base + CPUDBG_DSCR, &dscr);
@@ -1962,9 +1968,10 @@ static int cortex_a_assert_reset(struct target *target)
 		return ERROR_FAIL;
 	}
 
-	/* registers are now invalid */
+	/* registers and cached translations are now invalid */
 	if (armv7a->arm.core_cache)
 		register_cache_invalidate(armv7a->arm.core_cache);
+	arm_tlb_flush(&armv7a->dpm.tlb);
 
 	target->state = TARGET_RESET;
 
@@ -1981,6 +1988,9 @@ static int cortex_a_deassert_reset(struct target *target)
 	/* be certain SRST is off */
 	adapter_deassert_reset();
 
+	/* the core may have run and remapped before the halt */
+	arm_tlb_flush(&armv7a->dpm.tlb);
+
 	if (target_was_examined(target)) {
 		retval = cortex_a_poll(target);
 		if (retval != ERROR_OK)
@@ -3404,6 +3414,9 @@ static const struct command_registration cortex_a_exec_command_handlers[] = {
 	{
 		.chain = smp_command_handlers,
 	},
+	{
+		.chain = arm_tlb_command_handlers,
+	},
 
 	COMMAND_REGISTRATION_DONE
 };
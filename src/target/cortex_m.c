@@ -445,12 +445,29 @@ static int cortex_m_store_core_reg_u32(struct target *target,
 	return retval;
 }
 
+/* Drop the DHCSR values prefetched for the target and, as a reset hits
+ * all of them, for the other cores of its SMP group */
+static void cortex_m_smp_prefetch_invalidate(struct target *target)
+{
+	if (!target->smp) {
+		target_to_cm(target)->dcb_dhcsr_prefetch_valid = false;
+		return;
+	}
+
+	struct target_list *head;
+	foreach_smp_target(head, target->smp_targets)
+		target_to_cm(head->target)->dcb_dhcsr_prefetch_valid = false;
+}
+
 static int cortex_m_write_debug_halt_mask(struct target *target,
 	uint32_t mask_on, uint32_t mask_off)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 
+	/* the state is about to change, a prefetched value is outdated */
+	cortex_m->dcb_dhcsr_prefetch_valid = false;
+
 	/* mask off status bits */
 	cortex_m->dcb_dhcsr &= ~((0xFFFFul << 16) | mask_off);
 	/* create new register mask */
@@ -955,10 +972,16 @@ static int cortex_m_poll_one(struct target *target)
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 
 	/* Read from Debug Halting Control and Status Register */
-	retval = cortex_m_read_dhcsr_atomic_sticky(target);
-	if (retval != ERROR_OK) {
-		target->state = TARGET_UNKNOWN;
-		return retval;
+	if (cortex_m->dcb_dhcsr_prefetch_valid) {
+		/* already read along with the other cores of the SMP group */
+		cortex_m->dcb_dhcsr_prefetch_valid = false;
+		cortex_m->dcb_dhcsr = cortex_m->dcb_dhcsr_prefetch;
+	} else {
+		retval = cortex_m_read_dhcsr_atomic_sticky(target);
+		if (retval != ERROR_OK) {
+			target->state = TARGET_UNKNOWN;
+			return retval;
+		}
 	}
 
 	/* Recover from lockup.  See ARMv7-M architecture spec,
@@ -1180,18 +1203,74 @@ static int cortex_m_poll_smp(struct list_head *smp_targets)
 	return retval;
 }
 
+/* Queue the DHCSR read of every core in the SMP group and run them with a
+ * single dap_run() per DAP. Each value is kept in the cortex_m_common of
+ * its core, and used by the next poll of that core instead of an atomic
+ * read, whatever the order in which the cores are polled.
+ */
+static void cortex_m_smp_prefetch_dhcsr(struct list_head *smp_targets)
+{
+	struct target_list *head;
+
+	foreach_smp_target(head, smp_targets) {
+		struct target *curr = head->target;
+		struct cortex_m_common *cortex_m = target_to_cm(curr);
+
+		cortex_m->dcb_dhcsr_prefetch_valid = false;
+		cortex_m->dcb_dhcsr_prefetch_queued = false;
+		if (!target_was_examined(curr))
+			continue;
+
+		int retval = mem_ap_read_u32(cortex_m->armv7m.debug_ap, DCB_DHCSR,
+				&cortex_m->dcb_dhcsr_prefetch);
+		cortex_m->dcb_dhcsr_prefetch_queued = (retval == ERROR_OK);
+	}
+
+	foreach_smp_target(head, smp_targets) {
+		struct cortex_m_common *cortex_m = target_to_cm(head->target);
+		if (!cortex_m->dcb_dhcsr_prefetch_queued)
+			continue;
+
+		struct adiv5_dap *dap = cortex_m->armv7m.debug_ap->dap;
+		int retval = dap_run(dap);
+
+		/* the run completed the reads of all the cores on this DAP */
+		struct target_list *other;
+		foreach_smp_target(other, smp_targets) {
+			struct cortex_m_common *other_cm = target_to_cm(other->target);
+			if (!other_cm->dcb_dhcsr_prefetch_queued ||
+					other_cm->armv7m.debug_ap->dap != dap)
+				continue;
+
+			other_cm->dcb_dhcsr_prefetch_queued = false;
+			if (retval != ERROR_OK)
+				continue;
+
+			/* the read cleared the sticky bits, keep them now */
+			cortex_m_cumulate_dhcsr_sticky(other_cm, other_cm->dcb_dhcsr_prefetch);
+			other_cm->dcb_dhcsr_prefetch_valid = true;
+		}
+	}
+}
+
 static int cortex_m_poll(struct target *target)
 {
+	/* The first core polled in a round finds its value used, and reads
+	 * the group again. A value not used meanwhile is replaced. */
+	if (target->smp && !target_to_cm(target)->dcb_dhcsr_prefetch_valid)
+		cortex_m_smp_prefetch_dhcsr(target->smp_targets);
+
 	int retval = cortex_m_poll_one(target);
 
 	if (target->smp) {
 		struct target_list *last;
 		last = list_last_entry(target->smp_targets, struct target_list, lh);
-		if (target == last->target)
+		if (target == last->target) {
 			/* After the last target in SMP group has been polled
 			 * check for postponed halted events and eventually halt and re-poll
 			 * other targets */
 			cortex_m_poll_smp(target->smp_targets);
+		}
 	}
 	return retval;
 }
@@ -1694,6 +1773,8 @@ static int cortex_m_assert_reset(struct target *target)
 
 	enum reset_types jtag_reset_config = jtag_get_reset_config();
 
+	cortex_m_smp_prefetch_invalidate(target);
+
 	if (target_has_event_action(target, TARGET_EVENT_RESET_ASSERT)) {
 		/* allow scripts to override the reset event */
 
@@ -1853,6 +1934,8 @@ static int cortex_m_deassert_reset(struct target *target)
 
 	enum reset_types jtag_reset_config = jtag_get_reset_config();
 
+	cortex_m_smp_prefetch_invalidate(target);
+
 	/* deassert reset lines */
 	if (jtag_reset_config & RESET_HAS_SRST)
 		adapter_deassert_reset();
@@ -2856,6 +2939,7 @@ int cortex_m_examine(struct target *target)
 			/* Enable debug requests */
 			uint32_t dhcsr = (cortex_m->dcb_dhcsr | C_DEBUGEN) & ~(C_HALT | C_STEP | C_MASKINTS);
 
+			cortex_m->dcb_dhcsr_prefetch_valid = false;
 			retval = target_write_u32(target, DCB_DHCSR, DBGKEY | (dhcsr & 0x0000FFFFUL));
 			if (retval != ERROR_OK)
 				return retval;
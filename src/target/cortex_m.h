@@ -233,6 +233,11 @@ struct cortex_m_common {
 	uint32_t dcb_dhcsr_cumulated_sticky;
 	/* DCB DHCSR has been at least once read, so the sticky bits have been reset */
 	bool dcb_dhcsr_sticky_is_recent;
+	/* DCB DHCSR read along with the other cores of the SMP group, for the
+	 * next poll of this core */
+	uint32_t dcb_dhcsr_prefetch;
+	bool dcb_dhcsr_prefetch_queued;
+	bool dcb_dhcsr_prefetch_valid;
 	uint32_t nvic_dfsr;  /* Debug Fault Status Register - shows reason for debug halt */
 	uint32_t nvic_icsr;  /* Interrupt Control State Register - shows active and pending IRQ */
 
@@ -309,7 +309,9 @@ static int esp32_target_init(struct command_context *cmd_ctx, struct target *tar
 static const struct xtensa_debug_ops esp32_dbg_ops = {
 	.queue_enable = xtensa_dm_queue_enable,
 	.queue_reg_read = xtensa_dm_queue_reg_read,
-	.queue_reg_write = xtensa_dm_queue_reg_write
+	.queue_reg_write = xtensa_dm_queue_reg_write,
+	.queue_reg_read_block = xtensa_dm_queue_reg_read_block,
+	.queue_reg_write_block = xtensa_dm_queue_reg_write_block
 };
 
 static const struct xtensa_power_ops esp32_pwr_ops = {
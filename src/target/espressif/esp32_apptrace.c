@@ -47,6 +47,10 @@
 
 #define ESP32_APPTRACE_TGT_STATE_TMO            5000
 #define ESP_APPTRACE_BLOCKS_POOL_SZ             10
+#define ESP_APPTRACE_BLOCKS_POOL_MAX            64
+/* backlog of a destination above which the data of the next blocks are dropped */
+#define ESP32_APPTRACE_DEST_BACKLOG_MAX         (1024 * 1024)
+#define ESP32_APPTRACE_DEST_FLUSH_TMO           5000
 
 struct esp32_apptrace_dest_file_data {
 	int fout;
@@ -69,12 +73,29 @@ struct esp_apptrace_target2host_hdr {
 #define APPTRACE_BLOCK_SIZE_OFFSET      0
 #define APPTRACE_WR_SIZE_OFFSET         2
 
+/* Blocks are reference counted: the reference taken when a block is got from the pool
+ * is dropped once it has been processed, the destinations take one for each piece of
+ * it left in their backlog. The block returns to the free list with the last one. */
 struct esp32_apptrace_block {
 	struct list_head node;
+	struct list_head *pool;
+	unsigned int refcnt;
 	uint8_t *data;
 	uint32_t data_len;
 };
 
+/* Piece of data waiting in the backlog of a destination, either referencing a pool
+ * block or copied in buf */
+struct esp32_apptrace_dest_chunk {
+	struct list_head node;
+	struct esp32_apptrace_block *block;
+	const uint8_t *data;
+	uint32_t len;
+	/* the destination already took its beginning, it can not be dropped */
+	bool partial;
+	uint8_t buf[];
+};
+
 static int esp32_apptrace_data_processor(void *priv);
 static int esp32_apptrace_get_data_info(struct esp32_apptrace_cmd_ctx *ctx,
 	struct esp32_apptrace_target_state *target_state,
@@ -84,6 +105,7 @@ static int esp32_apptrace_safe_halt_targets(struct esp32_apptrace_cmd_ctx *ctx,
 static struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx);
 static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
 	struct esp32_apptrace_block *block);
+static void esp32_apptrace_block_put(struct esp32_apptrace_block *block);
 static int esp32_sysview_start(struct esp32_apptrace_cmd_ctx *ctx);
 static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx);
 
@@ -93,7 +115,7 @@ static const bool s_time_stats_enable = true;
 *                       Trace destination API
 **********************************************************************/
 
-static int esp32_apptrace_file_dest_write(void *priv, uint8_t *data, int size)
+static int esp32_apptrace_file_dest_write(void *priv, const uint8_t *data, int size)
 {
 	struct esp32_apptrace_dest_file_data *dest_data = (struct esp32_apptrace_dest_file_data *)priv;
 
@@ -102,7 +124,7 @@ static int esp32_apptrace_file_dest_write(void *priv, uint8_t *data, int size)
 		LOG_ERROR("Failed to write %d bytes to out file (%d)! Written %d.", size, errno, wr_sz);
 		return ERROR_FAIL;
 	}
-	return ERROR_OK;
+	return size;
 }
 
 static int esp32_apptrace_file_dest_cleanup(void *priv)
@@ -139,10 +161,10 @@ static int esp32_apptrace_file_dest_init(struct esp32_apptrace_dest *dest, const
 	return ERROR_OK;
 }
 
-static int esp32_apptrace_console_dest_write(void *priv, uint8_t *data, int size)
+static int esp32_apptrace_console_dest_write(void *priv, const uint8_t *data, int size)
 {
 	LOG_USER_N("%.*s", size, data);
-	return ERROR_OK;
+	return size;
 }
 
 static int esp32_apptrace_console_dest_cleanup(void *priv)
@@ -160,15 +182,22 @@ static int esp32_apptrace_console_dest_init(struct esp32_apptrace_dest *dest, co
 	return ERROR_OK;
 }
 
-static int esp32_apptrace_tcp_dest_write(void *priv, uint8_t *data, int size)
+static int esp32_apptrace_tcp_dest_write(void *priv, const uint8_t *data, int size)
 {
 	struct esp32_apptrace_dest_tcp_data *dest_data = (struct esp32_apptrace_dest_tcp_data *)priv;
+	/* the socket is non-blocking, what it does not take goes to the backlog */
 	int wr_sz = write_socket(dest_data->sockfd, data, size);
-	if (wr_sz != size) {
-		LOG_ERROR("Failed to write %u bytes to out socket (%d)! Written %d.", size, errno, wr_sz);
+	if (wr_sz < 0) {
+#ifdef _WIN32
+		if (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+#endif
+			return 0;
+		LOG_ERROR("Failed to write %d bytes to out socket (%d)!", size, errno);
 		return ERROR_FAIL;
 	}
-	return ERROR_OK;
+	return wr_sz;
 }
 
 static int esp32_apptrace_tcp_dest_cleanup(void *priv)
@@ -252,6 +281,7 @@ static int esp32_apptrace_tcp_dest_init(struct esp32_apptrace_dest *dest, const
 		return ERROR_FAIL;
 	}
 	LOG_INFO("apptrace: Connected!");
+	socket_nonblock(sockfd);
 
 	struct esp32_apptrace_dest_tcp_data *dest_data = calloc(1, sizeof(struct esp32_apptrace_dest_tcp_data));
 	if (!dest_data) {
@@ -275,6 +305,11 @@ int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest
 	unsigned int i;
 
 	for (i = 0; i < max_dests; i++) {
+		INIT_LIST_HEAD(&dest[i].backlog);
+		dest[i].backlog_len = 0;
+		dest[i].cur_block = NULL;
+		dest[i].overflow = false;
+		dest[i].dropped = 0;
 		if (strncmp(dest_paths[i], "file://", 7) == 0)
 			res = esp32_apptrace_file_dest_init(&dest[i], &dest_paths[i][7]);
 		else if (strncmp(dest_paths[i], "con:", 4) == 0)
@@ -293,12 +328,132 @@ int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest
 	return i;
 }
 
+static void esp32_apptrace_dest_chunk_free(struct esp32_apptrace_dest *dest,
+	struct esp32_apptrace_dest_chunk *chunk)
+{
+	list_del(&chunk->node);
+	dest->backlog_len -= chunk->len;
+	if (chunk->block)
+		esp32_apptrace_block_put(chunk->block);
+	free(chunk);
+}
+
+static int esp32_apptrace_dest_backlog_add(struct esp32_apptrace_dest *dest,
+	const uint8_t *data, uint32_t size, bool partial)
+{
+	struct esp32_apptrace_block *block = dest->cur_block;
+	bool in_block = block && data >= block->data && data + size <= block->data + block->data_len;
+	struct esp32_apptrace_dest_chunk *chunk = malloc(sizeof(*chunk) + (in_block ? 0 : size));
+	if (!chunk) {
+		LOG_ERROR("apptrace: Failed to alloc mem for dest backlog!");
+		return ERROR_FAIL;
+	}
+	if (in_block) {
+		block->refcnt++;
+		chunk->block = block;
+		chunk->data = data;
+	} else {
+		chunk->block = NULL;
+		memcpy(chunk->buf, data, size);
+		chunk->data = chunk->buf;
+	}
+	chunk->len = size;
+	chunk->partial = partial;
+	list_add_tail(&chunk->node, &dest->backlog);
+	dest->backlog_len += size;
+	return ERROR_OK;
+}
+
+/**
+ * Writes data to a destination without blocking. What the destination does not take
+ * is kept in its backlog, by reference if it lies in the block being processed.
+ */
+int esp32_apptrace_dest_write(struct esp32_apptrace_dest *dest, const uint8_t *data, uint32_t size)
+{
+	if (dest->overflow) {
+		dest->dropped += size;
+		return ERROR_OK;
+	}
+	uint32_t wr_sz = 0;
+	if (list_empty(&dest->backlog)) {
+		int res = dest->write(dest->priv, data, size);
+		if (res < 0)
+			return res;
+		wr_sz = res;
+		if (wr_sz == size)
+			return ERROR_OK;
+	}
+	return esp32_apptrace_dest_backlog_add(dest, data + wr_sz, size - wr_sz, wr_sz != 0);
+}
+
+static int esp32_apptrace_dest_flush(struct esp32_apptrace_dest *dest)
+{
+	while (!list_empty(&dest->backlog)) {
+		struct esp32_apptrace_dest_chunk *chunk =
+			list_first_entry(&dest->backlog, struct esp32_apptrace_dest_chunk, node);
+		int res = dest->write(dest->priv, chunk->data, chunk->len);
+		if (res < 0)
+			return res;
+		if ((uint32_t)res < chunk->len) {
+			chunk->data += res;
+			chunk->len -= res;
+			dest->backlog_len -= res;
+			if (res > 0)
+				chunk->partial = true;
+			break;
+		}
+		esp32_apptrace_dest_chunk_free(dest, chunk);
+	}
+	return ERROR_OK;
+}
+
+/* Drops the backlog of a destination, but the chunk it has started to take */
+static void esp32_apptrace_dest_backlog_drop(struct esp32_apptrace_dest *dest)
+{
+	struct esp32_apptrace_dest_chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &dest->backlog, node) {
+		if (chunk->partial)
+			continue;
+		dest->dropped += chunk->len;
+		esp32_apptrace_dest_chunk_free(dest, chunk);
+	}
+}
+
 int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests)
 {
+	int res = ERROR_OK;
+
 	for (unsigned int i = 0; i < max_dests; i++) {
-		if (dest[i].clean && dest[i].priv) {
-			int res = dest[i].clean(dest[i].priv);
-			dest[i].priv = NULL;
+		if (!dest[i].clean || !dest[i].priv)
+			continue;
+		/* give the destination some time to take its backlog */
+		int64_t timeout = timeval_ms() + ESP32_APPTRACE_DEST_FLUSH_TMO;
+		while (dest[i].backlog_len && timeval_ms() < timeout) {
+			if (esp32_apptrace_dest_flush(&dest[i]) != ERROR_OK)
+				break;
+			if (dest[i].backlog_len)
+				alive_sleep(10);
+		}
+		if (dest[i].backlog_len)
+			LOG_WARNING("apptrace: Drop %" PRIu32 " bytes not taken by dest %u", dest[i].backlog_len, i);
+		while (!list_empty(&dest[i].backlog))
+			esp32_apptrace_dest_chunk_free(&dest[i],
+				list_first_entry(&dest[i].backlog, struct esp32_apptrace_dest_chunk, node));
+		int ret = dest[i].clean(dest[i].priv);
+		dest[i].priv = NULL;
+		if (ret != ERROR_OK)
+			res = ret;
+	}
+	return res;
+}
+
+static int esp32_apptrace_dests_flush(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	for (unsigned int i = 0; i < ctx->dests_num; i++) {
+		int res = esp32_apptrace_dest_flush(&ctx->dests[i]);
+		if (res != ERROR_OK) {
+			LOG_ERROR("apptrace: Failed to write backlog of dest %u!", i);
 			return res;
 		}
 	}
@@ -335,14 +490,47 @@ static void esp32_apptrace_blocks_pool_cleanup(struct esp32_apptrace_cmd_ctx *ct
 	}
 }
 
+static int esp32_apptrace_blocks_pool_add(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	struct esp32_apptrace_block *block = calloc(1, sizeof(struct esp32_apptrace_block));
+	if (!block)
+		return ERROR_FAIL;
+	block->data = malloc(ctx->max_trace_block_sz);
+	if (!block->data) {
+		free(block);
+		return ERROR_FAIL;
+	}
+	block->pool = &ctx->free_trace_blocks;
+	INIT_LIST_HEAD(&block->node);
+	list_add(&block->node, &ctx->free_trace_blocks);
+	ctx->trace_blocks_num++;
+	return ERROR_OK;
+}
+
 struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	struct esp32_apptrace_block *block = NULL;
 
+	if (list_empty(&ctx->free_trace_blocks))
+		/* do not wait for the data processor to release the ready blocks */
+		esp32_apptrace_data_processor(ctx);
+	if (list_empty(&ctx->free_trace_blocks)) {
+		/* the blocks are held by the backlogs of slow destinations, grow the pool up to
+		 * its limit, then shed the backlogs rather than stall the target */
+		if (ctx->trace_blocks_num < ESP_APPTRACE_BLOCKS_POOL_MAX &&
+			esp32_apptrace_blocks_pool_add(ctx) == ERROR_OK) {
+			LOG_DEBUG("apptrace: Grow blocks pool to %u", ctx->trace_blocks_num);
+		} else {
+			for (unsigned int i = 0; i < ctx->dests_num; i++)
+				esp32_apptrace_dest_backlog_drop(&ctx->dests[i]);
+			ctx->stats.shed_blocks++;
+		}
+	}
 	if (!list_empty(&ctx->free_trace_blocks)) {
 		/*get first */
 		block = list_first_entry(&ctx->free_trace_blocks, struct esp32_apptrace_block, node);
 		list_del(&block->node);
+		block->refcnt = 1;
 	}
 
 	return block;
@@ -372,29 +560,31 @@ static struct esp32_apptrace_block *esp32_apptrace_ready_block_get(struct esp32_
 	return block;
 }
 
-static int esp32_apptrace_block_free(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
+static void esp32_apptrace_block_put(struct esp32_apptrace_block *block)
 {
+	if (--block->refcnt)
+		return;
 	/* add to free blocks list */
 	INIT_LIST_HEAD(&block->node);
-	list_add(&block->node, &ctx->free_trace_blocks);
-
-	return ERROR_OK;
+	list_add(&block->node, block->pool);
 }
 
 static int esp32_apptrace_wait_tracing_finished(struct esp32_apptrace_cmd_ctx *ctx)
 {
-	int64_t timeout = timeval_ms() + (LOG_LEVEL_IS(LOG_LVL_DEBUG) ? 70000 : 5000);
-	while (!list_empty(&ctx->ready_trace_blocks)) {
-		alive_sleep(100);
-		if (timeval_ms() >= timeout) {
-			LOG_ERROR("Failed to wait for pended trace blocks!");
-			return ERROR_FAIL;
+	int res = ERROR_OK;
+
+	/* process the pended blocks here, the data processor may not be called again */
+	while (ctx->running && !list_empty(&ctx->ready_trace_blocks)) {
+		res = esp32_apptrace_data_processor(ctx);
+		if (res != ERROR_OK) {
+			LOG_ERROR("Failed to process pended trace blocks!");
+			break;
 		}
 	}
 	/* signal timer callback to stop */
 	ctx->running = 0;
 	target_unregister_timer_callback(esp32_apptrace_data_processor, ctx);
-	return ERROR_OK;
+	return res;
 }
 
 /*********************************************************************
@@ -454,21 +644,11 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 	INIT_LIST_HEAD(&cmd_ctx->ready_trace_blocks);
 	INIT_LIST_HEAD(&cmd_ctx->free_trace_blocks);
 	for (unsigned int i = 0; i < ESP_APPTRACE_BLOCKS_POOL_SZ; i++) {
-		struct esp32_apptrace_block *block = calloc(1, sizeof(struct esp32_apptrace_block));
-		if (!block) {
-			command_print(cmd, "Failed to alloc trace buffer entry!");
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
-			return ERROR_FAIL;
-		}
-		block->data = malloc(cmd_ctx->max_trace_block_sz);
-		if (!block->data) {
-			free(block);
+		if (esp32_apptrace_blocks_pool_add(cmd_ctx) != ERROR_OK) {
 			command_print(cmd, "Failed to alloc trace buffer %" PRIu32 " bytes!", cmd_ctx->max_trace_block_sz);
 			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
 			return ERROR_FAIL;
 		}
-		INIT_LIST_HEAD(&block->node);
-		list_add(&block->node, &cmd_ctx->free_trace_blocks);
 	}
 
 	cmd_ctx->running = 1;
@@ -499,6 +679,8 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 
 int esp32_apptrace_cmd_ctx_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
 {
+	cmd_ctx->dests = NULL;
+	cmd_ctx->dests_num = 0;
 	esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
 	return ERROR_OK;
 }
@@ -578,6 +760,8 @@ static int esp32_apptrace_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 		free(cmd_data);
 		goto on_error;
 	}
+	cmd_ctx->dests = &cmd_data->data_dest;
+	cmd_ctx->dests_num = 1;
 	cmd_ctx->stop_tmo = -1.0;	/* infinite */
 	cmd_data->max_len = UINT32_MAX;
 	cmd_data->poll_period = 0 /*ms*/;
@@ -631,6 +815,11 @@ static void esp32_apptrace_print_stats(struct esp32_apptrace_cmd_ctx *ctx)
 	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32,
 		ctx->stats.incompl_blocks,
 		ctx->stats.lost_bytes);
+	LOG_USER("Blocks pool: %u, shed %" PRIu32 " times", ctx->trace_blocks_num, ctx->stats.shed_blocks);
+	for (unsigned int i = 0; i < ctx->dests_num; i++)
+		LOG_USER("Dest %u: backlog %" PRIu32 " bytes, dropped %" PRIu64 " bytes", i,
+			ctx->dests[i].backlog_len,
+			ctx->dests[i].dropped);
 	if (s_time_stats_enable) {
 		LOG_USER("Block read time [%f..%f] ms",
 			1000 * ctx->stats.min_blk_read_time,
@@ -889,7 +1078,7 @@ static int esp32_apptrace_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 		if (ctx->tot_len + wr_chunk_len > cmd_data->max_len)
 			wr_chunk_len -= (ctx->tot_len + wr_chunk_len - cmd_data->skip_len) - cmd_data->max_len;
 		if (wr_chunk_len > 0) {
-			int res = cmd_data->data_dest.write(cmd_data->data_dest.priv, data + wr_idx, wr_chunk_len);
+			int res = esp32_apptrace_dest_write(&cmd_data->data_dest, data + wr_idx, wr_chunk_len);
 			if (res != ERROR_OK) {
 				LOG_ERROR("Failed to write %" PRId32 " bytes to dest 0!", data_len);
 				return res;
@@ -918,8 +1107,15 @@ static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
 {
 	uint32_t processed = 0;
 	uint32_t hdr_sz = ctx->trace_format.hdr_sz;
+	int res = ERROR_OK;
 
 	LOG_DEBUG("Got block %" PRId32 " bytes", block->data_len);
+	/* the data of the block are passed to the destinations by reference, those behind
+	 * by more than their backlog limit skip the whole block */
+	for (unsigned int i = 0; i < ctx->dests_num; i++) {
+		ctx->dests[i].cur_block = block;
+		ctx->dests[i].overflow = ctx->dests[i].backlog_len > ESP32_APPTRACE_DEST_BACKLOG_MAX;
+	}
 	/* process user blocks one by one */
 	while (processed < block->data_len) {
 		LOG_DEBUG("Process usr block %" PRId32 "/%" PRId32, processed, block->data_len);
@@ -927,14 +1123,18 @@ static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
 		uint32_t usr_len = esp32_apptrace_usr_block_check(ctx, block->data + processed);
 		int core_id = ctx->trace_format.core_id_get(ctx->target, block->data + processed);
 		/* process user data */
-		int res = ctx->process_data(ctx, core_id, block->data + processed + hdr_sz, usr_len);
+		res = ctx->process_data(ctx, core_id, block->data + processed + hdr_sz, usr_len);
 		if (res != ERROR_OK) {
 			LOG_ERROR("Failed to process %" PRId32 " bytes!", usr_len);
-			return res;
+			break;
 		}
 		processed += usr_len + hdr_sz;
 	}
-	return ERROR_OK;
+	for (unsigned int i = 0; i < ctx->dests_num; i++) {
+		ctx->dests[i].cur_block = NULL;
+		ctx->dests[i].overflow = false;
+	}
+	return res;
 }
 
 static int esp32_apptrace_data_processor(void *priv)
@@ -944,24 +1144,22 @@ static int esp32_apptrace_data_processor(void *priv)
 	if (!ctx->running)
 		return ERROR_OK;
 
-	struct esp32_apptrace_block *block = esp32_apptrace_ready_block_get(ctx);
-	if (!block)
-		return ERROR_OK;
-
-	int res = esp32_apptrace_handle_trace_block(ctx, block);
-	if (res != ERROR_OK) {
-		ctx->running = 0;
-		LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
-		return res;
-	}
-	res = esp32_apptrace_block_free(ctx, block);
-	if (res != ERROR_OK) {
-		ctx->running = 0;
-		LOG_ERROR("Failed to free ready block!");
-		return res;
+	struct esp32_apptrace_block *block;
+	while ((block = esp32_apptrace_ready_block_get(ctx))) {
+		int res = esp32_apptrace_handle_trace_block(ctx, block);
+		esp32_apptrace_block_put(block);
+		if (res != ERROR_OK) {
+			ctx->running = 0;
+			LOG_ERROR("Failed to process trace block!");
+			return res;
+		}
 	}
 
-	return ERROR_OK;
+	/* push the backlogs of the non-blocking destinations */
+	int res = esp32_apptrace_dests_flush(ctx);
+	if (res != ERROR_OK)
+		ctx->running = 0;
+	return res;
 }
 
 static int esp32_apptrace_check_connection(struct esp32_apptrace_cmd_ctx *ctx)
@@ -1129,6 +1327,7 @@ static int esp32_apptrace_poll(void *priv)
 		ctx->mode != ESP_APPTRACE_CMD_MODE_SYNC);
 	if (res != ERROR_OK) {
 		ctx->running = 0;
+		esp32_apptrace_block_put(block);
 		LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to read data!");
 		return res;
 	}
@@ -1180,15 +1379,15 @@ static int esp32_apptrace_poll(void *priv)
 		}
 	} else {
 		res = esp32_apptrace_handle_trace_block(ctx, block);
+		esp32_apptrace_block_put(block);
 		if (res != ERROR_OK) {
 			ctx->running = 0;
-			LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
+			LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", target_state[fired_target_num].data_len);
 			return res;
 		}
-		res = esp32_apptrace_block_free(ctx, block);
+		res = esp32_apptrace_dests_flush(ctx);
 		if (res != ERROR_OK) {
 			ctx->running = 0;
-			LOG_ERROR("Failed to free ready block!");
 			return res;
 		}
 	}
@@ -1277,7 +1476,7 @@ static int esp32_sysview_start(struct esp32_apptrace_cmd_ctx *ctx)
 	return res;
 }
 
-static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx)
+static int esp32_sysview_stop_trace(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
 {
 	uint32_t old_block_id, fired_target_num = 0, empty_target_num = 0;
 	struct esp32_apptrace_target_state target_state[ESP32_APPTRACE_MAX_CORES_NUM];
@@ -1285,12 +1484,6 @@ static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx)
 	uint8_t cmds[] = { SEGGER_SYSVIEW_COMMAND_ID_STOP };
 	struct duration wait_time;
 
-	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
-	if (!block) {
-		LOG_ERROR("Failed to get free block for data on (%s)!", target_name(ctx->cpus[fired_target_num]));
-		return ERROR_FAIL;
-	}
-
 	/* halt all CPUs (not only one), otherwise it can happen that there is no target data and
 	 * while we are queueing commands another CPU switches tracing block */
 	int res = esp32_apptrace_safe_halt_targets(ctx, target_state);
@@ -1431,6 +1624,18 @@ static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx)
 	return res;
 }
 
+static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
+	if (!block) {
+		LOG_ERROR("Failed to get free block for data!");
+		return ERROR_FAIL;
+	}
+	int res = esp32_sysview_stop_trace(ctx, block);
+	esp32_apptrace_block_put(block);
+	return res;
+}
+
 static int esp32_cmd_apptrace_generic(struct command_invocation *cmd, int mode, const char **argv, int argc)
 {
 	static struct esp32_apptrace_cmd_ctx s_at_cmd_ctx;
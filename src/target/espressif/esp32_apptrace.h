@@ -51,11 +51,22 @@ struct esp_apptrace_host2target_hdr {
 	uint16_t block_sz;
 };
 
+struct esp32_apptrace_block;
+
 struct esp32_apptrace_dest {
 	void *priv;
-	int (*write)(void *priv, uint8_t *data, int size);
+	/* returns the number of bytes written, less than size if the destination would block */
+	int (*write)(void *priv, const uint8_t *data, int size);
 	int (*clean)(void *priv);
 	bool log_progress;
+	/* data not taken yet by the destination */
+	struct list_head backlog;
+	uint32_t backlog_len;
+	/* block being processed, data in it are referenced rather than copied to the backlog */
+	struct esp32_apptrace_block *cur_block;
+	/* the backlog was full when the block processing started, its data are dropped */
+	bool overflow;
+	uint64_t dropped;
 };
 
 struct esp32_apptrace_format {
@@ -67,6 +78,7 @@ struct esp32_apptrace_format {
 struct esp32_apptrace_cmd_stats {
 	uint32_t incompl_blocks;
 	uint32_t lost_bytes;
+	uint32_t shed_blocks;
 	float min_blk_read_time;
 	float max_blk_read_time;
 	float min_blk_proc_time;
@@ -85,7 +97,10 @@ struct esp32_apptrace_cmd_ctx {
 	uint32_t last_blk_id;
 	struct list_head free_trace_blocks;
 	struct list_head ready_trace_blocks;
+	unsigned int trace_blocks_num;
 	uint32_t max_trace_block_sz;
+	struct esp32_apptrace_dest *dests;
+	unsigned int dests_num;
 	struct esp32_apptrace_format trace_format;
 	int (*process_data)(struct esp32_apptrace_cmd_ctx *ctx, unsigned int core_id, uint8_t *data, uint32_t data_len);
 	void (*auto_clean)(struct esp32_apptrace_cmd_ctx *ctx);
@@ -116,6 +131,7 @@ void esp32_apptrace_cmd_args_parse(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	int argc);
 int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests);
 int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests);
+int esp32_apptrace_dest_write(struct esp32_apptrace_dest *dest, const uint8_t *data, uint32_t size);
 int esp_apptrace_usr_block_write(const struct esp32_apptrace_hw *hw, struct target *target,
 	uint32_t block_id,
 	const uint8_t *data,
@@ -73,6 +73,8 @@ int esp32_sysview_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 		res = ERROR_FAIL;
 		goto on_error;
 	}
+	cmd_ctx->dests = cmd_data->data_dests;
+	cmd_ctx->dests_num = dests_num;
 	cmd_data->apptrace.max_len = UINT32_MAX;
 	cmd_data->apptrace.poll_period = 0 /*ms*/;
 	cmd_ctx->stop_tmo = -1.0;	/* infinite */
@@ -156,8 +158,8 @@ static int esp_sysview_trace_header_write(struct esp32_apptrace_cmd_ctx *ctx, bo
 
 	int hdr_len = strlen(hdr_str);
 	for (int i = 0; i < dests_num; i++) {
-		int res = cmd_data->data_dests[i].write(cmd_data->data_dests[i].priv,
-			(uint8_t *)hdr_str,
+		int res = esp32_apptrace_dest_write(&cmd_data->data_dests[i],
+			(const uint8_t *)hdr_str,
 			hdr_len);
 		if (res != ERROR_OK) {
 			LOG_ERROR("sysview: Failed to write %u bytes to dest %d!", hdr_len, i);
@@ -332,7 +334,7 @@ static int esp32_sysview_write_packet(struct esp32_sysview_cmd_data *cmd_data,
 	if (!cmd_data->data_dests[pkt_core_id].write)
 		return ERROR_FAIL;
 
-	int res = cmd_data->data_dests[pkt_core_id].write(cmd_data->data_dests[pkt_core_id].priv, pkt_buf, pkt_len);
+	int res = esp32_apptrace_dest_write(&cmd_data->data_dests[pkt_core_id], pkt_buf, pkt_len);
 
 	if (res != ERROR_OK) {
 		LOG_ERROR("sysview: Failed to write %u bytes to dest %d!", pkt_len, pkt_core_id);
@@ -340,7 +342,7 @@ static int esp32_sysview_write_packet(struct esp32_sysview_cmd_data *cmd_data,
 	}
 	if (delta_len) {
 		/* write packet with modified delta */
-		res = cmd_data->data_dests[pkt_core_id].write(cmd_data->data_dests[pkt_core_id].priv, delta_buf, delta_len);
+		res = esp32_apptrace_dest_write(&cmd_data->data_dests[pkt_core_id], delta_buf, delta_len);
 		if (res != ERROR_OK) {
 			LOG_ERROR("sysview: Failed to write %u bytes of delta to dest %d!", delta_len, pkt_core_id);
 			return res;
@@ -474,7 +476,7 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 				data[7], data[8], data[9]);
 			return ERROR_FAIL;
 		}
-		res = cmd_data->data_dests[core_id].write(cmd_data->data_dests[core_id].priv,
+		res = esp32_apptrace_dest_write(&cmd_data->data_dests[core_id],
 			data,
 			SYSVIEW_SYNC_LEN);
 		if (res != ERROR_OK) {
@@ -487,8 +489,7 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 			for (unsigned int i = 0; i < ctx->cores_num; i++) {
 				if (core_id == i)
 					continue;
-				res =
-					cmd_data->data_dests[i].write(cmd_data->data_dests[i].priv,
+				res = esp32_apptrace_dest_write(&cmd_data->data_dests[i],
 					data,
 					SYSVIEW_SYNC_LEN);
 				if (res != ERROR_OK) {
@@ -529,7 +530,7 @@ int esp32_sysview_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 			if (res != ERROR_OK)
 				return res;
 		} else {
-			res = cmd_data->data_dests[0].write(cmd_data->data_dests[0].priv, data + processed, pkt_len);
+			res = esp32_apptrace_dest_write(&cmd_data->data_dests[0], data + processed, pkt_len);
 			if (res != ERROR_OK) {
 				LOG_ERROR("sysview: Failed to write %u bytes to dest %d!", pkt_len, 0);
 				return res;
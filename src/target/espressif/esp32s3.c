@@ -303,7 +303,9 @@ static int esp32s3_target_init(struct command_context *cmd_ctx, struct target *t
 static const struct xtensa_debug_ops esp32s3_dbg_ops = {
 	.queue_enable = xtensa_dm_queue_enable,
 	.queue_reg_read = xtensa_dm_queue_reg_read,
-	.queue_reg_write = xtensa_dm_queue_reg_write
+	.queue_reg_write = xtensa_dm_queue_reg_write,
+	.queue_reg_read_block = xtensa_dm_queue_reg_read_block,
+	.queue_reg_write_block = xtensa_dm_queue_reg_write_block
 };
 
 static const struct xtensa_power_ops esp32s3_pwr_ops = {
@@ -94,14 +94,17 @@ int riscv_batch_run(struct riscv_batch *batch)
 
 	riscv_batch_add_nop(batch);
 
-	for (size_t i = 0; i < batch->used_scans; ++i) {
-		if (bscan_tunnel_ir_width != 0)
+	if (bscan_tunnel_ir_width != 0) {
+		for (size_t i = 0; i < batch->used_scans; ++i) {
 			riscv_add_bscan_tunneled_scan(batch->target, batch->fields+i, batch->bscan_ctxt+i);
-		else
-			jtag_add_dr_scan(batch->target->tap, 1, batch->fields + i, TAP_IDLE);
 
-		if (batch->idle_count > 0)
-			jtag_add_runtest(batch->idle_count, TAP_IDLE);
+			if (batch->idle_count > 0)
+				jtag_add_runtest(batch->idle_count, TAP_IDLE);
+		}
+	} else {
+		/* data_out outlives the queue, no need to copy it per scan */
+		jtag_add_dr_scans(batch->target->tap, batch->used_scans, 1, batch->fields,
+				batch->idle_count, TAP_IDLE);
 	}
 
 	keep_alive();
@@ -176,6 +179,16 @@ uint32_t riscv_batch_get_dmi_read_data(struct riscv_batch *batch, size_t key)
 	return buf_get_u32(base, DTM_DMI_DATA_OFFSET, DTM_DMI_DATA_LENGTH);
 }
 
+bool riscv_batch_was_busy(struct riscv_batch *batch)
+{
+	for (size_t i = 0; i < batch->used_scans; ++i) {
+		uint8_t *base = batch->data_in + DMI_SCAN_BUF_SIZE * i;
+		if (buf_get_u32(base, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH) == DTM_DMI_OP_BUSY)
+			return true;
+	}
+	return false;
+}
+
 void riscv_batch_add_nop(struct riscv_batch *batch)
 {
 	assert(batch->used_scans < batch->allocated_scans);
@@ -68,6 +68,9 @@ size_t riscv_batch_add_dmi_read(struct riscv_batch *batch, unsigned int address)
 uint32_t riscv_batch_get_dmi_read_op(struct riscv_batch *batch, size_t key);
 uint32_t riscv_batch_get_dmi_read_data(struct riscv_batch *batch, size_t key);
 
+/* Checks whether any scan of this executed batch got a busy response. */
+bool riscv_batch_was_busy(struct riscv_batch *batch);
+
 /* Scans in a NOP. */
 void riscv_batch_add_nop(struct riscv_batch *batch);
 
@@ -31,7 +31,9 @@ struct riscv_program {
 /* Initializes a program with the header. */
 int riscv_program_init(struct riscv_program *p, struct target *t);
 
-/* Write the program to the program buffer. */
+/* Write the program to the program buffer. Only the instructions that
+ * differ from the ones already in the program buffer may be written, so
+ * programs that differ by a register or an immediate are cheap to switch. */
 int riscv_program_write(struct riscv_program *program);
 
 /* Executes a program, returning 0 if the program successfully executed.  Note
@@ -18,6 +18,7 @@
 #include "target/target_type.h"
 #include <helper/log.h>
 #include "jtag/jtag.h"
+#include "jtag/adapter.h"
 #include "target/register.h"
 #include "target/breakpoints.h"
 #include "helper/time_support.h"
@@ -48,6 +49,9 @@ static int riscv013_on_step(struct target *target);
 static int riscv013_resume_prep(struct target *target);
 static bool riscv013_is_halted(struct target *target);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
+static int riscv013_halt_summary(struct target *target, bool *halted);
+static int riscv013_write_progbuf(struct target *target, const riscv_insn_t *insns,
+		unsigned int count);
 static int riscv013_write_debug_buffer(struct target *target, unsigned int index,
 		riscv_insn_t d);
 static riscv_insn_t riscv013_read_debug_buffer(struct target *target, unsigned int index);
@@ -146,6 +150,9 @@ typedef struct {
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
 	uint32_t progbuf_cache[16];
+	/* Statistics, shown by 'riscv info'. */
+	unsigned int progbuf_cache_hits;
+	unsigned int progbuf_cache_writes;
 } dm013_info_t;
 
 typedef struct {
@@ -153,6 +160,51 @@ typedef struct {
 	struct target *target;
 } target_list_t;
 
+/*
+ * A Run-Test/Idle delay learned from the busy responses of the target.
+ * Every busy response increases the delay by 10%. After a streak of
+ * accesses without busy response a 6% lower delay is probed, so that a
+ * transient stall does not slow down the rest of the session. A probe
+ * that ends in a busy response doubles the streak required before the
+ * next one, so that a stable optimum is seldom left.
+ */
+typedef struct {
+	unsigned int value;
+	/* Accesses without busy response since the last change of value. */
+	unsigned int streak;
+	unsigned int probe_interval;
+	/* The last change of value was a probe downwards. */
+	bool probing;
+	/* Statistics, shown by 'riscv info'. */
+	unsigned int busy_count;
+	unsigned int probe_count;
+} riscv013_delay_t;
+
+#define DELAY_PROBE_INTERVAL_MIN	64
+#define DELAY_PROBE_INTERVAL_MAX	(64 * 1024)
+
+/*
+ * Number of elements read per batch by the system bus block reads. It
+ * starts at the minimum and is doubled as long as the throughput measured
+ * over a window of batches improves by more than 1/16, then it is kept.
+ */
+typedef struct {
+	unsigned int batch;
+	bool settled;
+	/* Bytes per second measured with the previous batch size. */
+	uint64_t prev_rate;
+	/* Measurement window at the current batch size. */
+	uint64_t window_bytes;
+	int64_t window_ms;
+	/* Statistics of the last block read, shown by 'riscv info'. */
+	unsigned int last_kbps;
+	unsigned int expected_kbps;
+} riscv013_sb_read_t;
+
+#define SB_READ_BATCH_MIN		16
+#define SB_READ_BATCH_MAX		1024
+#define SB_READ_WINDOW_MS		100
+
 typedef struct {
 	/* The indexed used to address this hart in its DM. */
 	unsigned int index;
@@ -174,21 +226,25 @@ typedef struct {
 	 * access. */
 	unsigned int dtmcs_idle;
 
-	/* This value is incremented every time a dbus access comes back as "busy".
-	 * It's used to determine how many run-test/idle cycles to feed the target
-	 * in between accesses. */
-	unsigned int dmi_busy_delay;
-
-	/* Number of run-test/idle cycles to add between consecutive bus master
-	 * reads/writes respectively. */
-	unsigned int bus_master_write_delay, bus_master_read_delay;
-
-	/* This value is increased every time we tried to execute two commands
-	 * consecutively, and the second one failed because the previous hadn't
-	 * completed yet.  It's used to add extra run-test/idle cycles after
-	 * starting a command, so we don't have to waste time checking for busy to
-	 * go low. */
-	unsigned int ac_busy_delay;
+	/* Number of run-test/idle cycles to feed the target in between accesses,
+	 * learned from the busy responses:
+	 * - RISCV_DELAY_DMI after every dbus access,
+	 * - RISCV_DELAY_AC after starting a command, so we don't have to waste
+	 *   time checking for busy to go low when executing two commands
+	 *   consecutively,
+	 * - RISCV_DELAY_SB_READ/WRITE between consecutive bus master
+	 *   reads/writes respectively. */
+	riscv013_delay_t delay[RISCV_DELAY_COUNT];
+
+	riscv013_sb_read_t sb_read;
+
+	/* Halted state of this hart from the last sweep of its DM, valid until
+	 * it is used by a poll or the state of the harts is changed. */
+	bool halt_summary_valid;
+	bool halt_summary_halted;
+	/* A halt request is left set in dmcontrol for this hart until it halts.
+	 * Selecting all the harts for a sweep would cancel it. */
+	bool haltreq_pending;
 
 	bool abstract_read_csr_supported;
 	bool abstract_write_csr_supported;
@@ -275,6 +331,22 @@ static dm013_info_t *get_dm(struct target *target)
 	return dm;
 }
 
+static void progbuf_cache_invalidate(dm013_info_t *dm)
+{
+	if (dm)
+		memset(dm->progbuf_cache, 0, sizeof(dm->progbuf_cache));
+}
+
+static void halt_summary_invalidate(dm013_info_t *dm)
+{
+	if (!dm)
+		return;
+
+	target_list_t *entry;
+	list_for_each_entry(entry, &dm->target_list, list)
+		get_info(entry->target)->halt_summary_valid = false;
+}
+
 static uint32_t set_hartsel(uint32_t initial, uint32_t index)
 {
 	initial &= ~DM_DMCONTROL_HARTSELLO;
@@ -446,13 +518,74 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 	return in;
 }
 
-static void increase_dmi_busy_delay(struct target *target)
+static void delay_init(riscv013_delay_t *delay, unsigned int value)
+{
+	delay->value = value;
+	delay->streak = 0;
+	delay->probe_interval = DELAY_PROBE_INTERVAL_MIN;
+	delay->probing = false;
+}
+
+static unsigned int delay_value(const struct target *target, enum riscv_delay kind)
+{
+	return get_info(target)->delay[kind].value;
+}
+
+static void delays_reset(const struct target *target)
+{
+	riscv013_info_t *info = get_info(target);
+	RISCV_INFO(r);
+
+	for (unsigned int i = 0; i < RISCV_DELAY_COUNT; i++)
+		delay_init(&info->delay[i], r->initial_delay[i]);
+}
+
+/* Account for @a accesses that completed without busy response. */
+static void delay_success(const struct target *target, enum riscv_delay kind,
+		unsigned int accesses)
+{
+	riscv013_delay_t *delay = &get_info(target)->delay[kind];
+
+	if (!delay->value)
+		return;
+
+	delay->streak += accesses;
+	if (delay->streak < delay->probe_interval)
+		return;
+
+	/* the previous probe survived a whole interval */
+	if (delay->probing)
+		delay->probe_interval = MAX(delay->probe_interval / 2, DELAY_PROBE_INTERVAL_MIN);
+
+	delay->value -= delay->value / 16 + 1;
+	delay->probe_count++;
+	delay->probing = true;
+	delay->streak = 0;
+}
+
+static void increase_busy_delay(const struct target *target, enum riscv_delay kind)
 {
 	riscv013_info_t *info = get_info(target);
-	info->dmi_busy_delay += info->dmi_busy_delay / 10 + 1;
-	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
-			info->dtmcs_idle, info->dmi_busy_delay,
-			info->ac_busy_delay);
+	riscv013_delay_t *delay = &info->delay[kind];
+
+	delay->busy_count++;
+	if (delay->probing)
+		delay->probe_interval = MIN(delay->probe_interval * 2, DELAY_PROBE_INTERVAL_MAX);
+	delay->probing = false;
+	delay->streak = 0;
+	delay->value += delay->value / 10 + 1;
+
+	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d, "
+			"sb_read_delay=%d, sb_write_delay=%d",
+			info->dtmcs_idle, info->delay[RISCV_DELAY_DMI].value,
+			info->delay[RISCV_DELAY_AC].value,
+			info->delay[RISCV_DELAY_SB_READ].value,
+			info->delay[RISCV_DELAY_SB_WRITE].value);
+}
+
+static void increase_dmi_busy_delay(struct target *target)
+{
+	increase_busy_delay(target, RISCV_DELAY_DMI);
 
 	dtmcontrol_scan(target, DTM_DTMCS_DMIRESET);
 }
@@ -480,10 +613,8 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 
 	if (r->reset_delays_wait >= 0) {
 		r->reset_delays_wait--;
-		if (r->reset_delays_wait < 0) {
-			info->dmi_busy_delay = 0;
-			info->ac_busy_delay = 0;
-		}
+		if (r->reset_delays_wait < 0)
+			delays_reset(target);
 	}
 
 	memset(in, 0, num_bytes);
@@ -508,9 +639,9 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 		jtag_add_dr_scan(target->tap, 1, &field, TAP_IDLE);
 	}
 
-	int idle_count = info->dmi_busy_delay;
+	int idle_count = delay_value(target, RISCV_DELAY_DMI);
 	if (exec)
-		idle_count += info->ac_busy_delay;
+		idle_count += delay_value(target, RISCV_DELAY_AC);
 
 	if (idle_count)
 		jtag_add_runtest(idle_count, TAP_IDLE);
@@ -534,7 +665,11 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 	if (address_in)
 		*address_in = buf_get_u32(in, DTM_DMI_ADDRESS_OFFSET, info->abits);
 	dump_field(idle_count, &field);
-	return buf_get_u32(in, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH);
+
+	dmi_status_t status = buf_get_u32(in, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH);
+	if (status == DMI_STATUS_SUCCESS)
+		delay_success(target, RISCV_DELAY_DMI, 1);
+	return status;
 }
 
 /**
@@ -707,15 +842,6 @@ static int dmstatus_read(struct target *target, uint32_t *dmstatus,
 			riscv_command_timeout_sec);
 }
 
-static void increase_ac_busy_delay(struct target *target)
-{
-	riscv013_info_t *info = get_info(target);
-	info->ac_busy_delay += info->ac_busy_delay / 10 + 1;
-	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
-			info->dtmcs_idle, info->dmi_busy_delay,
-			info->ac_busy_delay);
-}
-
 static uint32_t __attribute__((unused)) abstract_register_size(unsigned int width)
 {
 	switch (width) {
@@ -1044,6 +1170,9 @@ static int examine_progbuf(struct target *target)
 		return ERROR_OK;
 	}
 
+	/* The program overwrote itself. */
+	progbuf_cache_invalidate(get_dm(target));
+
 	uint32_t written;
 	if (dmi_read(target, &written, DM_PROGBUF0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -1246,6 +1375,7 @@ static int scratch_write64(struct target *target, scratch_mem_t *scratch,
 			dmi_write(target, DM_DATA1 + scratch->debug_address, value >> 32);
 			break;
 		case SPACE_DMI_PROGBUF:
+			progbuf_cache_invalidate(get_dm(target));
 			dmi_write(target, DM_PROGBUF0 + scratch->debug_address, value);
 			dmi_write(target, DM_PROGBUF1 + scratch->debug_address, value >> 32);
 			break;
@@ -1899,6 +2029,30 @@ static COMMAND_HELPER(riscv013_print_info, struct target *target)
 	if (dmstatus_read(target, &dmstatus, false) == ERROR_OK)
 		riscv_print_info_line(CMD, "dm", "authenticated", get_field(dmstatus, DM_DMSTATUS_AUTHENTICATED));
 
+	/* Learned delays, to be given to 'riscv set_delay' in the next session. */
+	for (unsigned int i = 0; i < RISCV_DELAY_COUNT; i++) {
+		char key[32];
+		const riscv013_delay_t *delay = &info->delay[i];
+
+		snprintf(key, sizeof(key), "delay.%s", riscv_delay_names[i]);
+		riscv_print_info_line(CMD, "dm", key, delay->value);
+		snprintf(key, sizeof(key), "delay.%s.busy", riscv_delay_names[i]);
+		riscv_print_info_line(CMD, "dm", key, delay->busy_count);
+		snprintf(key, sizeof(key), "delay.%s.probes", riscv_delay_names[i]);
+		riscv_print_info_line(CMD, "dm", key, delay->probe_count);
+	}
+
+	dm013_info_t *dm = get_dm(target);
+	if (dm) {
+		riscv_print_info_line(CMD, "dm", "progbuf.cache_hits", dm->progbuf_cache_hits);
+		riscv_print_info_line(CMD, "dm", "progbuf.cache_writes", dm->progbuf_cache_writes);
+	}
+
+	/* Throughput of the last system bus block read. */
+	riscv_print_info_line(CMD, "dm", "sba.read.batch", info->sb_read.batch);
+	riscv_print_info_line(CMD, "dm", "sba.read.kBps", info->sb_read.last_kbps);
+	riscv_print_info_line(CMD, "dm", "sba.read.expected_kBps", info->sb_read.expected_kbps);
+
 	return 0;
 }
 
@@ -2090,17 +2244,19 @@ static int sb_write_address(struct target *target, target_addr_t address,
 
 static int batch_run(const struct target *target, struct riscv_batch *batch)
 {
-	RISCV013_INFO(info);
 	RISCV_INFO(r);
 	if (r->reset_delays_wait >= 0) {
 		r->reset_delays_wait -= batch->used_scans;
 		if (r->reset_delays_wait <= 0) {
 			batch->idle_count = 0;
-			info->dmi_busy_delay = 0;
-			info->ac_busy_delay = 0;
+			delays_reset(target);
 		}
 	}
-	return riscv_batch_run(batch);
+
+	int result = riscv_batch_run(batch);
+	if (result == ERROR_OK && !riscv_batch_was_busy(batch))
+		delay_success(target, RISCV_DELAY_DMI, batch->used_scans);
+	return result;
 }
 
 static int sba_supports_access(struct target *target, unsigned int size_bytes)
@@ -2164,7 +2320,7 @@ static int sample_memory_bus_v1(struct target *target,
 		 */
 		struct riscv_batch *batch = riscv_batch_alloc(
 			target, 1 + enabled_count * 5 * repeat,
-			info->dmi_busy_delay + info->bus_master_read_delay);
+			delay_value(target, RISCV_DELAY_DMI) + delay_value(target, RISCV_DELAY_SB_READ));
 		if (!batch)
 			return ERROR_FAIL;
 
@@ -2224,7 +2380,7 @@ static int sample_memory_bus_v1(struct target *target,
 		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
 			/* Discard this batch (too much hassle to try to recover partial
 			 * data) and try again with a larger delay. */
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+			increase_busy_delay(target, RISCV_DELAY_SB_READ);
 			dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR | DM_SBCS_SBERROR);
 			riscv_batch_free(batch);
 			continue;
@@ -2235,6 +2391,7 @@ static int sample_memory_bus_v1(struct target *target,
 			riscv_batch_free(batch);
 			return ERROR_FAIL;
 		}
+		delay_success(target, RISCV_DELAY_SB_READ, batch->used_scans);
 
 		unsigned int read = 0;
 		for (unsigned int n = 0; n < repeat; n++) {
@@ -2290,8 +2447,10 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->halt_go = &riscv013_halt_go;
 	generic_info->on_step = &riscv013_on_step;
 	generic_info->halt_reason = &riscv013_halt_reason;
+	generic_info->halt_summary = &riscv013_halt_summary;
 	generic_info->read_debug_buffer = &riscv013_read_debug_buffer;
 	generic_info->write_debug_buffer = &riscv013_write_debug_buffer;
+	generic_info->write_progbuf = &riscv013_write_progbuf;
 	generic_info->execute_debug_buffer = &riscv013_execute_debug_buffer;
 	generic_info->fill_dmi_write_u64 = &riscv013_fill_dmi_write_u64;
 	generic_info->fill_dmi_read_u64 = &riscv013_fill_dmi_read_u64;
@@ -2314,11 +2473,9 @@ static int init_target(struct command_context *cmd_ctx,
 	riscv013_info_t *info = get_info(target);
 
 	info->progbufsize = -1;
+	info->sb_read.batch = SB_READ_BATCH_MIN;
 
-	info->dmi_busy_delay = 0;
-	info->bus_master_read_delay = 0;
-	info->bus_master_write_delay = 0;
-	info->ac_busy_delay = 0;
+	delays_reset(target);
 
 	/* Assume all these abstract commands are supported until we learn
 	 * otherwise.
@@ -2341,6 +2498,8 @@ static int assert_reset(struct target *target)
 
 	select_dmi(target);
 
+	halt_summary_invalidate(get_dm(target));
+
 	uint32_t control_base = set_field(0, DM_DMCONTROL_DMACTIVE, 1);
 
 	if (target_has_event_action(target, TARGET_EVENT_RESET_ASSERT)) {
@@ -2372,6 +2531,7 @@ static int assert_reset(struct target *target)
 	}
 
 	target->state = TARGET_RESET;
+	get_info(target)->haltreq_pending = target->reset_halt;
 
 	dm013_info_t *dm = get_dm(target);
 	if (!dm)
@@ -2380,7 +2540,7 @@ static int assert_reset(struct target *target)
 	/* The DM might have gotten reset if OpenOCD called us in some reset that
 	 * involves SRST being toggled. So clear our cache which may be out of
 	 * date. */
-	memset(dm->progbuf_cache, 0, sizeof(dm->progbuf_cache));
+	progbuf_cache_invalidate(dm);
 
 	return ERROR_OK;
 }
@@ -2399,7 +2559,7 @@ static int deassert_reset(struct target *target)
 			set_hartsel(control_haltreq, r->current_hartid));
 
 	uint32_t dmstatus;
-	int dmi_busy_delay = info->dmi_busy_delay;
+	unsigned int dmi_busy_delay = delay_value(target, RISCV_DELAY_DMI);
 	time_t start = time(NULL);
 
 	for (int i = 0; i < riscv_count_harts(target); ++i) {
@@ -2448,12 +2608,13 @@ static int deassert_reset(struct target *target)
 			dmi_write(target, DM_DMCONTROL,
 					set_hartsel(control, index) |
 					DM_DMCONTROL_ACKHAVERESET);
+			info->haltreq_pending = false;
 		}
 
 		if (!target->rtos)
 			break;
 	}
-	info->dmi_busy_delay = dmi_busy_delay;
+	info->delay[RISCV_DELAY_DMI].value = dmi_busy_delay;
 	return ERROR_OK;
 }
 
@@ -2670,8 +2831,60 @@ static int read_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+/* Adapt the batch size of the system bus block reads to the measured throughput. */
+static void sb_read_batch_update(struct target *target, unsigned int bytes, int64_t ms)
+{
+	riscv013_sb_read_t *sb_read = &get_info(target)->sb_read;
+
+	if (sb_read->settled)
+		return;
+
+	sb_read->window_bytes += bytes;
+	sb_read->window_ms += ms;
+	if (sb_read->window_ms < SB_READ_WINDOW_MS)
+		return;
+
+	uint64_t rate = sb_read->window_bytes * 1000 / sb_read->window_ms;
+	sb_read->window_bytes = 0;
+	sb_read->window_ms = 0;
+
+	if (rate <= sb_read->prev_rate + sb_read->prev_rate / 16) {
+		/* no gain, go back to the previous size if it was faster */
+		if (rate < sb_read->prev_rate && sb_read->batch > SB_READ_BATCH_MIN)
+			sb_read->batch /= 2;
+		sb_read->settled = true;
+	} else if (sb_read->batch < SB_READ_BATCH_MAX) {
+		sb_read->batch *= 2;
+		sb_read->prev_rate = rate;
+	} else {
+		sb_read->settled = true;
+	}
+
+	LOG_TARGET_DEBUG(target, "sba read: %" PRIu64 " B/s, %u elements per batch%s",
+			rate, sb_read->batch, sb_read->settled ? " (settled)" : "");
+}
+
+/* Throughput allowed by the JTAG clock, with the current delays. */
+static unsigned int sb_read_expected_kbps(struct target *target, uint32_t size)
+{
+	RISCV013_INFO(info);
+	/* dmi register plus the TAP state transitions around each scan */
+	unsigned int tck = info->abits + DTM_DMI_OP_LENGTH + DTM_DMI_DATA_LENGTH + 5 +
+		delay_value(target, RISCV_DELAY_DMI) + delay_value(target, RISCV_DELAY_SB_READ);
+	unsigned int words = DIV_ROUND_UP(size, 4);
+
+	return (uint64_t)adapter_get_speed_khz() * size / (words * tck);
+}
+
 /**
  * Read the requested memory using the system bus interface.
+ *
+ * With sbreadondata, reading sbdata0 returns an element and starts the
+ * read of the next one. The elements are read in batches sized by
+ * sb_read_batch_update(), without touching sbcs between them, so that the
+ * bus keeps streaming. When a batch fails on a busy response, the read
+ * restarts at the first element that was not received instead of at the
+ * beginning of the batch.
  */
 static int read_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment)
@@ -2682,128 +2895,183 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	}
 
 	RISCV013_INFO(info);
-	target_addr_t next_address = address;
-	target_addr_t end_address = address + count * size;
+	static const int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
+	assert(size <= 16);
+	const unsigned int words = DIV_ROUND_UP(size, 4);
+	const int64_t start_ms = timeval_ms();
+
+	uint32_t sbcs_write = set_field(0, DM_SBCS_SBREADONADDR, 1);
+	sbcs_write |= sb_sbaccess(size);
+	if (increment == size)
+		sbcs_write = set_field(sbcs_write, DM_SBCS_SBAUTOINCREMENT, 1);
+	if (count > 1)
+		sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 1);
+
+	/* Elements below index are in the buffer, the bus reads element index. */
+	uint32_t index = 0;
+	bool restart = true;
+
+	while (true) {
+		if (restart) {
+			if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
+				return ERROR_FAIL;
 
-	while (next_address < end_address) {
-		uint32_t sbcs_write = set_field(0, DM_SBCS_SBREADONADDR, 1);
-		sbcs_write |= sb_sbaccess(size);
-		if (increment == size)
-			sbcs_write = set_field(sbcs_write, DM_SBCS_SBAUTOINCREMENT, 1);
-		if (count > 1)
-			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, count > 1);
-		if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
+			/* This address write will trigger the first read. */
+			if (sb_write_address(target, address + index * increment, true) != ERROR_OK)
+				return ERROR_FAIL;
+
+			if (delay_value(target, RISCV_DELAY_SB_READ)) {
+				jtag_add_runtest(delay_value(target, RISCV_DELAY_SB_READ), TAP_IDLE);
+				if (jtag_execute_queue() != ERROR_OK) {
+					LOG_ERROR("Failed to scan idle sequence");
+					return ERROR_FAIL;
+				}
+			}
+			restart = false;
+		}
+
+		/* The last element is read after sbreadondata is disabled. */
+		if (index >= count - 1)
+			break;
+
+		uint32_t elements = MIN(count - 1 - index, info->sb_read.batch);
+		struct riscv_batch *batch = riscv_batch_alloc(target, elements * words + 5,
+				delay_value(target, RISCV_DELAY_DMI) + delay_value(target, RISCV_DELAY_SB_READ));
+		if (!batch)
 			return ERROR_FAIL;
 
-		/* This address write will trigger the first read. */
-		if (sb_write_address(target, next_address, true) != ERROR_OK)
+		for (uint32_t i = 0; i < elements; i++)
+			for (int j = words - 1; j >= 0; j--)
+				riscv_batch_add_dmi_read(batch, sbdata[j]);
+		size_t sbcs_key = riscv_batch_add_dmi_read(batch, DM_SBCS);
+
+		keep_alive();
+		int64_t batch_ms = timeval_ms();
+		if (batch_run(target, batch) != ERROR_OK) {
+			riscv_batch_free(batch);
 			return ERROR_FAIL;
+		}
 
-		if (info->bus_master_read_delay) {
-			jtag_add_runtest(info->bus_master_read_delay, TAP_IDLE);
-			if (jtag_execute_queue() != ERROR_OK) {
-				LOG_ERROR("Failed to scan idle sequence");
-				return ERROR_FAIL;
+		/* Copy the elements up to the first failed scan. */
+		uint32_t done = 0;
+		uint32_t status = DMI_STATUS_SUCCESS;
+		for (size_t key = 0; done < elements; done++) {
+			uint32_t value[4];
+			for (int j = words - 1; j >= 0; j--, key++) {
+				status = riscv_batch_get_dmi_read_op(batch, key);
+				if (status != DMI_STATUS_SUCCESS)
+					break;
+				value[j] = riscv_batch_get_dmi_read_data(batch, key);
 			}
-		}
+			if (status != DMI_STATUS_SUCCESS)
+				break;
 
-		/* First value has been read, and is waiting for us to issue a DMI read
-		 * to get it. */
-
-		static int sbdata[4] = {DM_SBDATA0, DM_SBDATA1, DM_SBDATA2, DM_SBDATA3};
-		assert(size <= 16);
-		target_addr_t next_read = address - 1;
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			for (int j = (size - 1) / 4; j >= 0; j--) {
-				uint32_t value;
-				unsigned int attempt = 0;
-				while (1) {
-					if (attempt++ > 100) {
-						LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								  next_read);
-						return ERROR_FAIL;
-					}
-					keep_alive();
-					dmi_status_t status = dmi_scan(target, NULL, &value,
-												   DMI_OP_READ, sbdata[j], 0, false);
-					if (status == DMI_STATUS_BUSY)
-						increase_dmi_busy_delay(target);
-					else if (status == DMI_STATUS_SUCCESS)
-						break;
-					else
-						return ERROR_FAIL;
-				}
-				if (next_read != address - 1) {
-					buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-					log_memory_access(next_read, value, MIN(size, 4), true);
-				}
-				next_read = address + i * size + j * 4;
+			target_addr_t element_address = address + (index + done) * increment;
+			for (unsigned int j = 0; j < words; j++) {
+				buf_set_u32(buffer + (index + done) * size + j * 4, 0, 8 * MIN(size, 4), value[j]);
+				log_memory_access(element_address + j * 4, value[j], MIN(size, 4), true);
 			}
 		}
 
 		uint32_t sbcs_read = 0;
-		if (count > 1) {
-			uint32_t value;
-			unsigned int attempt = 0;
-			while (1) {
-				if (attempt++ > 100) {
-					LOG_ERROR("DMI keeps being busy in while reading memory just past " TARGET_ADDR_FMT,
-								next_read);
-					return ERROR_FAIL;
-				}
-				dmi_status_t status = dmi_scan(target, NULL, &value, DMI_OP_NOP, 0, 0, false);
-				if (status == DMI_STATUS_BUSY)
-					increase_dmi_busy_delay(target);
-				else if (status == DMI_STATUS_SUCCESS)
-					break;
-				else
-					return ERROR_FAIL;
-			}
-			buf_set_u32(buffer + next_read - address, 0, 8 * MIN(size, 4), value);
-			log_memory_access(next_read, value, MIN(size, 4), true);
+		if (status == DMI_STATUS_SUCCESS) {
+			status = riscv_batch_get_dmi_read_op(batch, sbcs_key);
+			sbcs_read = riscv_batch_get_dmi_read_data(batch, sbcs_key);
+		}
+		riscv_batch_free(batch);
 
+		if (status == DMI_STATUS_BUSY) {
+			/* The element after the last one received may have been read
+			 * from sbdata0 anyway, so the bus has moved past it. */
+			increase_dmi_busy_delay(target);
+			restart = true;
+		} else if (status != DMI_STATUS_SUCCESS) {
+			LOG_TARGET_ERROR(target, "DMI error %d while reading memory at " TARGET_ADDR_FMT,
+					status, address + (index + done) * increment);
+			return ERROR_FAIL;
+		}
+
+		if (restart || get_field(sbcs_read, DM_SBCS_SBBUSY)) {
 			/* "Writes to sbcs while sbbusy is high result in undefined behavior.
 			 * A debugger must not write to sbcs until it reads sbbusy as 0." */
 			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
 				return ERROR_FAIL;
-
-			sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 0);
-			if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
-				return ERROR_FAIL;
 		}
 
-		/* Read the last word, after we disabled sbreadondata if necessary. */
-		if (!get_field(sbcs_read, DM_SBCS_SBERROR) &&
-				!get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
-			if (read_memory_bus_word(target, address + (count - 1) * size, size,
-						buffer + (count - 1) * size) != ERROR_OK)
-				return ERROR_FAIL;
-
-			if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
-				return ERROR_FAIL;
+		if (get_field(sbcs_read, DM_SBCS_SBERROR)) {
+			/* Some error indicating the bus access failed, but not because of
+			 * something we did wrong. */
+			dmi_write(target, DM_SBCS, DM_SBCS_SBERROR);
+			return ERROR_FAIL;
 		}
 
 		if (get_field(sbcs_read, DM_SBCS_SBBUSYERROR)) {
-			/* We read while the target was busy. Slow down and try again. */
-			if (dmi_write(target, DM_SBCS, sbcs_read | DM_SBCS_SBBUSYERROR) != ERROR_OK)
+			/* sbdata0 was read before the bus read completed: it returned
+			 * stale data and did not start the next read, so sbaddress
+			 * stopped one element past the first one that failed. */
+			if (dmi_write(target, DM_SBCS, sbcs_write | DM_SBCS_SBBUSYERROR) != ERROR_OK)
 				return ERROR_FAIL;
-			next_address = sb_read_address(target);
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
-			continue;
+			uint32_t failed = 0;
+			if (increment) {
+				target_addr_t next_address = sb_read_address(target);
+				if (next_address >= address + (index + 1) * increment)
+					failed = MIN((next_address - address) / size - 1 - index, done);
+			}
+			LOG_TARGET_DEBUG(target, "sbbusyerror, restarting at " TARGET_ADDR_FMT,
+					address + (index + failed) * increment);
+			done = failed;
+			increase_busy_delay(target, RISCV_DELAY_SB_READ);
+			restart = true;
+		} else if (!restart) {
+			delay_success(target, RISCV_DELAY_SB_READ, done);
+			sb_read_batch_update(target, done * size, timeval_ms() - batch_ms);
 		}
 
-		unsigned int error = get_field(sbcs_read, DM_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			if (dmi_write(target, DM_SBCS, DM_SBCS_SBERROR) != ERROR_OK)
-				return ERROR_FAIL;
+		index += done;
+	}
+
+	uint32_t sbcs_read = 0;
+	if (count > 1) {
+		if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
+			return ERROR_FAIL;
+
+		sbcs_write = set_field(sbcs_write, DM_SBCS_SBREADONDATA, 0);
+		if (dmi_write(target, DM_SBCS, sbcs_write) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	/* Read the last element, after we disabled sbreadondata if necessary. */
+	target_addr_t last_address = address + (count - 1) * increment;
+	while (true) {
+		if (read_memory_bus_word(target, last_address, size,
+					buffer + (count - 1) * size) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (!get_field(sbcs_read, DM_SBCS_SBBUSYERROR))
+			break;
+
+		/* We read while the target was busy. Slow down and try again. */
+		if (dmi_write(target, DM_SBCS, sbcs_write | DM_SBCS_SBBUSYERROR) != ERROR_OK)
+			return ERROR_FAIL;
+		increase_busy_delay(target, RISCV_DELAY_SB_READ);
+		if (sb_write_address(target, last_address, true) != ERROR_OK)
+			return ERROR_FAIL;
+		if (read_sbcs_nonbusy(target, &sbcs_read) != ERROR_OK)
 			return ERROR_FAIL;
-		}
 	}
 
+	if (get_field(sbcs_read, DM_SBCS_SBERROR)) {
+		dmi_write(target, DM_SBCS, DM_SBCS_SBERROR);
+		return ERROR_FAIL;
+	}
+
+	int64_t ms = timeval_ms() - start_ms;
+	info->sb_read.last_kbps = (uint64_t)count * size / MAX(ms, 1);
+	info->sb_read.expected_kbps = sb_read_expected_kbps(target, size);
+
 	return ERROR_OK;
 }
 
@@ -3157,7 +3425,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 */
 
 		struct riscv_batch *batch = riscv_batch_alloc(target, 32,
-				info->dmi_busy_delay + info->ac_busy_delay);
+				delay_value(target, RISCV_DELAY_DMI) + delay_value(target, RISCV_DELAY_AC));
 		if (!batch)
 			return ERROR_FAIL;
 
@@ -3190,12 +3458,13 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		switch (info->cmderr) {
 			case CMDERR_NONE:
 				LOG_DEBUG("successful (partial?) memory read");
+				delay_success(target, RISCV_DELAY_AC, reads);
 				next_index = index + reads;
 				break;
 			case CMDERR_BUSY:
 				LOG_DEBUG("memory read resulted in busy response");
 
-				increase_ac_busy_delay(target);
+				increase_busy_delay(target, RISCV_DELAY_AC);
 				riscv013_clear_abstract_error(target);
 
 				dmi_write(target, DM_ABSTRACTAUTO, 0);
@@ -3648,7 +3917,6 @@ static int write_memory_bus_v0(struct target *target, target_addr_t address,
 static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
-	RISCV013_INFO(info);
 	uint32_t sbcs = sb_sbaccess(size);
 	sbcs = set_field(sbcs, DM_SBCS_SBAUTOINCREMENT, 1);
 	dmi_write(target, DM_SBCS, sbcs);
@@ -3666,7 +3934,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
 				32,
-				info->dmi_busy_delay + info->bus_master_write_delay);
+				delay_value(target, RISCV_DELAY_DMI) + delay_value(target, RISCV_DELAY_SB_WRITE));
 		if (!batch)
 			return ERROR_FAIL;
 
@@ -3710,6 +3978,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 
 		/* Execute the batch of writes */
 		result = batch_run(target, batch);
+		size_t batch_scans = batch->used_scans;
 		riscv_batch_free(batch);
 		if (result != ERROR_OK)
 			return result;
@@ -3742,7 +4011,9 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			/* Clear the sticky error flag. */
 			dmi_write(target, DM_SBCS, sbcs | DM_SBCS_SBBUSYERROR);
 			/* Slow down before trying again. */
-			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+			increase_busy_delay(target, RISCV_DELAY_SB_WRITE);
+		} else if (!dmi_busy_encountered) {
+			delay_success(target, RISCV_DELAY_SB_WRITE, batch_scans);
 		}
 
 		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
@@ -3861,7 +4132,7 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
 				32,
-				info->dmi_busy_delay + info->ac_busy_delay);
+				delay_value(target, RISCV_DELAY_DMI) + delay_value(target, RISCV_DELAY_AC));
 		if (!batch)
 			goto error;
 
@@ -3917,6 +4188,7 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		}
 
 		result = batch_run(target, batch);
+		size_t batch_scans = batch->used_scans;
 		riscv_batch_free(batch);
 		if (result != ERROR_OK)
 			goto error;
@@ -3937,13 +4209,14 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 		info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
 		if (info->cmderr == CMDERR_NONE && !dmi_busy_encountered) {
 			LOG_DEBUG("successful (partial?) memory write");
+			delay_success(target, RISCV_DELAY_AC, batch_scans);
 		} else if (info->cmderr == CMDERR_BUSY || dmi_busy_encountered) {
 			if (info->cmderr == CMDERR_BUSY)
 				LOG_DEBUG("Memory write resulted in abstract command busy response.");
 			else if (dmi_busy_encountered)
 				LOG_DEBUG("Memory write resulted in DMI busy response.");
 			riscv013_clear_abstract_error(target);
-			increase_ac_busy_delay(target);
+			increase_busy_delay(target, RISCV_DELAY_AC);
 
 			dmi_write(target, DM_ABSTRACTAUTO, 0);
 			result = register_read_direct(target, &cur_addr, GDB_REGNO_S0);
@@ -4209,6 +4482,8 @@ static int riscv013_halt_go(struct target *target)
 	if (select_prepped_harts(target, &use_hasel) != ERROR_OK)
 		return ERROR_FAIL;
 
+	halt_summary_invalidate(get_dm(target));
+
 	RISCV_INFO(r);
 	LOG_DEBUG("halting hart %d", r->current_hartid);
 
@@ -4237,6 +4512,7 @@ static int riscv013_halt_go(struct target *target)
 
 	dmcontrol = set_field(dmcontrol, DM_DMCONTROL_HALTREQ, 0);
 	dmi_write(target, DM_DMCONTROL, dmcontrol);
+	get_info(target)->haltreq_pending = false;
 
 	if (use_hasel) {
 		target_list_t *entry;
@@ -4245,6 +4521,7 @@ static int riscv013_halt_go(struct target *target)
 			return ERROR_FAIL;
 		list_for_each_entry(entry, &dm->target_list, list) {
 			struct target *t = entry->target;
+			get_info(t)->haltreq_pending = false;
 			t->state = TARGET_HALTED;
 			if (t->debug_reason == DBG_REASON_NOTHALTED)
 				t->debug_reason = DBG_REASON_DBGRQ;
@@ -4305,13 +4582,127 @@ static bool riscv013_is_halted(struct target *target)
 		 * message that a reset happened, that the target is running, and then
 		 * that it is halted again once the request goes through.
 		 */
-		if (target->state == TARGET_HALTED)
+		if (target->state == TARGET_HALTED) {
 			dmcontrol |= DM_DMCONTROL_HALTREQ;
+			get_info(target)->haltreq_pending = true;
+		}
 		dmi_write(target, DM_DMCONTROL, dmcontrol);
 	}
+	if (get_field(dmstatus, DM_DMSTATUS_ALLHALTED))
+		get_info(target)->haltreq_pending = false;
 	return get_field(dmstatus, DM_DMSTATUS_ALLHALTED);
 }
 
+/*
+ * Read the halted state of all the harts of the DM in a single batch. For
+ * each window of 32 harts, haltsum0 gives the halted bit of every hart, and
+ * dmstatus read with all the harts of the window selected through hasel
+ * tells whether any of them was reset or became unavailable. The harts of
+ * such a window are left to the regular per hart poll.
+ */
+#define HALT_SUMMARY_WINDOWS	DIV_ROUND_UP(RISCV_MAX_HARTS, 32)
+
+static int halt_summary_sweep(struct target *target)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	if (!dm->hasel_supported || dm->hart_count <= 1 || dm->current_hartid < 0)
+		return ERROR_NOT_IMPLEMENTED;
+
+	const unsigned int windows = DIV_ROUND_UP(dm->hart_count, 32);
+	if (windows > HALT_SUMMARY_WINDOWS)
+		return ERROR_NOT_IMPLEMENTED;
+	uint32_t hawindow[HALT_SUMMARY_WINDOWS] = { 0 };
+
+	unsigned int harts = 0;
+	target_list_t *entry;
+	list_for_each_entry(entry, &dm->target_list, list) {
+		riscv013_info_t *info = get_info(entry->target);
+		/* Writing dmcontrol would clear the pending halt requests. */
+		if (info->haltreq_pending)
+			return ERROR_NOT_IMPLEMENTED;
+		unsigned int index = info->index;
+		if (index / 32 >= windows)
+			return ERROR_NOT_IMPLEMENTED;
+		hawindow[index / 32] |= 1u << (index % 32);
+		harts++;
+	}
+
+	/* A single hart is polled as fast directly. */
+	if (harts <= 1)
+		return ERROR_NOT_IMPLEMENTED;
+
+	struct riscv_batch *batch = riscv_batch_alloc(target, 5 * windows + 5,
+			delay_value(target, RISCV_DELAY_DMI));
+	if (!batch)
+		return ERROR_FAIL;
+
+	size_t haltsum_key[HALT_SUMMARY_WINDOWS];
+	size_t dmstatus_key[HALT_SUMMARY_WINDOWS];
+	for (unsigned int i = 0; i < windows; i++) {
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOWSEL, i);
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOW, hawindow[i]);
+		riscv_batch_add_dmi_write(batch, DM_DMCONTROL,
+				set_hartsel(DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_HASEL, i * 32));
+		haltsum_key[i] = riscv_batch_add_dmi_read(batch, DM_HALTSUM0);
+		dmstatus_key[i] = riscv_batch_add_dmi_read(batch, DM_DMSTATUS);
+	}
+	const uint32_t dmcontrol = set_hartsel(DM_DMCONTROL_DMACTIVE, dm->current_hartid);
+	riscv_batch_add_dmi_write(batch, DM_DMCONTROL, dmcontrol);
+
+	int result = batch_run(target, batch);
+	if (result != ERROR_OK || riscv_batch_was_busy(batch)) {
+		riscv_batch_free(batch);
+		if (result == ERROR_OK)
+			increase_dmi_busy_delay(target);
+		/* don't leave all the harts selected */
+		dmi_write(target, DM_DMCONTROL, dmcontrol);
+		return ERROR_FAIL;
+	}
+
+	uint32_t haltsum[HALT_SUMMARY_WINDOWS];
+	bool window_valid[HALT_SUMMARY_WINDOWS];
+	for (unsigned int i = 0; i < windows; i++) {
+		uint32_t dmstatus = riscv_batch_get_dmi_read_data(batch, dmstatus_key[i]);
+		haltsum[i] = riscv_batch_get_dmi_read_data(batch, haltsum_key[i]);
+		window_valid[i] =
+			riscv_batch_get_dmi_read_op(batch, haltsum_key[i]) == DMI_STATUS_SUCCESS &&
+			riscv_batch_get_dmi_read_op(batch, dmstatus_key[i]) == DMI_STATUS_SUCCESS &&
+			!get_field(dmstatus, DM_DMSTATUS_ANYHAVERESET) &&
+			!get_field(dmstatus, DM_DMSTATUS_ANYUNAVAIL) &&
+			!get_field(dmstatus, DM_DMSTATUS_ANYNONEXISTENT);
+	}
+	riscv_batch_free(batch);
+
+	list_for_each_entry(entry, &dm->target_list, list) {
+		riscv013_info_t *info = get_info(entry->target);
+		info->halt_summary_valid = window_valid[info->index / 32];
+		info->halt_summary_halted = haltsum[info->index / 32] & (1u << (info->index % 32));
+	}
+
+	return ERROR_OK;
+}
+
+static int riscv013_halt_summary(struct target *target, bool *halted)
+{
+	RISCV013_INFO(info);
+
+	if (!info->halt_summary_valid) {
+		int result = halt_summary_sweep(target);
+		if (result != ERROR_OK)
+			return result;
+		if (!info->halt_summary_valid)
+			return ERROR_FAIL;
+	}
+
+	/* Each sweep is used once per hart, the next poll sweeps again. */
+	info->halt_summary_valid = false;
+	*halted = info->halt_summary_halted;
+	return ERROR_OK;
+}
+
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target)
 {
 	riscv_reg_t dcsr;
@@ -4351,15 +4742,78 @@ int riscv013_write_debug_buffer(struct target *target, unsigned int index, riscv
 	if (!dm)
 		return ERROR_FAIL;
 	if (dm->progbuf_cache[index] != data) {
+		dm->progbuf_cache[index] = 0;
 		if (dmi_write(target, DM_PROGBUF0 + index, data) != ERROR_OK)
 			return ERROR_FAIL;
 		dm->progbuf_cache[index] = data;
+		dm->progbuf_cache_writes++;
 	} else {
 		LOG_DEBUG("cache hit for 0x%" PRIx32 " @%d", data, index);
+		dm->progbuf_cache_hits++;
 	}
 	return ERROR_OK;
 }
 
+/* Write the instructions that differ from the cached ones in a single batch. */
+static int riscv013_write_progbuf(struct target *target, const riscv_insn_t *insns,
+		unsigned int count)
+{
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	assert(count <= ARRAY_SIZE(dm->progbuf_cache));
+
+	unsigned int misses = 0;
+	for (unsigned int i = 0; i < count; i++)
+		if (dm->progbuf_cache[i] != insns[i])
+			misses++;
+
+	dm->progbuf_cache_hits += count - misses;
+	if (misses < 2) {
+		for (unsigned int i = 0; i < count; i++)
+			if (dm->progbuf_cache[i] != insns[i] &&
+					riscv013_write_debug_buffer(target, i, insns[i]) != ERROR_OK)
+				return ERROR_FAIL;
+		return ERROR_OK;
+	}
+
+	struct riscv_batch *batch = riscv_batch_alloc(target, misses + 4,
+			delay_value(target, RISCV_DELAY_DMI));
+	if (!batch)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (dm->progbuf_cache[i] == insns[i])
+			continue;
+		riscv_batch_add_dmi_write(batch, DM_PROGBUF0 + i, insns[i]);
+		/* invalid until the batch is known to have succeeded */
+		dm->progbuf_cache[i] = 0;
+	}
+
+	int result = batch_run(target, batch);
+	bool busy = riscv_batch_was_busy(batch);
+	riscv_batch_free(batch);
+	if (result != ERROR_OK)
+		return result;
+
+	if (busy) {
+		/* Some writes were dropped, redo them one by one. */
+		increase_dmi_busy_delay(target);
+		for (unsigned int i = 0; i < count; i++)
+			if (dm->progbuf_cache[i] != insns[i] &&
+					riscv013_write_debug_buffer(target, i, insns[i]) != ERROR_OK)
+				return ERROR_FAIL;
+		return ERROR_OK;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+		dm->progbuf_cache[i] = insns[i];
+	dm->progbuf_cache_writes += misses;
+
+	return ERROR_OK;
+}
+
 riscv_insn_t riscv013_read_debug_buffer(struct target *target, unsigned int index)
 {
 	uint32_t value;
@@ -4443,6 +4897,8 @@ static int riscv013_step_or_resume_current_hart(struct target *target,
 		return ERROR_FAIL;
 	}
 
+	halt_summary_invalidate(get_dm(target));
+
 	/* Issue the resume command, and then wait for the current hart to resume. */
 	uint32_t dmcontrol = DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_RESUMEREQ;
 	if (use_hasel)
@@ -210,6 +210,13 @@ bool riscv_ebreakm = true;
 bool riscv_ebreaks = true;
 bool riscv_ebreaku = true;
 
+const char * const riscv_delay_names[RISCV_DELAY_COUNT] = {
+	[RISCV_DELAY_DMI] = "dmi",
+	[RISCV_DELAY_AC] = "ac",
+	[RISCV_DELAY_SB_READ] = "sb_read",
+	[RISCV_DELAY_SB_WRITE] = "sb_write",
+};
+
 bool riscv_enable_virtual;
 
 static enum {
@@ -2083,6 +2090,15 @@ enum riscv_poll_hart {
 static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
 {
 	RISCV_INFO(r);
+
+	/* Don't access the hart when the summary shows its state didn't change. */
+	bool halted;
+	if (r->halt_summary &&
+			(target->state == TARGET_HALTED || target->state == TARGET_RUNNING) &&
+			r->halt_summary(target, &halted) == ERROR_OK &&
+			halted == (target->state == TARGET_HALTED))
+		return RPH_NO_CHANGE;
+
 	if (riscv_set_current_hartid(target, hartid) != ERROR_OK)
 		return RPH_ERROR;
 
@@ -2090,7 +2106,7 @@ static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
 
 	/* If OpenOCD thinks we're running but this hart is halted then it's time
 	 * to raise an event. */
-	bool halted = riscv_is_halted(target);
+	halted = riscv_is_halted(target);
 	if (target->state != TARGET_HALTED && halted) {
 		LOG_DEBUG("  triggered a halt");
 		r->on_halt(target);
@@ -2725,6 +2741,27 @@ COMMAND_HANDLER(riscv_reset_delays)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_set_delay)
+{
+	if (CMD_ARGC != 2) {
+		LOG_ERROR("Command takes exactly 2 arguments");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	for (unsigned int i = 0; i < RISCV_DELAY_COUNT; i++) {
+		if (!strcmp(CMD_ARGV[0], riscv_delay_names[i])) {
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], r->initial_delay[i]);
+			return ERROR_OK;
+		}
+	}
+
+	LOG_ERROR("Unknown delay: %s", CMD_ARGV[0]);
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 COMMAND_HANDLER(riscv_set_ir)
 {
 	if (CMD_ARGC != 2) {
@@ -2946,6 +2983,15 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.usage = "address value",
 		.help = "Perform a 32-bit DMI write of value at address."
 	},
+	{
+		.name = "set_delay",
+		.handler = riscv_set_delay,
+		.mode = COMMAND_ANY,
+		.usage = "dmi|ac|sb_read|sb_write cycles",
+		.help = "Set the number of Run-Test/Idle cycles OpenOCD starts with "
+			"for the given kind of access, e.g. the value learned in a "
+			"previous session and shown by `riscv info`."
+	},
 	{
 		.name = "reset_delays",
 		.handler = riscv_reset_delays,
@@ -3399,6 +3445,19 @@ int riscv_write_debug_buffer(struct target *target, int index, riscv_insn_t insn
 	return ERROR_OK;
 }
 
+int riscv_write_progbuf(struct target *target, const riscv_insn_t *insns,
+		unsigned int count)
+{
+	RISCV_INFO(r);
+	if (r->write_progbuf)
+		return r->write_progbuf(target, insns, count);
+
+	for (unsigned int i = 0; i < count; ++i)
+		if (riscv_write_debug_buffer(target, i, insns[i]) != ERROR_OK)
+			return ERROR_FAIL;
+	return ERROR_OK;
+}
+
 riscv_insn_t riscv_read_debug_buffer(struct target *target, int index)
 {
 	RISCV_INFO(r);
@@ -59,6 +59,15 @@ enum riscv_halt_reason {
 	RISCV_HALT_ERROR
 };
 
+/* Kinds of accesses whose Run-Test/Idle delay is learned separately. */
+enum riscv_delay {
+	RISCV_DELAY_DMI,		/* any DMI access */
+	RISCV_DELAY_AC,			/* abstract commands, including program buffer execution */
+	RISCV_DELAY_SB_READ,	/* system bus reads */
+	RISCV_DELAY_SB_WRITE,	/* system bus writes */
+	RISCV_DELAY_COUNT
+};
+
 typedef struct {
 	struct target *target;
 	unsigned int custom_number;
@@ -132,6 +141,10 @@ struct riscv_info {
 	 * delays, causing them to be relearned. Used for testing. */
 	int reset_delays_wait;
 
+	/* Run-Test/Idle delays to start from, set with 'riscv set_delay' to
+	 * the values learned in a previous session. */
+	unsigned int initial_delay[RISCV_DELAY_COUNT];
+
 	/* This target has been prepped and is ready to step/resume. */
 	bool prepped;
 	/* This target was selected using hasel. */
@@ -161,7 +174,13 @@ struct riscv_info {
 	enum riscv_halt_reason (*halt_reason)(struct target *target);
 	int (*write_debug_buffer)(struct target *target, unsigned int index,
 			riscv_insn_t d);
+	/* Optional, writes a whole program at once. */
+	int (*write_progbuf)(struct target *target, const riscv_insn_t *insns,
+			unsigned int count);
 	riscv_insn_t (*read_debug_buffer)(struct target *target, unsigned int index);
+	/* Optional, gets the halted state of the hart from a summary of all the
+	 * harts of its debug module, without selecting it. */
+	int (*halt_summary)(struct target *target, bool *halted);
 	int (*execute_debug_buffer)(struct target *target);
 	int (*dmi_write_u64_bits)(struct target *target);
 	void (*fill_dmi_write_u64)(struct target *target, char *buf, int a, uint64_t d);
@@ -260,6 +279,9 @@ extern bool riscv_ebreakm;
 extern bool riscv_ebreaks;
 extern bool riscv_ebreaku;
 
+/* Names of the learned delays, as used by 'riscv set_delay' and 'riscv info'. */
+extern const char * const riscv_delay_names[RISCV_DELAY_COUNT];
+
 /* Everything needs the RISC-V specific info structure, so here's a nice macro
  * that provides that. */
 static inline struct riscv_info *riscv_info(const struct target *target) __attribute__((unused));
@@ -339,6 +361,8 @@ size_t riscv_debug_buffer_size(struct target *target);
 
 riscv_insn_t riscv_read_debug_buffer(struct target *target, int index);
 int riscv_write_debug_buffer(struct target *target, int index, riscv_insn_t insn);
+int riscv_write_progbuf(struct target *target, const riscv_insn_t *insns,
+		unsigned int count);
 int riscv_execute_debug_buffer(struct target *target);
 
 void riscv_fill_dmi_nop_u64(struct target *target, char *buf);
@@ -125,6 +125,9 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->is_active = false;
 	semihosting->redirect_cfg = SEMIHOSTING_REDIRECT_CFG_NONE;
 	semihosting->tcp_connection = NULL;
+	semihosting->buffer_mode = SEMIHOSTING_BUFFER_NONE;
+	semihosting->out_buf = NULL;
+	semihosting->out_buf_len = 0;
 	semihosting->stdin_fd = -1;
 	semihosting->stdout_fd = -1;
 	semihosting->stderr_fd = -1;
@@ -257,15 +260,6 @@ static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *
 	return retval;
 }
 
-static inline int semihosting_putchar(struct semihosting *semihosting, int fd, int c)
-{
-	if (semihosting_is_redirected(semihosting, fd))
-		return semihosting_redirect_write(semihosting, &c, 1);
-
-	/* default putchar */
-	return putchar(c);
-}
-
 static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
 {
 	if (semihosting_is_redirected(semihosting, fd))
@@ -294,6 +288,126 @@ static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 	return getchar();
 }
 
+#define SEMIHOSTING_OUT_BUF_SIZE	1024
+
+/*
+ * WRITE0 strings are read by chunks that do not cross such a boundary, so that
+ * the bytes read past the end of a string stay in the same memory block.
+ */
+#define SEMIHOSTING_STR_CHUNK_SIZE	64
+
+static void semihosting_out_write(struct semihosting *semihosting, const char *buf, size_t len)
+{
+	/* debug operations are redirected when CFG is either DEBUG or ALL */
+	if (semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_DEBUG ||
+		semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_ALL)
+		semihosting_redirect_write(semihosting, (void *)buf, len);
+	else
+		fwrite(buf, 1, len, stdout);
+}
+
+static void semihosting_out_flush(struct semihosting *semihosting)
+{
+	if (!semihosting->out_buf_len)
+		return;
+	semihosting_out_write(semihosting, semihosting->out_buf, semihosting->out_buf_len);
+	semihosting->out_buf_len = 0;
+}
+
+/**
+ * Write out the buffered debug output, e.g. when the target halts for
+ * another reason than a semihosting call.
+ */
+void semihosting_flush_output(struct target *target)
+{
+	if (target->semihosting)
+		semihosting_out_flush(target->semihosting);
+}
+
+/**
+ * Write out the buffered debug output and free the buffer, when semihosting
+ * is disabled or the target is destroyed.
+ */
+void semihosting_release_output(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting)
+		return;
+
+	semihosting_out_flush(semihosting);
+	free(semihosting->out_buf);
+	semihosting->out_buf = NULL;
+}
+
+/**
+ * Write to the debug channel, through the output buffer when enabled.
+ */
+static void semihosting_out(struct semihosting *semihosting, const char *buf, size_t len)
+{
+	/* the buffer is released when semihosting is disabled */
+	if (semihosting->buffer_mode != SEMIHOSTING_BUFFER_NONE && !semihosting->out_buf)
+		semihosting->out_buf = malloc(SEMIHOSTING_OUT_BUF_SIZE);
+
+	if (semihosting->buffer_mode == SEMIHOSTING_BUFFER_NONE || !semihosting->out_buf) {
+		semihosting_out_write(semihosting, buf, len);
+		return;
+	}
+
+	while (len) {
+		size_t n = MIN(len, SEMIHOSTING_OUT_BUF_SIZE - semihosting->out_buf_len);
+		memcpy(semihosting->out_buf + semihosting->out_buf_len, buf, n);
+		semihosting->out_buf_len += n;
+		if (semihosting->out_buf_len == SEMIHOSTING_OUT_BUF_SIZE ||
+			(semihosting->buffer_mode == SEMIHOSTING_BUFFER_LINE && memchr(buf, '\n', n)))
+			semihosting_out_flush(semihosting);
+		buf += n;
+		len -= n;
+	}
+}
+
+/**
+ * Read a null-terminated string from the target by chunks rather than a byte
+ * at a time. The string returned in @a str must be freed by the caller.
+ */
+static int semihosting_read_string(struct target *target, uint64_t addr, char **str, size_t *len)
+{
+	char *buf = NULL;
+	size_t size = 0;
+	size_t count = 0;
+
+	for (;;) {
+		size_t chunk = SEMIHOSTING_STR_CHUNK_SIZE - ((addr + count) % SEMIHOSTING_STR_CHUNK_SIZE);
+		if (count + chunk > size) {
+			size += 4 * SEMIHOSTING_STR_CHUNK_SIZE;
+			char *new_buf = realloc(buf, size);
+			if (!new_buf) {
+				LOG_ERROR("out of memory");
+				free(buf);
+				return ERROR_FAIL;
+			}
+			buf = new_buf;
+		}
+		int retval = target_read_buffer(target, addr + count, chunk, (uint8_t *)buf + count);
+		if (retval != ERROR_OK) {
+			/* the end of the chunk may not be readable, go on byte by byte */
+			chunk = 1;
+			retval = target_read_memory(target, addr + count, 1, 1, (uint8_t *)buf + count);
+			if (retval != ERROR_OK) {
+				free(buf);
+				return retval;
+			}
+		}
+		char *end = memchr(buf + count, '\0', chunk);
+		if (end) {
+			*str = buf;
+			*len = end - buf;
+			return ERROR_OK;
+		}
+		count += chunk;
+	}
+}
+
 /**
  * User operation parameter string storage buffer. Contains valid data when the
  * TARGET_EVENT_SEMIHOSTING_USER_CMD_xxxxx event callbacks are running.
@@ -398,6 +512,11 @@ int semihosting_common(struct target *target)
 			  semihosting_opcode_to_str(semihosting->op),
 			  semihosting->param);
 
+	/* keep the buffered debug output in order with the other operations */
+	if (semihosting->is_fileio ||
+		(semihosting->op != SEMIHOSTING_SYS_WRITEC && semihosting->op != SEMIHOSTING_SYS_WRITE0))
+		semihosting_out_flush(semihosting);
+
 	switch (semihosting->op) {
 	case SEMIHOSTING_SYS_CLOCK:	/* 0x10 */
 		/*
@@ -1430,11 +1549,11 @@ int semihosting_common(struct target *target)
 			fileio_info->param_3 = 1;
 		} else {
 			uint64_t addr = semihosting->param;
-			unsigned char c;
-			retval = target_read_memory(target, addr, 1, 1, &c);
+			char c;
+			retval = target_read_memory(target, addr, 1, 1, (uint8_t *)&c);
 			if (retval != ERROR_OK)
 				return retval;
-			semihosting_putchar(semihosting, semihosting->stdout_fd, c);
+			semihosting_out(semihosting, &c, 1);
 			semihosting->result = 0;
 		}
 		break;
@@ -1453,33 +1572,29 @@ int semihosting_common(struct target *target)
 		 * None. The RETURN REGISTER is corrupted.
 		 */
 		if (semihosting->is_fileio) {
-			size_t count = 0;
-			uint64_t addr = semihosting->param;
-			for (;; addr++) {
-				unsigned char c;
-				retval = target_read_memory(target, addr, 1, 1, &c);
-				if (retval != ERROR_OK)
-					return retval;
-				if (c == '\0')
-					break;
-				count++;
-			}
+			char *str;
+			size_t count;
+			retval = semihosting_read_string(target, semihosting->param, &str, &count);
+			if (retval != ERROR_OK)
+				return retval;
+			free(str);
 			semihosting->hit_fileio = true;
 			fileio_info->identifier = "write";
 			fileio_info->param_1 = 1;
 			fileio_info->param_2 = semihosting->param;
 			fileio_info->param_3 = count;
 		} else {
-			uint64_t addr = semihosting->param;
-			do {
-				unsigned char c;
-				retval = target_read_memory(target, addr++, 1, 1, &c);
-				if (retval != ERROR_OK)
-					return retval;
-				if (!c)
-					break;
-				semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-			} while (1);
+			char *str;
+			size_t count;
+			retval = semihosting_read_string(target, semihosting->param, &str, &count);
+			if (retval != ERROR_OK)
+				return retval;
+			/* an empty string is the hint of the application to flush the output */
+			if (count)
+				semihosting_out(semihosting, str, count);
+			else
+				semihosting_out_flush(semihosting);
+			free(str);
 			semihosting->result = 0;
 		}
 		break;
@@ -1862,6 +1977,8 @@ COMMAND_HANDLER(handle_common_semihosting_command)
 
 		/* FIXME never let that "catch" be dropped! (???) */
 		semihosting->is_active = is_active;
+		if (!is_active)
+			semihosting_release_output(target);
 	}
 
 	command_print(CMD, "semihosting is %s",
@@ -1920,6 +2037,7 @@ COMMAND_HANDLER(handle_common_semihosting_redirect_command)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	semihosting_out_flush(semihosting);
 	semihosting_tcp_close_cnx(semihosting);
 	semihosting->redirect_cfg = SEMIHOSTING_REDIRECT_CFG_NONE;
 
@@ -2049,6 +2167,62 @@ COMMAND_HANDLER(handle_common_semihosting_resumable_exit_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_buffer_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (!semihosting->is_active) {
+		command_print(CMD, "semihosting not yet enabled for current target");
+		return ERROR_FAIL;
+	}
+
+	static const char * const mode_names[] = {
+		[SEMIHOSTING_BUFFER_NONE] = "none",
+		[SEMIHOSTING_BUFFER_LINE] = "line",
+		[SEMIHOSTING_BUFFER_FULL] = "full",
+	};
+
+	if (CMD_ARGC > 0) {
+		enum semihosting_buffer_mode mode;
+		if (strcmp(CMD_ARGV[0], "none") == 0)
+			mode = SEMIHOSTING_BUFFER_NONE;
+		else if (strcmp(CMD_ARGV[0], "line") == 0)
+			mode = SEMIHOSTING_BUFFER_LINE;
+		else if (strcmp(CMD_ARGV[0], "full") == 0)
+			mode = SEMIHOSTING_BUFFER_FULL;
+		else
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		semihosting_out_flush(semihosting);
+		if (mode != SEMIHOSTING_BUFFER_NONE && !semihosting->out_buf) {
+			semihosting->out_buf = malloc(SEMIHOSTING_OUT_BUF_SIZE);
+			if (!semihosting->out_buf) {
+				command_print(CMD, "semihosting failed to allocate the output buffer!");
+				return ERROR_FAIL;
+			}
+		}
+		semihosting->buffer_mode = mode;
+	}
+
+	command_print(CMD, "semihosting output buffering: %s", mode_names[semihosting->buffer_mode]);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_common_semihosting_read_user_param_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -2147,6 +2321,13 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting resumable exit",
 	},
+	{
+		.name = "semihosting_buffer",
+		.handler = handle_common_semihosting_buffer_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['none'|'line'|'full']",
+		.help = "set the buffering of the semihosting debug output",
+	},
 	{
 		.name = "semihosting_read_user_param",
 		.handler = handle_common_semihosting_read_user_param_command,
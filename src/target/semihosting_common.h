@@ -94,6 +94,12 @@ enum semihosting_redirect_config {
 	SEMIHOSTING_REDIRECT_CFG_ALL,
 };
 
+enum semihosting_buffer_mode {
+	SEMIHOSTING_BUFFER_NONE,	/* Debug output written at each call. */
+	SEMIHOSTING_BUFFER_LINE,	/* Written at each new line. */
+	SEMIHOSTING_BUFFER_FULL,	/* Written when full, or on a flush hint. */
+};
+
 enum semihosting_result {
 	SEMIHOSTING_NONE,		/* Not halted for a semihosting call. */
 	SEMIHOSTING_HANDLED,	/* Call handled, and target was resumed. */
@@ -120,6 +126,11 @@ struct semihosting {
 	/** Handle to redirect semihosting print via tcp */
 	struct connection *tcp_connection;
 
+	/** Buffering of the debug channel output (WRITEC and WRITE0) */
+	enum semihosting_buffer_mode buffer_mode;
+	char *out_buf;
+	size_t out_buf_len;
+
 	/** A flag reporting whether semihosting fileio is active. */
 	bool is_fileio;
 
@@ -191,6 +202,8 @@ struct semihosting {
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
+void semihosting_flush_output(struct target *target);
+void semihosting_release_output(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
 int semihosting_read_fields(struct target *target, size_t number,
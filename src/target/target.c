@@ -1777,6 +1777,8 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	struct target_event_callback *next_callback;
 
 	if (event == TARGET_EVENT_HALTED) {
+		/* the halts handled by semihosting do not get here */
+		semihosting_flush_output(target);
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
 	}
@@ -2197,8 +2199,10 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
+	if (target->semihosting) {
+		semihosting_release_output(target);
 		free(target->semihosting->basedir);
+	}
 	free(target->semihosting);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
@@ -3612,6 +3616,54 @@ static COMMAND_HELPER(parse_load_image_command, struct image *image,
 	return ERROR_OK;
 }
 
+/*
+ * load_image and dump_image move the data by such chunks: large enough for the
+ * adapter to keep its queue busy, small enough to bound the memory used and to
+ * report the progress of long transfers.
+ */
+#define TARGET_IMAGE_CHUNK_SIZE		(256 * 1024)
+#define TARGET_IMAGE_PROGRESS_MS	2000
+
+static void target_image_progress(const char *what, struct duration *bench,
+		int64_t *next_ms, uint64_t done, uint64_t total)
+{
+	int64_t now = timeval_ms();
+	if (now < *next_ms)
+		return;
+	*next_ms = now + TARGET_IMAGE_PROGRESS_MS;
+
+	if (duration_measure(bench) != ERROR_OK)
+		return;
+	LOG_INFO("%s %" PRIu64 " of %" PRIu64 " bytes (%0.3f KiB/s)", what, done, total,
+			duration_kbps(bench, done));
+}
+
+/* Part of an image section in [min_address, max_address[, as an offset and a length */
+static bool load_image_section_clip(const struct imagesection *section,
+		target_addr_t min_address, target_addr_t max_address,
+		uint32_t *offset, uint32_t *length)
+{
+	/* DANGER!!! beware of unsigned comparison here!!! */
+
+	if ((section->base_address + section->size < min_address) ||
+			(section->base_address >= max_address))
+		return false;
+
+	*offset = 0;
+	*length = section->size;
+
+	if (section->base_address < min_address) {
+		/* clip addresses below */
+		*offset += min_address - section->base_address;
+		*length -= *offset;
+	}
+
+	if (section->base_address + section->size > max_address)
+		*length -= (section->base_address + section->size) - max_address;
+
+	return true;
+}
+
 COMMAND_HANDLER(handle_load_image_command)
 {
 	uint8_t *buffer;
@@ -3630,60 +3682,61 @@ COMMAND_HANDLER(handle_load_image_command)
 
 	struct duration bench;
 	duration_start(&bench);
+	int64_t progress_ms = timeval_ms() + TARGET_IMAGE_PROGRESS_MS;
 
 	if (image_open(&image, CMD_ARGV[0], (CMD_ARGC >= 3) ? CMD_ARGV[2] : NULL) != ERROR_OK)
 		return ERROR_FAIL;
 
-	image_size = 0x0;
-	retval = ERROR_OK;
+	uint64_t total_size = 0;
+	uint32_t buf_size = 0;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
+		uint32_t offset, length;
+		if (load_image_section_clip(&image.sections[i], min_address, max_address, &offset, &length)) {
+			total_size += length;
+			buf_size = MAX(buf_size, MIN(length, TARGET_IMAGE_CHUNK_SIZE));
 		}
+	}
 
-		uint32_t offset = 0;
-		uint32_t length = buf_cnt;
-
-		/* DANGER!!! beware of unsigned comparison here!!! */
-
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
+	buffer = malloc(MAX(buf_size, 1));
+	if (!buffer) {
+		command_print(CMD, "error allocating buffer (%" PRIu32 " bytes)", buf_size);
+		image_close(&image);
+		return ERROR_FAIL;
+	}
 
-			if (image.sections[i].base_address < min_address) {
-				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
-				length -= offset;
-			}
+	image_size = 0x0;
+	retval = ERROR_OK;
+	for (unsigned int i = 0; i < image.num_sections && retval == ERROR_OK; i++) {
+		uint32_t offset, length;
+		if (!load_image_section_clip(&image.sections[i], min_address, max_address, &offset, &length))
+			continue;
 
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+		/* read the section from the file and write it to the target chunk by chunk */
+		uint32_t written = 0;
+		while (written < length) {
+			uint32_t this_run_size = MIN(length - written, TARGET_IMAGE_CHUNK_SIZE);
+			retval = image_read_section(&image, i, offset + written, this_run_size, buffer, &buf_cnt);
+			if (retval != ERROR_OK || buf_cnt == 0)
+				break;
 
 			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
-			if (retval != ERROR_OK) {
-				free(buffer);
+					image.sections[i].base_address + offset + written, buf_cnt, buffer);
+			if (retval != ERROR_OK)
 				break;
-			}
-			image_size += length;
-			command_print(CMD, "%u bytes written at address " TARGET_ADDR_FMT "",
-					(unsigned int)length,
-					image.sections[i].base_address + offset);
+			written += buf_cnt;
+			image_size += buf_cnt;
+			target_image_progress("downloaded", &bench, &progress_ms, image_size, total_size);
 		}
+		if (retval != ERROR_OK)
+			break;
 
-		free(buffer);
+		command_print(CMD, "%u bytes written at address " TARGET_ADDR_FMT "",
+				(unsigned int)written,
+				image.sections[i].base_address + offset);
 	}
 
+	free(buffer);
+
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD, "downloaded %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
@@ -3711,7 +3764,7 @@ COMMAND_HANDLER(handle_dump_image_command)
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	uint32_t buf_size = (size > TARGET_IMAGE_CHUNK_SIZE) ? TARGET_IMAGE_CHUNK_SIZE : size;
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
@@ -3723,6 +3776,8 @@ COMMAND_HANDLER(handle_dump_image_command)
 	}
 
 	duration_start(&bench);
+	int64_t progress_ms = timeval_ms() + TARGET_IMAGE_PROGRESS_MS;
+	const target_addr_t total_size = size;
 
 	while (size > 0) {
 		size_t size_written;
@@ -3737,6 +3792,7 @@ COMMAND_HANDLER(handle_dump_image_command)
 
 		size -= this_run_size;
 		address += this_run_size;
+		target_image_progress("dumped", &bench, &progress_ms, total_size - size, total_size);
 	}
 
 	free(buffer);
@@ -4209,7 +4265,7 @@ static void write_string(FILE *f, char *s)
 typedef unsigned char UNIT[2];  /* unit of profiling */
 
 /* Dump a gmon.out histogram file. */
-static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
+void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
 			uint32_t start_address, uint32_t end_address, struct target *target, uint32_t duration_ms)
 {
 	uint32_t i;
@@ -780,6 +780,10 @@ void target_handle_md_output(struct command_invocation *cmd,
 int target_profiling_default(struct target *target, uint32_t *samples, uint32_t
 		max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
+/* Dump a gmon.out histogram file from the collected PC samples */
+void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filename, bool with_range,
+		uint32_t start_address, uint32_t end_address, struct target *target, uint32_t duration_ms);
+
 #define ERROR_TARGET_INVALID	(-300)
 #define ERROR_TARGET_INIT_FAILED (-301)
 #define ERROR_TARGET_TIMEOUT	(-302)
@@ -187,6 +187,12 @@
 #define XT_HW_IBREAK_MAX_NUM            2
 #define XT_HW_DBREAK_MAX_NUM            2
 
+/* Words moved per queue execution by the LDDR32.P/SDDR32.P memory accesses:
+ * a batch doubles from MIN to MAX, so that small accesses take a single round
+ * trip while large ones bound the JTAG queue and the work lost on a fault. */
+#define XT_MEM_BATCH_MIN_WORDS          256
+#define XT_MEM_BATCH_MAX_WORDS          8192
+
 struct xtensa_reg_desc xtensa_regs[XT_NUM_REGS] = {
 	XT_MK_REG_DESC("pc", XT_PC_REG_NUM_VIRTUAL, XT_REG_SPECIAL, 0),
 	XT_MK_REG_DESC("ar0", 0x00, XT_REG_GENERAL, 0),
@@ -2009,6 +2015,21 @@ static bool xtensa_memory_op_validate_range(struct xtensa *xtensa, target_addr_t
 	return true;
 }
 
+/* Execute the queued memory accesses and check the sticky exception flags of
+ * DSR once for all of them. */
+static int xtensa_mem_queue_execute(struct target *target)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	int res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
+	if (res != ERROR_OK)
+		return res;
+	bool prev_suppress = xtensa->suppress_dsr_errors;
+	xtensa->suppress_dsr_errors = true;
+	res = xtensa_core_status_check(target);
+	xtensa->suppress_dsr_errors = prev_suppress;
+	return res;
+}
+
 int xtensa_read_memory(struct target *target, target_addr_t address, uint32_t size, uint32_t count, uint8_t *buffer)
 {
 	struct xtensa *xtensa = target_to_xtensa(target);
@@ -2047,12 +2068,21 @@ int xtensa_read_memory(struct target *target, target_addr_t address, uint32_t si
 	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, addrstart_al);
 	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 	/* Now we can safely read data from addrstart_al up to addrend_al into albuff */
+	int res = ERROR_OK;
 	if (xtensa->probe_lsddr32p != 0) {
-		xtensa_queue_exec_ins(xtensa, XT_INS_LDDR32P(xtensa, XT_REG_A3));
-		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t))
-			xtensa_queue_dbg_reg_read(xtensa,
-				(adr + sizeof(uint32_t) == addrend_al) ? XDMREG_DDR : XDMREG_DDREXEC,
-				&albuff[i]);
+		/* Each LDDR32.P loads the next word into DDR and increments A3, the
+		 * DDREXEC reads run it again so that a batch is a single stream of
+		 * NAR/NDR scans; the last read of a batch stops the stream. */
+		unsigned int words = (addrend_al - addrstart_al) / sizeof(uint32_t);
+		unsigned int batch = XT_MEM_BATCH_MIN_WORDS;
+		for (unsigned int i = 0, n; i < words && res == ERROR_OK; i += n) {
+			n = MIN(batch, words - i);
+			xtensa_queue_exec_ins(xtensa, XT_INS_LDDR32P(xtensa, XT_REG_A3));
+			xtensa_queue_dbg_reg_read_block(xtensa, XDMREG_DDREXEC, XDMREG_DDR,
+				&albuff[i * sizeof(uint32_t)], n);
+			res = xtensa_mem_queue_execute(target);
+			batch = MIN(2 * batch, XT_MEM_BATCH_MAX_WORDS);
+		}
 	} else {
 		xtensa_mark_register_dirty(xtensa, XT_REG_IDX_A4);
 		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t)) {
@@ -2062,16 +2092,10 @@ int xtensa_read_memory(struct target *target, target_addr_t address, uint32_t si
 			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, adr + sizeof(uint32_t));
 			xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		}
+		res = xtensa_mem_queue_execute(target);
 	}
-	int res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
-	if (res == ERROR_OK) {
-		bool prev_suppress = xtensa->suppress_dsr_errors;
-		xtensa->suppress_dsr_errors = true;
-		res = xtensa_core_status_check(target);
-		if (xtensa->probe_lsddr32p == -1)
-			xtensa->probe_lsddr32p = 1;
-		xtensa->suppress_dsr_errors = prev_suppress;
-	}
+	if (res == ERROR_OK && xtensa->probe_lsddr32p == -1)
+		xtensa->probe_lsddr32p = 1;
 	if (res != ERROR_OK) {
 		if (xtensa->probe_lsddr32p != 0) {
 			/* Disable fast memory access instructions and retry before reporting an error */
@@ -2213,14 +2237,21 @@ int xtensa_write_memory(struct target *target,
 	xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, addrstart_al);
 	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 	/* Write the aligned buffer */
+	res = ERROR_OK;
 	if (xtensa->probe_lsddr32p != 0) {
-		for (unsigned int i = 0; adr != addrend_al; i += sizeof(uint32_t), adr += sizeof(uint32_t)) {
-			if (i == 0) {
-				xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, buf_get_u32(&albuff[i], 0, 32));
-				xtensa_queue_exec_ins(xtensa, XT_INS_SDDR32P(xtensa, XT_REG_A3));
-			} else {
-				xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDREXEC, buf_get_u32(&albuff[i], 0, 32));
-			}
+		/* Each SDDR32.P stores DDR and increments A3, the DDREXEC writes run it
+		 * again. A batch starts with a plain DDR write to restart the stream. */
+		unsigned int words = (addrend_al - addrstart_al) / sizeof(uint32_t);
+		unsigned int batch = XT_MEM_BATCH_MIN_WORDS;
+		for (unsigned int i = 0, n; i < words && res == ERROR_OK; i += n) {
+			n = MIN(batch, words - i);
+			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR,
+				buf_get_u32(&albuff[i * sizeof(uint32_t)], 0, 32));
+			xtensa_queue_exec_ins(xtensa, XT_INS_SDDR32P(xtensa, XT_REG_A3));
+			xtensa_queue_dbg_reg_write_block(xtensa, XDMREG_DDREXEC,
+				&albuff[(i + 1) * sizeof(uint32_t)], n - 1);
+			res = xtensa_mem_queue_execute(target);
+			batch = MIN(2 * batch, XT_MEM_BATCH_MAX_WORDS);
 		}
 	} else {
 		xtensa_mark_register_dirty(xtensa, XT_REG_IDX_A4);
@@ -2231,17 +2262,10 @@ int xtensa_write_memory(struct target *target,
 			xtensa_queue_dbg_reg_write(xtensa, XDMREG_DDR, adr + sizeof(uint32_t));
 			xtensa_queue_exec_ins(xtensa, XT_INS_RSR(xtensa, XT_SR_DDR, XT_REG_A3));
 		}
+		res = xtensa_mem_queue_execute(target);
 	}
-
-	res = xtensa_dm_queue_execute(&xtensa->dbg_mod);
-	if (res == ERROR_OK) {
-		bool prev_suppress = xtensa->suppress_dsr_errors;
-		xtensa->suppress_dsr_errors = true;
-		res = xtensa_core_status_check(target);
-		if (xtensa->probe_lsddr32p == -1)
-			xtensa->probe_lsddr32p = 1;
-		xtensa->suppress_dsr_errors = prev_suppress;
-	}
+	if (res == ERROR_OK && xtensa->probe_lsddr32p == -1)
+		xtensa->probe_lsddr32p = 1;
 	if (res != ERROR_OK) {
 		if (xtensa->probe_lsddr32p != 0) {
 			/* Disable fast memory access instructions and retry before reporting an error */
@@ -349,6 +349,41 @@ static inline int xtensa_queue_dbg_reg_write(struct xtensa *xtensa, enum xtensa_
 	return dm->dbg_ops->queue_reg_write(dm, reg, data);
 }
 
+/* Queue @a count reads of a data register, the last one from @a last_reg, in
+ * a single JTAG batch when the debug module supports it. Only meant for the
+ * DDR/DDREXEC streams of the memory accesses. */
+static inline int xtensa_queue_dbg_reg_read_block(struct xtensa *xtensa, enum xtensa_dm_reg reg,
+	enum xtensa_dm_reg last_reg, uint8_t *data, unsigned int count)
+{
+	struct xtensa_debug_module *dm = &xtensa->dbg_mod;
+
+	if (dm->dbg_ops->queue_reg_read_block)
+		return dm->dbg_ops->queue_reg_read_block(dm, reg, last_reg, data, count);
+	for (unsigned int i = 0; i < count; i++) {
+		int res = xtensa_queue_dbg_reg_read(xtensa, i == count - 1 ? last_reg : reg, &data[4 * i]);
+		if (res != ERROR_OK)
+			return res;
+	}
+	return ERROR_OK;
+}
+
+/* Queue @a count writes of a data register from @a data, which must stay
+ * valid until the queue is executed. */
+static inline int xtensa_queue_dbg_reg_write_block(struct xtensa *xtensa, enum xtensa_dm_reg reg,
+	const uint8_t *data, unsigned int count)
+{
+	struct xtensa_debug_module *dm = &xtensa->dbg_mod;
+
+	if (dm->dbg_ops->queue_reg_write_block)
+		return dm->dbg_ops->queue_reg_write_block(dm, reg, data, count);
+	for (unsigned int i = 0; i < count; i++) {
+		int res = xtensa_queue_dbg_reg_write(xtensa, reg, buf_get_u32(&data[4 * i], 0, 32));
+		if (res != ERROR_OK)
+			return res;
+	}
+	return ERROR_OK;
+}
+
 static inline int xtensa_core_status_clear(struct target *target, uint32_t bits)
 {
 	struct xtensa *xtensa = target_to_xtensa(target);
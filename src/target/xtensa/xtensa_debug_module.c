@@ -34,6 +34,12 @@ static const struct xtensa_dm_pwr_reg_offsets xdm_pwr_regs[XDMREG_PWRNUM] =
 static const struct xtensa_dm_reg_offsets xdm_regs[XDMREG_NUM] =
 	XTENSA_DM_REG_OFFSETS;
 
+/* NAR select values of the debug registers, for reads [0] and writes [1].
+ * Block accesses reference them from the JTAG queue, they must stay valid
+ * until it is executed. */
+static uint8_t xdm_nar_sel[2][XDMREG_NUM];
+static const uint8_t xdm_zero_data[4];
+
 static enum xtensa_dm_reg xtensa_dm_regaddr_to_id(uint32_t addr)
 {
 	enum xtensa_dm_reg id;
@@ -90,6 +96,11 @@ int xtensa_dm_init(struct xtensa_debug_module *dm, const struct xtensa_debug_mod
 	dm->debug_ap = cfg->debug_ap;
 	dm->debug_apsel = cfg->debug_apsel;
 	dm->ap_offset = cfg->ap_offset;
+
+	for (unsigned int i = 0; i < XDMREG_NUM; i++) {
+		xdm_nar_sel[0][i] = (xdm_regs[i].nar << 1) | 0;
+		xdm_nar_sel[1][i] = (xdm_regs[i].nar << 1) | 1;
+	}
 	return ERROR_OK;
 }
 
@@ -194,6 +205,73 @@ int xtensa_dm_queue_reg_write(struct xtensa_debug_module *dm, enum xtensa_dm_reg
 	return ERROR_OK;
 }
 
+/* Queue the NAR/NDR scan pairs of a block access after a single NARSEL IR scan,
+ * without copying the data in the JTAG queue. */
+static int xtensa_dm_add_block_scans(struct xtensa_debug_module *dm, unsigned int rw,
+	enum xtensa_dm_reg reg, enum xtensa_dm_reg last_reg,
+	const uint8_t *out, uint8_t *in, unsigned int count)
+{
+	struct scan_field *fields = calloc(2 * count, sizeof(*fields));
+	if (!fields) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		fields[2 * i].num_bits = TAPINS_NARSEL_ADRLEN;
+		fields[2 * i].out_value = &xdm_nar_sel[rw][i == count - 1 ? last_reg : reg];
+		fields[2 * i + 1].num_bits = TAPINS_NARSEL_DATALEN;
+		fields[2 * i + 1].out_value = out ? &out[4 * i] : xdm_zero_data;
+		fields[2 * i + 1].in_value = in ? &in[4 * i] : NULL;
+	}
+	xtensa_dm_add_set_ir(dm, TAPINS_NARSEL);
+	jtag_add_dr_scans(dm->tap, 2 * count, 1, fields, 0, TAP_IDLE);
+	free(fields);
+	return ERROR_OK;
+}
+
+int xtensa_dm_queue_reg_read_block(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg,
+	enum xtensa_dm_reg last_reg, uint8_t *data, unsigned int count)
+{
+	if (reg >= XDMREG_NUM || last_reg >= XDMREG_NUM) {
+		LOG_ERROR("Invalid DBG reg ID %d!", reg >= XDMREG_NUM ? reg : last_reg);
+		return ERROR_FAIL;
+	}
+	if (count == 0)
+		return ERROR_OK;
+	if (dm->dap) {
+		for (unsigned int i = 0; i < count; i++) {
+			enum xtensa_dm_reg r = i == count - 1 ? last_reg : reg;
+			int res = mem_ap_read_buf(dm->debug_ap, &data[4 * i], 4, 1,
+				xdm_regs[r].apb + dm->ap_offset);
+			if (res != ERROR_OK)
+				return res;
+		}
+		return ERROR_OK;
+	}
+	return xtensa_dm_add_block_scans(dm, 0, reg, last_reg, NULL, data, count);
+}
+
+int xtensa_dm_queue_reg_write_block(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg,
+	const uint8_t *data, unsigned int count)
+{
+	if (reg >= XDMREG_NUM) {
+		LOG_ERROR("Invalid DBG reg ID %d!", reg);
+		return ERROR_FAIL;
+	}
+	if (count == 0)
+		return ERROR_OK;
+	if (dm->dap) {
+		for (unsigned int i = 0; i < count; i++) {
+			int res = mem_ap_write_u32(dm->debug_ap, xdm_regs[reg].apb + dm->ap_offset,
+				buf_get_u32(&data[4 * i], 0, 32));
+			if (res != ERROR_OK)
+				return res;
+		}
+		return ERROR_OK;
+	}
+	return xtensa_dm_add_block_scans(dm, 1, reg, reg, data, NULL, count);
+}
+
 int xtensa_dm_queue_pwr_reg_read(struct xtensa_debug_module *dm,
 	enum xtensa_dm_pwr_reg reg,
 	uint8_t *data,
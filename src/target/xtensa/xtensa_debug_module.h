@@ -398,6 +398,14 @@ struct xtensa_debug_ops {
 	int (*queue_reg_read)(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg, uint8_t *data);
 	/** register write. */
 	int (*queue_reg_write)(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg, uint32_t data);
+	/** optional, reads of @a count words from @a reg, the last one from @a last_reg.
+	 * @a data must stay valid until the queue is executed. */
+	int (*queue_reg_read_block)(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg,
+		enum xtensa_dm_reg last_reg, uint8_t *data, unsigned int count);
+	/** optional, writes of @a count words to @a reg.
+	 * @a data must stay valid until the queue is executed. */
+	int (*queue_reg_write_block)(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg,
+		const uint8_t *data, unsigned int count);
 };
 
 /* Xtensa power registers are 8 bits wide on JTAG interfaces but 32 bits wide
@@ -510,6 +518,10 @@ int xtensa_dm_examine(struct xtensa_debug_module *dm);
 int xtensa_dm_queue_enable(struct xtensa_debug_module *dm);
 int xtensa_dm_queue_reg_read(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg, uint8_t *value);
 int xtensa_dm_queue_reg_write(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg, uint32_t value);
+int xtensa_dm_queue_reg_read_block(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg,
+	enum xtensa_dm_reg last_reg, uint8_t *data, unsigned int count);
+int xtensa_dm_queue_reg_write_block(struct xtensa_debug_module *dm, enum xtensa_dm_reg reg,
+	const uint8_t *data, unsigned int count);
 int xtensa_dm_queue_pwr_reg_read(struct xtensa_debug_module *dm,
 	enum xtensa_dm_pwr_reg reg,
 	uint8_t *data,
@@ -0,0 +1,64 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Description:
+#  Measure the throughput of the memory access paths of the current target,
+#  through the whole JTAG/SWD, DAP and target layers.
+#
+#  read_memory  : target_read_memory(), that is mem_ap_read_buf() on MEM-AP
+#                 based targets
+#  dump_image   : target_read_buffer()
+#  load_image   : target_write_buffer(), as used to download flash loaders
+#                 and their data
+#
+#  With the 'sim' adapter and board/sim.cfg the numbers do not depend on
+#  any hardware and can be compared between builds:
+#
+#   openocd -f board/sim.cfg -f tools/benchmark.tcl \
+#           -c "init; benchmark_memory 0x20000000 0x40000; shutdown"
+#
+# Return:
+#  A dict of the throughputs, in KiB/s.
+#
+add_help_text benchmark_memory "Measure the throughput of target memory reads and writes"
+add_usage_text benchmark_memory {address size [repeat [tmpfile]]}
+proc benchmark_memory { address size { repeat 4 } { tmpfile benchmark.bin } } {
+	set results [dict create]
+
+	# read_memory is limited to 65536 elements
+	set words [expr {$size / 4}]
+	if { $words > 65536 } {
+		set words 65536
+	}
+	set t [ms]
+	for {set i 0} {$i < $repeat} {incr i} {
+		read_memory $address 32 $words
+	}
+	dict set results read_memory [benchmark_rate [expr {$words * 4 * $repeat}] [expr {[ms] - $t}]]
+
+	set t [ms]
+	for {set i 0} {$i < $repeat} {incr i} {
+		dump_image $tmpfile $address $size
+	}
+	dict set results dump_image [benchmark_rate [expr {$size * $repeat}] [expr {[ms] - $t}]]
+
+	set t [ms]
+	for {set i 0} {$i < $repeat} {incr i} {
+		load_image $tmpfile $address bin
+	}
+	dict set results load_image [benchmark_rate [expr {$size * $repeat}] [expr {[ms] - $t}]]
+
+	file delete $tmpfile
+
+	dict for {path rate} $results {
+		echo [format "%-12s %10.1f KiB/s" $path $rate]
+	}
+
+	return $results
+}
+
+proc benchmark_rate { bytes ms } {
+	if { $ms < 1 } {
+		set ms 1
+	}
+	return [expr {$bytes / 1024.0 * 1000.0 / $ms}]
+}
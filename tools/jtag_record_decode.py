@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Decode a file written by OpenOCD with 'adapter record start'.
+
+Usage: jtag_record_decode.py [--vcd] recordfile
+
+Without options each record is printed as a line of text, with its time
+stamp relative to the start of the recording. With --vcd a value change
+dump is written instead, with the TAP state, the shifted TDI and TDO bits
+and the SWD transactions, to be displayed with a waveform viewer. The
+JTAG bits are placed at synthetic times, one TCK per microsecond from the
+start of each queue, since the adapter does not report their timing.
+"""
+
+import struct
+import sys
+
+MAGIC = b'OOCDJREC'
+FILE_HEADER = struct.Struct('<8sIIQQQQQQ')
+RECORD_HEADER = struct.Struct('<HHIQ')
+# the padding at the end of the ring has no time stamp
+PAD_HEADER = struct.Struct('<HHI')
+
+TAP_STATES = [
+    'DREXIT2', 'DREXIT1', 'DRSHIFT', 'DRPAUSE', 'IRSELECT', 'DRUPDATE',
+    'DRCAPTURE', 'DRSELECT', 'IREXIT2', 'IREXIT1', 'IRSHIFT', 'IRPAUSE',
+    'IDLE', 'IRUPDATE', 'IRCAPTURE', 'RESET',
+]
+
+SWD_SEQ = ['LINE_RESET', 'JTAG_TO_SWD', 'JTAG_TO_DORMANT', 'SWD_TO_JTAG',
+           'SWD_TO_DORMANT', 'DORMANT_TO_SWD', 'DORMANT_TO_JTAG']
+
+REC_PAD = 0x00
+REC_JTAG_QUEUE = 0x01
+REC_JTAG_CMD = 0x10
+REC_SWD_READ = 0x20
+REC_SWD_WRITE = 0x21
+REC_SWD_SEQ = 0x22
+REC_SWD_RUN = 0x23
+
+JTAG_SCAN = 1
+JTAG_TLR_RESET = 2
+JTAG_RUNTEST = 3
+JTAG_RESET = 4
+JTAG_PATHMOVE = 6
+JTAG_SLEEP = 7
+JTAG_STABLECLOCKS = 8
+JTAG_TMS = 9
+
+
+def state_name(s):
+    return TAP_STATES[s] if s < len(TAP_STATES) else '0x%x' % s
+
+
+def swd_reg_name(cmd):
+    ap = cmd & 0x02
+    rnw = cmd & 0x04
+    addr = (cmd >> 1) & 0x0c
+    return '%s %s 0x%x' % ('AP' if ap else 'DP', 'read' if rnw else 'write', addr)
+
+
+def bits_hex(data, nbits):
+    return '0x' + int.from_bytes(data[:(nbits + 7) // 8], 'little').to_bytes(
+        (nbits + 7) // 8, 'big').hex() if nbits else '-'
+
+
+def records(data):
+    """Yield (type, timestamp, payload) in the order they were written"""
+    if len(data) < FILE_HEADER.size or data[:8] != MAGIC:
+        sys.exit('not a recorder file')
+    (_, version, header_size, size, head, tail, start_us, count,
+     dropped) = FILE_HEADER.unpack_from(data, 0)
+    if version != 1:
+        sys.exit('unsupported recorder file version %d' % version)
+    ring = data[header_size:header_size + size]
+    if len(ring) < min(head, size):
+        sys.exit('truncated recorder file')
+
+    info = {'start_us': start_us, 'records': count, 'dropped': dropped,
+            'lost': tail}
+    yield 'info', info
+
+    pos = tail
+    while pos < head:
+        off = pos % size
+        if off + PAD_HEADER.size > len(ring):
+            sys.stderr.write('corrupted record at position %d\n' % pos)
+            return
+        rtype, _, length = PAD_HEADER.unpack_from(ring, off)
+        min_length = PAD_HEADER.size if rtype == REC_PAD else RECORD_HEADER.size
+        if length < min_length or length % 8 or off + length > len(ring):
+            sys.stderr.write('corrupted record at position %d\n' % pos)
+            return
+        if rtype != REC_PAD:
+            t = RECORD_HEADER.unpack_from(ring, off)[3]
+            yield rtype, (t - start_us, ring[off + RECORD_HEADER.size:off + length])
+        pos += length
+
+
+def decode_scan(p):
+    ir, end_state, nfields = p[0], p[1], struct.unpack_from('<H', p, 2)[0]
+    fields = []
+    pos = 8
+    for _ in range(nfields):
+        nbits, flags = struct.unpack_from('<IB', p, pos)
+        pos += 8
+        nbytes = (nbits + 7) // 8
+        out = inp = None
+        if flags & 1:
+            out = p[pos:pos + nbytes]
+            pos += nbytes
+        if flags & 2:
+            inp = p[pos:pos + nbytes]
+            pos += nbytes
+        fields.append((nbits, out, inp))
+    return ir, end_state, fields
+
+
+def print_text(data, out):
+    start_us = 0
+    for rtype, rec in records(data):
+        if rtype == 'info':
+            start_us = rec['start_us']
+            out.write('# %d records, %d bytes lost at ring start, %d records dropped or incomplete\n'
+                      % (rec['records'], rec['lost'], rec['dropped']))
+            continue
+        t, p = rec
+        prefix = '%12.6f ' % (t / 1e6)
+        cmd = rtype - REC_JTAG_CMD
+        if rtype == REC_JTAG_QUEUE:
+            result = struct.unpack_from('<i', p)[0]
+            start = struct.unpack_from('<Q', p, 8)[0]
+            out.write(prefix + 'JTAG queue executed in %d us, result %d\n'
+                      % (t - (start - start_us), result))
+        elif cmd == JTAG_SCAN:
+            ir, end_state, fields = decode_scan(p)
+            out.write(prefix + '%s SCAN to %s\n' % ('IR' if ir else 'DR', state_name(end_state)))
+            for nbits, o, i in fields:
+                if o is not None:
+                    out.write('%13s %ub out: %s\n' % ('', nbits, bits_hex(o, nbits)))
+                if i is not None:
+                    out.write('%13s %ub  in: %s\n' % ('', nbits, bits_hex(i, nbits)))
+        elif cmd == JTAG_TLR_RESET:
+            out.write(prefix + 'STATEMOVE to %s\n' % state_name(p[0]))
+        elif cmd == JTAG_RUNTEST:
+            cycles = struct.unpack_from('<I', p)[0]
+            out.write(prefix + 'RUNTEST %u cycles, end in %s\n' % (cycles, state_name(p[4])))
+        elif cmd == JTAG_RESET:
+            trst, srst = struct.unpack_from('<bb', p)
+            out.write(prefix + 'RESET trst: %d, srst: %d\n' % (trst, srst))
+        elif cmd == JTAG_PATHMOVE:
+            n = struct.unpack_from('<I', p)[0]
+            out.write(prefix + 'PATHMOVE %s\n' % ' '.join(state_name(s) for s in p[8:8 + n]))
+        elif cmd == JTAG_SLEEP:
+            out.write(prefix + 'SLEEP %u us\n' % struct.unpack_from('<I', p)[0])
+        elif cmd == JTAG_STABLECLOCKS:
+            out.write(prefix + 'STABLECLOCKS %u cycles\n' % struct.unpack_from('<I', p)[0])
+        elif cmd == JTAG_TMS:
+            n = struct.unpack_from('<I', p)[0]
+            out.write(prefix + 'TMS %u bits: %s\n' % (n, bits_hex(p[8:], n)))
+        elif rtype in (REC_SWD_READ, REC_SWD_WRITE):
+            swd_cmd, valid = p[0], p[1]
+            value, delay = struct.unpack_from('<II', p, 4)
+            value = '0x%08x' % value if valid else '(not read)'
+            out.write(prefix + 'SWD %s %s' % (swd_reg_name(swd_cmd), value)
+                      + (', ap_delay %u\n' % delay if delay else '\n'))
+        elif rtype == REC_SWD_SEQ:
+            seq = struct.unpack_from('<I', p)[0]
+            out.write(prefix + 'SWD sequence %s\n' % (SWD_SEQ[seq] if seq < len(SWD_SEQ) else seq))
+        elif rtype == REC_SWD_RUN:
+            result = struct.unpack_from('<i', p)[0]
+            start = struct.unpack_from('<Q', p, 8)[0]
+            out.write(prefix + 'SWD run executed in %d us, result %d\n'
+                      % (t - (start - start_us), result))
+        else:
+            out.write(prefix + 'unknown record type 0x%x\n' % rtype)
+
+
+class Vcd:
+    def __init__(self, out):
+        self.out = out
+        self.t = -1
+        out.write('$timescale 1us $end\n$scope module adapter $end\n'
+                  '$var wire 1 c tck $end\n$var wire 1 i tdi $end\n'
+                  '$var wire 1 o tdo $end\n$var wire 4 s tap_state $end\n'
+                  '$var wire 32 r swd_data $end\n$var wire 8 q swd_request $end\n'
+                  '$upscope $end\n$enddefinitions $end\n')
+
+    def at(self, t):
+        t = max(t, self.t + 1 if self.t >= 0 else 0)
+        self.out.write('#%d\n' % t)
+        self.t = t
+
+    def bit(self, name, v):
+        self.out.write('%s%s\n' % ('x' if v is None else v, name))
+
+    def vec(self, name, v):
+        self.out.write('b%s %s\n' % (bin(v)[2:], name))
+
+
+def print_vcd(data, out):
+    vcd = Vcd(out)
+    start_us = 0
+    queue_us = 0
+    for rtype, rec in records(data):
+        if rtype == 'info':
+            start_us = rec['start_us']
+            continue
+        t, p = rec
+        cmd = rtype - REC_JTAG_CMD
+        if rtype == REC_JTAG_QUEUE:
+            # the commands follow their queue record, replayed from its start
+            queue_us = struct.unpack_from('<Q', p, 8)[0] - start_us
+            continue
+        if 0 <= cmd < 0x10:
+            t = queue_us
+            if cmd == JTAG_SCAN:
+                ir, end_state, fields = decode_scan(p)
+                vcd.at(t)
+                vcd.vec('s', 10 if ir else 2)
+                for nbits, o, i in fields:
+                    for b in range(nbits):
+                        vcd.at(vcd.t + 1)
+                        vcd.bit('c', 0)
+                        vcd.bit('i', None if o is None else (o[b // 8] >> (b % 8)) & 1)
+                        vcd.bit('o', None if i is None else (i[b // 8] >> (b % 8)) & 1)
+                        vcd.at(vcd.t + 1)
+                        vcd.bit('c', 1)
+                vcd.at(vcd.t + 1)
+                vcd.vec('s', end_state)
+            elif cmd in (JTAG_TLR_RESET, JTAG_RUNTEST):
+                vcd.at(t)
+                vcd.vec('s', p[0] if cmd == JTAG_TLR_RESET else p[4])
+            elif cmd == JTAG_PATHMOVE:
+                n = struct.unpack_from('<I', p)[0]
+                for s in p[8:8 + n]:
+                    vcd.at(t)
+                    vcd.vec('s', s)
+        elif rtype in (REC_SWD_READ, REC_SWD_WRITE):
+            vcd.at(t)
+            vcd.vec('q', p[0])
+            vcd.vec('r', struct.unpack_from('<I', p, 4)[0])
+
+
+def main():
+    args = sys.argv[1:]
+    vcd = '--vcd' in args
+    args = [a for a in args if a != '--vcd']
+    if len(args) != 1:
+        sys.exit(__doc__)
+
+    with open(args[0], 'rb') as f:
+        data = f.read()
+    if vcd:
+        print_vcd(data, sys.stdout)
+    else:
+        print_text(data, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
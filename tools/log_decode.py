@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Pretty-print a log file written by OpenOCD with 'log_format binary'.
+
+Usage: log_decode.py [-v] logfile
+
+Each message is printed in the same format as the text log with
+debug_level 3, that is with count, time, file, line and function.
+Without -v the file, line and function are printed only for debug
+messages, as OpenOCD does.
+"""
+
+import struct
+import sys
+
+MAGIC = b'OOCDLOG1'
+RECORD = struct.Struct('<bBHHHIIII')
+
+LEVELS = {
+    -2: '',
+    -1: 'User : ',
+    0: 'Error: ',
+    1: 'Warn : ',
+    2: 'Info : ',
+    3: 'Debug: ',
+    4: 'Debug: ',
+}
+
+
+def decode(data, verbose, out):
+    pos = data.find(MAGIC)
+    if pos < 0:
+        sys.exit('no binary log found')
+    pos += len(MAGIC)
+
+    while pos + RECORD.size <= len(data):
+        (level, _, file_len, function_len, _, line, string_len,
+         count, t) = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        end = pos + file_len + function_len + string_len
+        if end > len(data):
+            sys.stderr.write('truncated record at offset %d\n' % (pos - RECORD.size))
+            break
+        file = data[pos:pos + file_len].decode(errors='replace')
+        pos += file_len
+        function = data[pos:pos + function_len].decode(errors='replace')
+        pos += function_len
+        string = data[pos:pos + string_len].decode(errors='replace')
+        pos = end
+
+        if level == -2:
+            out.write(string)
+        elif verbose or level >= 3:
+            out.write('%s%d %d %s:%d %s(): %s' % (LEVELS.get(level, '?????: '),
+                      count, t, file, line, function, string))
+        else:
+            out.write('%s%s' % (LEVELS.get(level, '') if level > -1 else '', string))
+
+
+def main():
+    args = sys.argv[1:]
+    verbose = '-v' in args
+    args = [a for a in args if a != '-v']
+    if len(args) != 1:
+        sys.exit(__doc__)
+
+    with open(args[0], 'rb') as f:
+        data = f.read()
+    decode(data, verbose, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()